@@ -1,17 +1,148 @@
 #include "kNet.h"
 #include "kNet/DebugMemoryLeakCheck.h"
 
+#include "../solar_net/SceneProtocol.h"
+
+#include <poll.h>
+#include <sstream>
+#include <vector>
+
 using namespace kNet;
 
 // Define a MessageID for our a custom message.
 const message_id_t cHelloMessageID = 32;
 
 BottomMemoryAllocator bma;
-char com[100];
+std::string com;
 std::string mess;
 
+// Append a float to a binary command, little-endian as on every host we run on
+static void AddFloat(std::vector<char>& buffer, float value)
+{
+	char bytes[sizeof value];
+	memcpy(bytes, &value, sizeof value);
+	buffer.insert(buffer.end(), bytes, bytes + sizeof value);
+}
+
+// Append a null-terminated name to a binary command
+static void AddName(std::vector<char>& buffer, const std::string& name)
+{
+	buffer.insert(buffer.end(), name.begin(), name.end());
+	buffer.push_back(0);
+}
+
+// Return whether more input is already waiting: a script, a file or a paste rather than someone typing. Lines already
+// read ahead into std::cin's buffer count too, as the descriptor no longer shows them; main() unties std::cin from
+// stdio so that it has a buffer of its own to look at
+static bool InputPending()
+{
+	if (std::cin.rdbuf()->in_avail() > 0)
+		return true;
+	pollfd fd = { 0, POLLIN, 0 };
+	return poll(&fd, 1, 0) > 0;
+}
+
+// Read the model and materials ending an object command, keeping the material shown. Return false unless they are
+// all of the rest of the line
+static bool ReadModelAndMaterial(std::istream& in, std::string& model, std::string& material)
+{
+	std::vector<std::string> fields;
+	std::string field;
+	while (in >> field)
+		fields.push_back(field);
+	in.clear(std::ios::eofbit);
+
+	if (fields.size() == 2)
+	{
+		model = fields[0];
+		material = fields[1];
+		return true;
+	}
+	if (fields.size() == 4)
+	{
+		// Same choice as the server: the first material when vis is 1, else the second
+		char* end;
+		long vis = strtol(fields[3].c_str(), &end, 10);
+		if (end == fields[3].c_str() || *end)
+			return false;
+		model = fields[0];
+		material = vis == 1 ? fields[1] : fields[2];
+		return true;
+	}
+	return false;
+}
+
+// Encode a typed scene command to the binary protocol, without the version byte that starts a message. Return false if the line is not one, or is incomplete:
+//   OB name x y z sx sy sz rx ry rz model material [material2 vis]     create an object
+//   OP name point sx sy sz rx ry rz model material [material2 vis]     create an object at a point
+//   PT name x y z                                                      create a point
+//   MO name point                                                      move an object to a point
+// With the two optional fields of the server's text form, the first material is sent if vis is 1, else the second.
+static bool EncodeSceneCommand(const std::string& line, std::vector<char>& buffer)
+{
+	std::istringstream in(line);
+	std::string op, name, point, model, material;
+	float v[9];
+	in >> op >> name;
+
+	buffer.clear();
+	if (op == "OB")
+	{
+		for (int i = 0; i < 9; i++)
+			in >> v[i];
+		if (in.fail() || !ReadModelAndMaterial(in, model, material))
+			return false;
+		buffer.push_back(SCENE_CREATE_OBJECT);
+		AddName(buffer, name);
+		for (int i = 0; i < 9; i++)
+			AddFloat(buffer, v[i]);
+		AddName(buffer, model);
+		AddName(buffer, material);
+	}
+	else if (op == "OP")
+	{
+		in >> point;
+		for (int i = 0; i < 6; i++)
+			in >> v[i];
+		if (in.fail() || !ReadModelAndMaterial(in, model, material))
+			return false;
+		buffer.push_back(SCENE_CREATE_OBJECT_AT_POINT);
+		AddName(buffer, name);
+		AddName(buffer, point);
+		for (int i = 0; i < 6; i++)
+			AddFloat(buffer, v[i]);
+		AddName(buffer, model);
+		AddName(buffer, material);
+	}
+	else if (op == "PT")
+	{
+		for (int i = 0; i < 3; i++)
+			in >> v[i];
+		buffer.push_back(SCENE_CREATE_POINT);
+		AddName(buffer, name);
+		for (int i = 0; i < 3; i++)
+			AddFloat(buffer, v[i]);
+	}
+	else if (op == "MO")
+	{
+		in >> point;
+		buffer.push_back(SCENE_MOVE_OBJECT_TO_POINT);
+		AddName(buffer, name);
+		AddName(buffer, point);
+	}
+	else
+		return false;
+
+	// Trailing tokens mean a form the encoder does not know; the line then goes as text
+	std::string extra;
+	return !in.fail() && !(in >> extra);
+}
+
 int main(int argc, char **argv)
 {
+	// Before any I/O, so that std::cin reads ahead into its own buffer, which InputPending() can see
+	std::ios::sync_with_stdio(false);
+
    	if (argc < 2)
    	{
       		std::cout << "Usage: " << argv[0] << " server-ip" << std::endl;
@@ -28,17 +159,48 @@ std::cout << "\ntest\n"<<std::endl;
    	Ptr(MessageConnection) connection = network.Connect(argv[1], atoi(argv[2]), SocketOverUDP,  NULL);
     //Ptr(MessageConnection) connection = network.Connect(argv[1], cServerPort, SocketOverUDP,  NULL);
   
-	std::cin.getline(com,sizeof(com));
-	while (com[0]!='X')
+	// Commands are batched per message, binary and text apart, within the size budget. A batch is sent when the
+	// other kind of command comes, so that all keep their order, and whenever no more input is waiting, so that
+	// typed commands still go at once
+	std::vector<char> command, batch;
+	message_id_t batchID = 0;
+	unsigned numBatched = 0;
+	auto sendBatch = [&]()
+	{
+		if (connection && !batch.empty())
+		{
+			connection->SendMessage(batchID, true, true, 100, 0, &batch[0], batch.size());
+			printf("message sent: %u commands, %u bytes\n",numBatched,(unsigned)batch.size());
+		}
+		batch.clear();
+		numBatched = 0;
+	};
+
+	std::getline(std::cin, com);
+	while (std::cin && com[0]!='X')
 	{
-        	if (connection)
-        	{
-                	connection->SendMessage(cHelloMessageID, true, true, 100, 0, com, strlen(com));
-                	printf("message sent: [%s]\n",com);
+		message_id_t id = cHelloMessageID;
+		if (EncodeSceneCommand(com, command))
+			id = MSG_SCENE;
+		else
+		{
+			command.assign(com.begin(), com.end());
+			command.push_back('\n');
+		}
+
+		if (!batch.empty() && (id != batchID || batch.size() + command.size() > COMMAND_BATCH_SIZE))
+			sendBatch();
+		if (batch.empty() && id == MSG_SCENE)
+			batch.push_back(SCENE_PROTOCOL_VERSION);
+		batch.insert(batch.end(), command.begin(), command.end());
+		batchID = id;
+		numBatched++;
 
-        	}
-		std::cin.getline(com,sizeof(com));
+		if (!InputPending())
+			sendBatch();
+		std::getline(std::cin, com);
 	}
+	sendBatch();
    
    	return 0;
 }
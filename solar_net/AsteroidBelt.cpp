@@ -0,0 +1,415 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/Graphics/Camera.h>
+#include <Urho3D/Graphics/Geometry.h>
+#include <Urho3D/Graphics/Material.h>
+#include <Urho3D/Graphics/Model.h>
+#include <Urho3D/Scene/Scene.h>
+#include <Urho3D/Scene/SceneEvents.h>
+
+#include "AsteroidBelt.h"
+#include "Ephemeris.h"
+#include "FloatingOrigin.h"
+#include "KeplerSolver.h"
+#include "SimulationClock.h"
+#include "WorkRange.h"
+
+#include <Urho3D/DebugNew.h>
+
+/// Default number of bodies per chunk.
+static const unsigned DEFAULT_CHUNK_SIZE = 4096;
+/// Most mean longitude sectors per semi-major axis band.
+static const unsigned MAX_SECTORS = 64;
+/// Distance from the floating origin in render space within which chunks are evaluated in double precision. The
+/// camera stays within the rebase distance of the origin, well inside.
+static const float NEAR_CHUNK_DISTANCE = 16384.0f;
+
+/// Wrap a mean anomaly to [-pi, pi), in double precision as time since J2000 is too large for single precision.
+static inline double WrapAnomaly(double anomaly)
+{
+    anomaly = fmod(anomaly + DOUBLE_PI, 2.0 * DOUBLE_PI);
+    return (anomaly < 0.0 ? anomaly + 2.0 * DOUBLE_PI : anomaly) - DOUBLE_PI;
+}
+
+/// Random generator local to one belt generation, so that a belt only depends on its seed and not on what else drew
+/// from the engine's shared random stream before it. A 32-bit LCG of which the top 24 bits are used.
+class BeltRandom
+{
+public:
+    /// Construct from a seed.
+    BeltRandom(unsigned seed) :
+        state_(seed)
+    {
+    }
+
+    /// Return a random value in [0, 1).
+    float Next()
+    {
+        state_ = state_ * 1664525u + 1013904223u;
+        return (float)(state_ >> 8) * (1.0f / 16777216.0f);
+    }
+    /// Return a random value in [0, range).
+    float Next(float range) { return Next() * range; }
+    /// Return a random value in [min, max).
+    float Next(float min, float max) { return min + Next() * (max - min); }
+
+private:
+    /// Generator state.
+    unsigned state_;
+};
+
+/// Return distance from the render space origin to a bounding box.
+static float GetDistanceFromOrigin(const BoundingBox& box)
+{
+    return Vector3(Clamp(0.0f, box.min_.x_, box.max_.x_), Clamp(0.0f, box.min_.y_, box.max_.y_),
+        Clamp(0.0f, box.min_.z_, box.max_.z_)).Length();
+}
+
+static void EvaluateChunksWork(const WorkItem* item, unsigned threadIndex)
+{
+    AsteroidBelt* belt = reinterpret_cast<AsteroidBelt*>(item->aux_);
+    belt->EvaluateChunks((unsigned)(size_t)item->start_, (unsigned)(size_t)item->end_);
+}
+
+AsteroidBelt::AsteroidBelt(Context* context) :
+    Drawable(context, DRAWABLE_GEOMETRY),
+    geometry_(0),
+    chunkSize_(DEFAULT_CHUNK_SIZE),
+    evaluationTime_(0.0),
+    evaluating_(false)
+{
+}
+
+AsteroidBelt::~AsteroidBelt()
+{
+    EndEvaluate();
+}
+
+void AsteroidBelt::RegisterObject(Context* context)
+{
+    context->RegisterFactory<AsteroidBelt>();
+}
+
+void AsteroidBelt::UpdateBatches(const FrameInfo& frame)
+{
+    distance_ = frame.camera_->GetDistance(GetWorldBoundingBox().Center());
+
+    // Chunks are culled here rather than by the octree, which only sees the belt as a whole. The visible chunks all
+    // share a geometry and a material, so the renderer merges them into one instanced batch group
+    batches_.Clear();
+    if (!geometry_ || !material_)
+        return;
+
+    const Frustum& frustum = frame.camera_->GetFrustum();
+    for (unsigned i = 0; i < chunks_.Size(); ++i)
+    {
+        const BeltChunk& chunk = chunks_[i];
+        if (!chunk.count_ || frustum.IsInsideFast(chunk.boundingBox_) == OUTSIDE)
+            continue;
+
+        SourceBatch batch;
+        batch.distance_ = frame.camera_->GetDistance(chunk.boundingBox_.Center());
+        batch.geometry_ = geometry_;
+        batch.material_ = material_;
+        batch.worldTransform_ = &transforms_[chunk.start_];
+        batch.numWorldTransforms_ = chunk.count_;
+        batches_.Push(batch);
+    }
+}
+
+void AsteroidBelt::Generate(unsigned count, double innerRadius, double outerRadius, float maxEccentricity,
+    float maxInclination, float minScale, float maxScale, unsigned seed)
+{
+    RemoveAll();
+    if (!count || innerRadius <= 0.0 || outerRadius < innerRadius)
+        return;
+
+    semiMajorAxes_.Resize(count);
+    semiMinorAxes_.Resize(count);
+    eccentricities_.Resize(count);
+    meanAnomaliesAtEpoch_.Resize(count);
+    meanMotions_.Resize(count);
+    periapsisAxes_.Resize(count);
+    normalAxes_.Resize(count);
+    transforms_.Resize(count);
+
+    // Bands of semi-major axis times sectors of mean longitude. Bodies of a band have close mean motions, so a chunk
+    // shears apart slowly and its bounding box stays small for many orbits
+    unsigned numChunks = (count + chunkSize_ - 1) / chunkSize_;
+    unsigned numSectors = Min(numChunks, MAX_SECTORS);
+    unsigned numBands = (numChunks + numSectors - 1) / numSectors;
+    numChunks = numBands * numSectors;
+    chunks_.Resize(numChunks);
+
+    maxEccentricity = Clamp(maxEccentricity, 0.0f, 0.99f);
+    BeltRandom random(seed);
+    for (unsigned i = 0; i < numChunks; ++i)
+    {
+        BeltChunk& chunk = chunks_[i];
+        chunk.start_ = (unsigned)((unsigned long long)count * i / numChunks);
+        chunk.count_ = (unsigned)((unsigned long long)count * (i + 1) / numChunks) - chunk.start_;
+        chunk.radius_ = 0.0f;
+        chunk.boundingBox_.Clear();
+
+        unsigned band = i / numSectors;
+        unsigned sector = i % numSectors;
+        double bandInner = Lerp(innerRadius, outerRadius, (double)band / numBands);
+        double bandOuter = Lerp(innerRadius, outerRadius, (double)(band + 1) / numBands);
+
+        for (unsigned j = chunk.start_; j < chunk.start_ + chunk.count_; ++j)
+        {
+            double semiMajorAxis = Lerp(bandInner, bandOuter, (double)random.Next());
+            double meanLongitude = (sector + random.Next()) * 360.0 / numSectors;
+            double ascendingNode = random.Next(360.0f);
+            double argumentOfPeriapsis = random.Next(360.0f);
+            double meanMotion = sqrt(SUN_GRAVITATIONAL_PARAMETER / (semiMajorAxis * semiMajorAxis * semiMajorAxis));
+            OrbitBasis orbit = MakeOrbitBasis(OrbitalElements(semiMajorAxis, random.Next(maxEccentricity),
+                random.Next(maxInclination), ascendingNode, argumentOfPeriapsis,
+                meanLongitude - ascendingNode - argumentOfPeriapsis, 2.0 * DOUBLE_PI / meanMotion / SECONDS_PER_DAY));
+
+            semiMajorAxes_[j] = (float)orbit.semiMajorAxis_;
+            semiMinorAxes_[j] = (float)orbit.semiMinorAxis_;
+            eccentricities_[j] = (float)orbit.eccentricity_;
+            meanAnomaliesAtEpoch_[j] = (float)orbit.meanAnomalyAtEpoch_;
+            meanMotions_[j] = (float)orbit.meanMotion_;
+            periapsisAxes_[j] = Vector3((float)orbit.periapsisAxis_[0], (float)orbit.periapsisAxis_[1],
+                (float)orbit.periapsisAxis_[2]);
+            normalAxes_[j] = Vector3((float)orbit.normalAxis_[0], (float)orbit.normalAxis_[1],
+                (float)orbit.normalAxis_[2]);
+
+            float scale = random.Next(minScale, maxScale);
+            transforms_[j] = Matrix3x4(Vector3::ZERO, Quaternion(random.Next(360.0f), random.Next(360.0f),
+                random.Next(360.0f)), scale);
+            chunk.radius_ = Max(chunk.radius_, scale);
+        }
+    }
+
+    Evaluate();
+}
+
+void AsteroidBelt::RemoveAll()
+{
+    EndEvaluate();
+
+    chunks_.Clear();
+    semiMajorAxes_.Clear();
+    semiMinorAxes_.Clear();
+    eccentricities_.Clear();
+    meanAnomaliesAtEpoch_.Clear();
+    meanMotions_.Clear();
+    periapsisAxes_.Clear();
+    normalAxes_.Clear();
+    meanAnomalies_.Clear();
+    cosEccentricAnomalies_.Clear();
+    sinEccentricAnomalies_.Clear();
+    transforms_.Clear();
+    batches_.Clear();
+    boundingBox_.Clear();
+    OnMarkedDirty(node_);
+}
+
+void AsteroidBelt::SetModel(Model* model)
+{
+    model_ = model;
+    geometry_ = model ? model->GetGeometry(0, 0) : 0;
+}
+
+void AsteroidBelt::SetMaterial(Material* material)
+{
+    material_ = material;
+}
+
+void AsteroidBelt::SetChunkSize(unsigned size)
+{
+    chunkSize_ = Max(size, 1U);
+}
+
+void AsteroidBelt::Evaluate()
+{
+    BeginEvaluate();
+    EndEvaluate();
+}
+
+void AsteroidBelt::BeginEvaluate()
+{
+    if (evaluating_)
+        EndEvaluate();
+
+    unsigned numBodies = transforms_.Size();
+    unsigned numChunks = chunks_.Size();
+    if (!numChunks)
+        return;
+
+    meanAnomalies_.Resize(numBodies);
+    cosEccentricAnomalies_.Resize(numBodies);
+    sinEccentricAnomalies_.Resize(numBodies);
+
+    SimulationClock* clock = GetSubsystem<SimulationClock>();
+    FloatingOrigin* floatingOrigin = GetScene() ? GetScene()->GetComponent<FloatingOrigin>() : 0;
+    evaluationTime_ = clock ? clock->GetRenderTime() : 0.0;
+    evaluationOrigin_ = floatingOrigin ? floatingOrigin->GetOrigin() : DoubleVector3::ZERO;
+    evaluating_ = true;
+
+    // A chunk is already a sizeable workload, so every chunk may go to its own work item
+    if (!QueueRangeWork(GetSubsystem<WorkQueue>(), EvaluateChunksWork, this, numChunks, 1))
+        EvaluateChunks(0, numChunks);
+}
+
+void AsteroidBelt::EndEvaluate()
+{
+    if (!evaluating_)
+        return;
+
+    WorkQueue* queue = GetSubsystem<WorkQueue>();
+    if (queue)
+        queue->Complete(M_MAX_UNSIGNED);
+    evaluating_ = false;
+
+    boundingBox_.Clear();
+    for (unsigned i = 0; i < chunks_.Size(); ++i)
+    {
+        if (chunks_[i].count_)
+            boundingBox_.Merge(chunks_[i].boundingBox_);
+    }
+    OnMarkedDirty(node_);
+}
+
+void AsteroidBelt::EvaluateChunks(unsigned start, unsigned end)
+{
+    double time = evaluationTime_;
+    const DoubleVector3& origin = evaluationOrigin_;
+    const float* semiMajorAxes = semiMajorAxes_.Buffer();
+    const float* semiMinorAxes = semiMinorAxes_.Buffer();
+    const float* eccentricities = eccentricities_.Buffer();
+    const float* meanAnomaliesAtEpoch = meanAnomaliesAtEpoch_.Buffer();
+    const float* meanMotions = meanMotions_.Buffer();
+    const Vector3* periapsisAxes = periapsisAxes_.Buffer();
+    const Vector3* normalAxes = normalAxes_.Buffer();
+    float* meanAnomalies = meanAnomalies_.Buffer();
+    float* cosEccentricAnomalies = cosEccentricAnomalies_.Buffer();
+    float* sinEccentricAnomalies = sinEccentricAnomalies_.Buffer();
+    Matrix3x4* transforms = transforms_.Buffer();
+
+    for (unsigned i = start; i < end; ++i)
+    {
+        BeltChunk& chunk = chunks_[i];
+        unsigned first = chunk.start_;
+        unsigned last = chunk.start_ + chunk.count_;
+
+        for (unsigned j = first; j < last; ++j)
+            meanAnomalies[j] = (float)WrapAnomaly(meanAnomaliesAtEpoch[j] + meanMotions[j] * time);
+
+        // The eccentric anomalies overwrite the mean anomalies in place; only their cosines and sines are used
+        SolveKeplerBatch(meanAnomalies + first, eccentricities + first, meanAnomalies + first,
+            cosEccentricAnomalies + first, sinEccentricAnomalies + first, chunk.count_);
+
+        // In single precision, both the anomaly and the heliocentric position move a Kuiper belt body in steps of
+        // about half a unit, a fair part of its size. That is invisible from afar, so only the chunks near the camera,
+        // judged by their last bounding box, get the anomaly refined and the position computed in double precision
+        // before the origin is subtracted. A chunk not evaluated yet has no box and takes the precise path
+        BoundingBox box;
+        if (!chunk.boundingBox_.Defined() || GetDistanceFromOrigin(chunk.boundingBox_) < NEAR_CHUNK_DISTANCE)
+        {
+            for (unsigned j = first; j < last; ++j)
+            {
+                double meanAnomaly = WrapAnomaly(meanAnomaliesAtEpoch[j] + meanMotions[j] * time);
+                double eccentricAnomaly = RefineKepler(meanAnomaly, eccentricities[j], meanAnomalies[j]);
+                double x = semiMajorAxes[j] * (cos(eccentricAnomaly) - eccentricities[j]);
+                double y = semiMinorAxes[j] * sin(eccentricAnomaly);
+                DoubleVector3 position = DoubleVector3(periapsisAxes[j]) * x + DoubleVector3(normalAxes[j]) * y -
+                    origin;
+
+                Matrix3x4& transform = transforms[j];
+                transform.m03_ = (float)position.x_;
+                transform.m13_ = (float)position.y_;
+                transform.m23_ = (float)position.z_;
+                box.Merge(Vector3(transform.m03_, transform.m13_, transform.m23_));
+            }
+        }
+        else
+        {
+            Vector3 renderOrigin = origin.ToVector3();
+            for (unsigned j = first; j < last; ++j)
+            {
+                float x = semiMajorAxes[j] * (cosEccentricAnomalies[j] - eccentricities[j]);
+                float y = semiMinorAxes[j] * sinEccentricAnomalies[j];
+                Vector3 position = periapsisAxes[j] * x + normalAxes[j] * y - renderOrigin;
+
+                Matrix3x4& transform = transforms[j];
+                transform.m03_ = position.x_;
+                transform.m13_ = position.y_;
+                transform.m23_ = position.z_;
+                box.Merge(position);
+            }
+        }
+
+        Vector3 margin(chunk.radius_, chunk.radius_, chunk.radius_);
+        chunk.boundingBox_ = BoundingBox(box.min_ - margin, box.max_ + margin);
+    }
+}
+
+void AsteroidBelt::OnSceneSet(Scene* scene)
+{
+    Drawable::OnSceneSet(scene);
+
+    if (scene)
+    {
+        SubscribeToEvent(scene, E_SCENEUPDATE, URHO3D_HANDLER(AsteroidBelt, HandleSceneUpdate));
+        SubscribeToEvent(scene, E_SCENEPOSTUPDATE, URHO3D_HANDLER(AsteroidBelt, HandleScenePostUpdate));
+        SubscribeToEvent(E_FLOATINGORIGINSHIFT, URHO3D_HANDLER(AsteroidBelt, HandleFloatingOriginShift));
+    }
+    else
+    {
+        EndEvaluate();
+        UnsubscribeFromEvent(E_SCENEUPDATE);
+        UnsubscribeFromEvent(E_SCENEPOSTUPDATE);
+        UnsubscribeFromEvent(E_FLOATINGORIGINSHIFT);
+    }
+}
+
+void AsteroidBelt::OnWorldBoundingBoxUpdate()
+{
+    worldBoundingBox_ = boundingBox_;
+}
+
+void AsteroidBelt::HandleSceneUpdate(StringHash eventType, VariantMap& eventData)
+{
+    BeginEvaluate();
+}
+
+void AsteroidBelt::HandleScenePostUpdate(StringHash eventType, VariantMap& eventData)
+{
+    EndEvaluate();
+}
+
+void AsteroidBelt::HandleFloatingOriginShift(StringHash eventType, VariantMap& eventData)
+{
+    using namespace FloatingOriginShift;
+
+    // Transforms are in render space and must follow the new origin before this frame renders
+    if (eventData[P_COMPONENT].GetPtr() == GetScene()->GetComponent<FloatingOrigin>())
+        Evaluate();
+}
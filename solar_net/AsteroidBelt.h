@@ -0,0 +1,166 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <Urho3D/Graphics/Drawable.h>
+
+#include "DoubleVector3.h"
+
+namespace Urho3D
+{
+
+class Geometry;
+class Model;
+
+}
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+/// Contiguous range of belt bodies, drawn as one instanced batch and culled as a unit.
+struct BeltChunk
+{
+    /// First body.
+    unsigned start_;
+    /// Number of bodies.
+    unsigned count_;
+    /// Largest body radius, added to the bounding box of the body centers.
+    float radius_;
+    /// Bounding box in render space, refreshed on every evaluation.
+    BoundingBox boundingBox_;
+};
+
+/// Drawable rendering a belt of up to millions of small bodies (asteroids, Kuiper belt objects), each on its own
+/// Keplerian orbit about the Sun at the world origin. Bodies are not nodes: their orbits are kept in flat float arrays
+/// and their world transforms in one array, whose translations are rewritten on the worker threads every frame through
+/// the batch Kepler solver. Bodies are generated chunk by chunk, each chunk covering a narrow band of semi-major axis
+/// and mean longitude, so that a chunk moves together and stays compact for a long time. Chunks outside the view
+/// frustum are dropped on the CPU; the visible ones all share a geometry and a material and are drawn with hardware
+/// instancing. The node's own transform is ignored.
+class AsteroidBelt : public Drawable
+{
+    URHO3D_OBJECT(AsteroidBelt, Drawable);
+
+public:
+    /// Construct.
+    AsteroidBelt(Context* context);
+    /// Destruct.
+    virtual ~AsteroidBelt();
+    /// Register object factory.
+    static void RegisterObject(Context* context);
+
+    /// Cull the chunks against the view and prepare one batch per visible chunk.
+    virtual void UpdateBatches(const FrameInfo& frame);
+
+    /// Generate bodies with random elements: semi-major axis between the radii in world units, eccentricity and
+    /// inclination in degrees up to the maxima, and a uniform scale in the given range. Existing bodies are removed.
+    /// The same arguments and seed always give the same belt.
+    void Generate(unsigned count, double innerRadius, double outerRadius, float maxEccentricity, float maxInclination,
+        float minScale, float maxScale, unsigned seed);
+    /// Remove all bodies.
+    void RemoveAll();
+    /// Set model instanced for every body. Only its first geometry at the highest LOD is used.
+    void SetModel(Model* model);
+    /// Set material. It should have an instancing-capable technique.
+    void SetMaterial(Material* material);
+    /// Set number of bodies per chunk, applied at the next generation.
+    void SetChunkSize(unsigned size);
+    /// Move all bodies to the current simulation time. Blocks until done.
+    void Evaluate();
+    /// Start evaluating all bodies on the worker threads.
+    void BeginEvaluate();
+    /// Wait for the evaluation started by BeginEvaluate().
+    void EndEvaluate();
+
+    /// Return model.
+    Model* GetModel() const { return model_; }
+    /// Return material.
+    Material* GetMaterial() const { return material_; }
+    /// Return number of bodies.
+    unsigned GetNumBodies() const { return transforms_.Size(); }
+    /// Return number of chunks.
+    unsigned GetNumChunks() const { return chunks_.Size(); }
+    /// Return number of chunks drawn in the last view.
+    unsigned GetNumVisibleChunks() const { return batches_.Size(); }
+    /// Return number of bodies per chunk.
+    unsigned GetChunkSize() const { return chunkSize_; }
+
+    /// Evaluate the bodies of a chunk range. Called from worker threads.
+    void EvaluateChunks(unsigned start, unsigned end);
+
+protected:
+    /// Handle scene being assigned.
+    virtual void OnSceneSet(Scene* scene);
+    /// Recalculate the world-space bounding box.
+    virtual void OnWorldBoundingBoxUpdate();
+
+private:
+    /// Handle scene update event.
+    void HandleSceneUpdate(StringHash eventType, VariantMap& eventData);
+    /// Handle scene post-update event.
+    void HandleScenePostUpdate(StringHash eventType, VariantMap& eventData);
+    /// Handle floating origin shift event.
+    void HandleFloatingOriginShift(StringHash eventType, VariantMap& eventData);
+
+    /// Instanced model.
+    SharedPtr<Model> model_;
+    /// Material.
+    SharedPtr<Material> material_;
+    /// Instanced geometry.
+    Geometry* geometry_;
+    /// Chunks.
+    PODVector<BeltChunk> chunks_;
+    /// Body semi-major axes.
+    PODVector<float> semiMajorAxes_;
+    /// Body semi-minor axes.
+    PODVector<float> semiMinorAxes_;
+    /// Body eccentricities.
+    PODVector<float> eccentricities_;
+    /// Body mean anomalies at J2000 in radians.
+    PODVector<float> meanAnomaliesAtEpoch_;
+    /// Body mean motions in radians per second.
+    PODVector<float> meanMotions_;
+    /// Body unit vectors towards periapsis.
+    PODVector<Vector3> periapsisAxes_;
+    /// Body unit vectors 90 degrees ahead of periapsis.
+    PODVector<Vector3> normalAxes_;
+    /// Per-frame mean anomalies handed to the batch Kepler solver.
+    PODVector<float> meanAnomalies_;
+    /// Per-frame cosines of the eccentric anomalies.
+    PODVector<float> cosEccentricAnomalies_;
+    /// Per-frame sines of the eccentric anomalies.
+    PODVector<float> sinEccentricAnomalies_;
+    /// Body world transforms in render space. Rotation and scale are fixed; the translation is rewritten.
+    PODVector<Matrix3x4> transforms_;
+    /// Bounding box of all chunks in render space.
+    BoundingBox boundingBox_;
+    /// Bodies per chunk.
+    unsigned chunkSize_;
+    /// Simulation time being evaluated.
+    double evaluationTime_;
+    /// Floating origin being evaluated against.
+    DoubleVector3 evaluationOrigin_;
+    /// Evaluation in flight flag.
+    bool evaluating_;
+};
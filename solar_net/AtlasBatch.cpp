@@ -0,0 +1,360 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Graphics/Camera.h>
+#include <Urho3D/Graphics/Geometry.h>
+#include <Urho3D/Graphics/IndexBuffer.h>
+#include <Urho3D/Graphics/Material.h>
+#include <Urho3D/Graphics/Model.h>
+#include <Urho3D/Graphics/Texture2D.h>
+#include <Urho3D/Graphics/VertexBuffer.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Resource/XMLFile.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "AtlasBatch.h"
+#include "TextureStreamer.h"
+
+#include <Urho3D/DebugNew.h>
+
+/// Vertex elements of the merged geometry.
+static const unsigned ATLAS_ELEMENT_MASK = MASK_POSITION | MASK_NORMAL | MASK_TEXCOORD1;
+
+AtlasBatch::AtlasBatch(Context* context) :
+    Drawable(context, DRAWABLE_GEOMETRY),
+    geometry_(new Geometry(context)),
+    vertexBuffer_(new VertexBuffer(context)),
+    indexBuffer_(new IndexBuffer(context)),
+    numVertices_(0),
+    numMergedObjects_(0),
+    mergeNeeded_(false),
+    uploadNeeded_(false)
+{
+    geometry_->SetVertexBuffer(0, vertexBuffer_, ATLAS_ELEMENT_MASK);
+    geometry_->SetIndexBuffer(indexBuffer_);
+
+    batches_.Resize(1);
+}
+
+AtlasBatch::~AtlasBatch()
+{
+}
+
+void AtlasBatch::RegisterObject(Context* context)
+{
+    context->RegisterFactory<AtlasBatch>();
+}
+
+void AtlasBatch::UpdateBatches(const FrameInfo& frame)
+{
+    distance_ = frame.camera_->GetDistance(GetWorldBoundingBox().Center());
+
+    // Nothing is drawn until some geometry has been merged and uploaded
+    batches_[0].geometry_ = indexBuffer_->GetIndexCount() ? geometry_.Get() : 0;
+    batches_[0].distance_ = distance_;
+    batches_[0].worldTransform_ = &node_->GetWorldTransform();
+}
+
+void AtlasBatch::UpdateGeometry(const FrameInfo& frame)
+{
+    if (vertexBuffer_->IsDataLost() || indexBuffer_->IsDataLost())
+    {
+        vertexBuffer_->ClearDataLost();
+        indexBuffer_->ClearDataLost();
+        uploadNeeded_ = true;
+    }
+    if (!uploadNeeded_)
+        return;
+
+    bool largeIndices = numVertices_ > 65535;
+    vertexBuffer_->SetSize(numVertices_, ATLAS_ELEMENT_MASK, true);
+    indexBuffer_->SetSize(indexData_.Size(), largeIndices, true);
+    if (numVertices_)
+    {
+        vertexBuffer_->SetData(&vertexData_[0]);
+        if (largeIndices)
+            indexBuffer_->SetData(&indexData_[0]);
+        else
+        {
+            PODVector<unsigned short> shortIndices(indexData_.Size());
+            for (unsigned i = 0; i < indexData_.Size(); ++i)
+                shortIndices[i] = (unsigned short)indexData_[i];
+            indexBuffer_->SetData(&shortIndices[0]);
+        }
+    }
+    geometry_->SetDrawRange(TRIANGLE_LIST, 0, indexData_.Size(), 0, numVertices_);
+    uploadNeeded_ = false;
+}
+
+UpdateGeometryType AtlasBatch::GetUpdateGeometryType()
+{
+    return uploadNeeded_ || vertexBuffer_->IsDataLost() || indexBuffer_->IsDataLost() ? UPDATE_MAIN_THREAD :
+        UPDATE_NONE;
+}
+
+bool AtlasBatch::SetSheet(XMLFile* sheet)
+{
+    RemoveAllObjects();
+    regions_.Clear();
+    texture_.Reset();
+    batches_[0].material_.Reset();
+
+    if (!sheet)
+        return false;
+    XMLElement root = sheet->GetRoot("TextureAtlas");
+    if (!root)
+    {
+        URHO3D_LOGERROR(sheet->GetName() + " is not a sprite sheet");
+        return false;
+    }
+
+    // Names in the sheet are relative to it
+    String path = GetPath(sheet->GetName());
+    String textureName = path + root.GetAttribute("imagePath");
+    TextureStreamer* streamer = GetSubsystem<TextureStreamer>();
+    texture_ = streamer ? streamer->GetTexture(textureName) :
+        GetSubsystem<ResourceCache>()->GetResource<Texture2D>(textureName);
+    if (!texture_)
+        return false;
+
+    // Smaller mip levels than the padding around the cells allows would blend them together. A cooked atlas already
+    // stops there; an image still to be streamed in gets the same limit when it is uploaded
+    unsigned levels = root.GetUInt("levels");
+    if (levels)
+        texture_->SetNumLevels(levels);
+
+    // The texture may still be a placeholder, so the atlas size is taken from the sheet. Sheets without it are taken
+    // to have no margin past the rectangles
+    Vector2 atlasSize((float)root.GetInt("width"), (float)root.GetInt("height"));
+    for (XMLElement region = root.GetChild("SubTexture"); region; region = region.GetNext("SubTexture"))
+    {
+        atlasSize.x_ = Max(atlasSize.x_, (float)(region.GetInt("x") + region.GetInt("width")));
+        atlasSize.y_ = Max(atlasSize.y_, (float)(region.GetInt("y") + region.GetInt("height")));
+    }
+    if (atlasSize.x_ <= 0.0f || atlasSize.y_ <= 0.0f)
+        return false;
+
+    // Each rectangle is inset by half a texel, so bilinear filtering of the top level stays inside the cell. Smaller
+    // levels reach into the padding, which repeats the cell's edge
+    for (XMLElement region = root.GetChild("SubTexture"); region; region = region.GetNext("SubTexture"))
+    {
+        Vector2 min((float)region.GetInt("x") + 0.5f, (float)region.GetInt("y") + 0.5f);
+        Vector2 max(min.x_ + (float)region.GetInt("width") - 1.0f, min.y_ + (float)region.GetInt("height") - 1.0f);
+        regions_[StringHash(path + region.GetAttribute("name"))] = Rect(min / atlasSize, max / atlasSize);
+    }
+    return true;
+}
+
+bool AtlasBatch::AddObject(Node* node, Model* model, Material* material)
+{
+    if (!node || !model || !material || !texture_)
+        return false;
+    Texture* texture = material->GetTexture(TU_DIFFUSE);
+    if (!texture)
+        return false;
+    HashMap<StringHash, Rect>::ConstIterator region = regions_.Find(texture->GetNameHash());
+    if (region == regions_.End())
+        return false;
+
+    // The batch draws every object with the first one's material settings; objects lit or blended another way
+    // are left to draw on their own
+    Material* batchMaterial = batches_[0].material_;
+    if (!batchMaterial)
+    {
+        SharedPtr<Material> clone = material->Clone();
+        clone->SetTexture(TU_DIFFUSE, texture_);
+        batches_[0].material_ = clone;
+    }
+    else if (material->GetTechnique(0) != batchMaterial->GetTechnique(0))
+        return false;
+
+    AtlasObject object;
+    object.node_ = node;
+    object.model_ = model;
+    object.uv_ = region->second_;
+    object.merged_ = false;
+    objects_.Push(object);
+    return true;
+}
+
+void AtlasBatch::RemoveObject(Node* node)
+{
+    for (unsigned i = 0; i < objects_.Size(); ++i)
+    {
+        if (objects_[i].node_ == node)
+        {
+            // An object not merged yet leaves nothing in the merged data
+            objects_.Erase(i);
+            if (i < numMergedObjects_)
+                mergeNeeded_ = true;
+            return;
+        }
+    }
+}
+
+void AtlasBatch::RemoveAllObjects()
+{
+    objects_.Clear();
+    mergeNeeded_ = true;
+}
+
+Material* AtlasBatch::GetMaterial() const
+{
+    return batches_[0].material_;
+}
+
+void AtlasBatch::OnSceneSet(Scene* scene)
+{
+    Drawable::OnSceneSet(scene);
+
+    if (scene)
+        SubscribeToEvent(E_POSTUPDATE, URHO3D_HANDLER(AtlasBatch, HandlePostUpdate));
+    else
+        UnsubscribeFromEvent(E_POSTUPDATE);
+}
+
+void AtlasBatch::OnWorldBoundingBoxUpdate()
+{
+    if (boundingBox_.Defined())
+        worldBoundingBox_ = boundingBox_.Transformed(node_->GetWorldTransform());
+    else
+        worldBoundingBox_ = BoundingBox(node_->GetWorldPosition(), node_->GetWorldPosition());
+}
+
+void AtlasBatch::HandlePostUpdate(StringHash eventType, VariantMap& eventData)
+{
+    // Objects are few and rarely move, so comparing their transforms each frame is cheaper than listening to every
+    // node. A floating origin shift moves the batch node with the objects and changes no relative transform
+    Matrix3x4 inverseWorld = node_->GetWorldTransform().Inverse();
+    for (unsigned i = 0; i < numMergedObjects_ && !mergeNeeded_; ++i)
+    {
+        const AtlasObject& object = objects_[i];
+        Node* node = object.node_;
+        bool enabled = node && node->IsEnabled();
+        if (enabled != object.merged_ ||
+            (enabled && !(inverseWorld * node->GetWorldTransform()).Equals(object.transform_)))
+            mergeNeeded_ = true;
+    }
+
+    if (mergeNeeded_)
+        MergeObjects(inverseWorld);
+    else if (numMergedObjects_ < objects_.Size())
+    {
+        // Objects added since the last merge go at the end of the merged data
+        for (unsigned i = numMergedObjects_; i < objects_.Size(); ++i)
+            AppendObject(objects_[i], inverseWorld);
+        numMergedObjects_ = objects_.Size();
+        uploadNeeded_ = true;
+        OnMarkedDirty(node_);
+    }
+}
+
+void AtlasBatch::MergeObjects(const Matrix3x4& inverseWorld)
+{
+    vertexData_.Clear();
+    indexData_.Clear();
+    numVertices_ = 0;
+    boundingBox_.Clear();
+
+    // Objects whose node was destroyed leave the batch
+    for (unsigned i = 0; i < objects_.Size();)
+    {
+        if (objects_[i].node_.Expired())
+            objects_.Erase(i);
+        else
+            ++i;
+    }
+
+    for (unsigned i = 0; i < objects_.Size(); ++i)
+        AppendObject(objects_[i], inverseWorld);
+    numMergedObjects_ = objects_.Size();
+
+    mergeNeeded_ = false;
+    uploadNeeded_ = true;
+    OnMarkedDirty(node_);
+}
+
+void AtlasBatch::AppendObject(AtlasObject& object, const Matrix3x4& inverseWorld)
+{
+    Node* node = object.node_;
+    object.merged_ = node && node->IsEnabled();
+    if (!object.merged_)
+        return;
+
+    object.transform_ = inverseWorld * node->GetWorldTransform();
+    Matrix3 normalTransform = object.transform_.ToMatrix3().Inverse().Transpose();
+    boundingBox_.Merge(object.model_->GetBoundingBox().Transformed(object.transform_));
+
+    for (unsigned j = 0; j < object.model_->GetNumGeometries(); ++j)
+    {
+        Geometry* geometry = object.model_->GetGeometry(j, 0);
+        if (!geometry || geometry->GetPrimitiveType() != TRIANGLE_LIST)
+            continue;
+
+        const unsigned char* vertexData;
+        const unsigned char* indexData;
+        unsigned vertexSize;
+        unsigned indexSize;
+        unsigned elementMask;
+        geometry->GetRawData(vertexData, vertexSize, indexData, indexSize, elementMask);
+        if (!vertexData || !indexData || (elementMask & (MASK_POSITION | MASK_TEXCOORD1)) !=
+            (MASK_POSITION | MASK_TEXCOORD1))
+            continue;
+
+        unsigned normalOffset = VertexBuffer::GetElementOffset(elementMask, ELEMENT_NORMAL);
+        unsigned texCoordOffset = VertexBuffer::GetElementOffset(elementMask, ELEMENT_TEXCOORD1);
+        unsigned vertexStart = geometry->GetVertexStart();
+        unsigned vertexCount = geometry->GetVertexCount();
+        for (unsigned k = 0; k < vertexCount; ++k)
+        {
+            const unsigned char* src = vertexData + (vertexStart + k) * vertexSize;
+            Vector3 position = object.transform_ * *reinterpret_cast<const Vector3*>(src);
+            Vector3 normal = elementMask & MASK_NORMAL ?
+                (normalTransform * *reinterpret_cast<const Vector3*>(src + normalOffset)).Normalized() :
+                Vector3::UP;
+            const Vector2& texCoord = *reinterpret_cast<const Vector2*>(src + texCoordOffset);
+
+            vertexData_.Push(position.x_);
+            vertexData_.Push(position.y_);
+            vertexData_.Push(position.z_);
+            vertexData_.Push(normal.x_);
+            vertexData_.Push(normal.y_);
+            vertexData_.Push(normal.z_);
+            vertexData_.Push(Lerp(object.uv_.min_.x_, object.uv_.max_.x_, Clamp(texCoord.x_, 0.0f, 1.0f)));
+            vertexData_.Push(Lerp(object.uv_.min_.y_, object.uv_.max_.y_, Clamp(texCoord.y_, 0.0f, 1.0f)));
+        }
+
+        unsigned indexEnd = geometry->GetIndexStart() + geometry->GetIndexCount();
+        for (unsigned k = geometry->GetIndexStart(); k < indexEnd; ++k)
+        {
+            unsigned index = indexSize == sizeof(unsigned) ? reinterpret_cast<const unsigned*>(indexData)[k] :
+                reinterpret_cast<const unsigned short*>(indexData)[k];
+            indexData_.Push(index - vertexStart + numVertices_);
+        }
+        numVertices_ += vertexCount;
+    }
+}
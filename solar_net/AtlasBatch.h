@@ -0,0 +1,144 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <Urho3D/Graphics/Drawable.h>
+
+namespace Urho3D
+{
+
+class Geometry;
+class IndexBuffer;
+class Model;
+class Texture2D;
+class VertexBuffer;
+class XMLFile;
+
+}
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+/// Object merged into an atlas batch.
+struct AtlasObject
+{
+    /// Scene node placing the object.
+    WeakPtr<Node> node_;
+    /// Model, of which the first LOD level of every triangle list geometry is merged.
+    SharedPtr<Model> model_;
+    /// Atlas rectangle of the object's texture, in texture coordinates.
+    Rect uv_;
+    /// Object transform relative to the batch node when the vertices were last merged.
+    Matrix3x4 transform_;
+    /// Whether the object was enabled and merged.
+    bool merged_;
+};
+
+/// Drawable merging objects whose diffuse textures were packed into one atlas (tools/PackAtlas) into a single batch.
+/// The engine has no texture arrays and no per-instance data besides the transform, so instead of picking a layer per
+/// instance each object's geometry is copied into one vertex buffer with its texture coordinates remapped to its atlas
+/// rectangle, and drawn with one material: a clone of the first object's material with the atlas as diffuse texture.
+/// Vertices are kept relative to the batch node; they are merged again on the CPU whenever an object moves relative
+/// to it, is disabled or is removed. Model texture coordinates are clamped to the unit square, as wrapping would
+/// sample the neighbouring cells. The texture keeps only the mip levels the sheet names, which the packer's padding
+/// keeps apart.
+class AtlasBatch : public Drawable
+{
+    URHO3D_OBJECT(AtlasBatch, Drawable);
+
+public:
+    /// Construct.
+    AtlasBatch(Context* context);
+    /// Destruct.
+    virtual ~AtlasBatch();
+    /// Register object factory.
+    static void RegisterObject(Context* context);
+
+    /// Calculate distance and prepare batches for rendering.
+    virtual void UpdateBatches(const FrameInfo& frame);
+    /// Upload merged vertex and index data.
+    virtual void UpdateGeometry(const FrameInfo& frame);
+    /// Return whether a geometry update is necessary, and if it can happen in a worker thread.
+    virtual UpdateGeometryType GetUpdateGeometryType();
+
+    /// Set the sprite sheet of the atlas and load the atlas texture. Removes all objects. Return true on success.
+    bool SetSheet(XMLFile* sheet);
+    /// Add an object drawn with a model and a material. Return false, adding nothing, if the material's diffuse
+    /// texture is not in the atlas or its technique differs from the batch material's.
+    bool AddObject(Node* node, Model* model, Material* material);
+    /// Remove an object.
+    void RemoveObject(Node* node);
+    /// Remove all objects.
+    void RemoveAllObjects();
+
+    /// Return whether the atlas holds a texture.
+    bool HasTexture(const String& name) const { return regions_.Contains(StringHash(name)); }
+    /// Return number of objects.
+    unsigned GetNumObjects() const { return objects_.Size(); }
+    /// Return number of merged vertices.
+    unsigned GetNumVertices() const { return numVertices_; }
+    /// Return atlas texture.
+    Texture2D* GetTexture() const { return texture_; }
+    /// Return batch material.
+    Material* GetMaterial() const;
+
+protected:
+    /// Handle scene being assigned.
+    virtual void OnSceneSet(Scene* scene);
+    /// Recalculate the world-space bounding box.
+    virtual void OnWorldBoundingBoxUpdate();
+
+private:
+    /// Handle logic post-update event.
+    void HandlePostUpdate(StringHash eventType, VariantMap& eventData);
+    /// Merge the vertices of all enabled objects, given the inverse world transform of the batch node.
+    void MergeObjects(const Matrix3x4& inverseWorld);
+    /// Append the vertices of an object to the merged data if it is enabled.
+    void AppendObject(AtlasObject& object, const Matrix3x4& inverseWorld);
+
+    /// Geometry.
+    SharedPtr<Geometry> geometry_;
+    /// Vertex buffer.
+    SharedPtr<VertexBuffer> vertexBuffer_;
+    /// Index buffer.
+    SharedPtr<IndexBuffer> indexBuffer_;
+    /// Atlas texture.
+    SharedPtr<Texture2D> texture_;
+    /// Atlas rectangles by texture name.
+    HashMap<StringHash, Rect> regions_;
+    /// Objects.
+    Vector<AtlasObject> objects_;
+    /// Merged vertex data, as floats: position, normal and texture coordinates.
+    PODVector<float> vertexData_;
+    /// Merged index data, converted to 16-bit on upload when the vertex count allows.
+    PODVector<unsigned> indexData_;
+    /// Number of merged vertices.
+    unsigned numVertices_;
+    /// Number of objects, from the first, that the merged data covers.
+    unsigned numMergedObjects_;
+    /// Objects need merging.
+    bool mergeNeeded_;
+    /// Merged data needs uploading.
+    bool uploadNeeded_;
+};
@@ -0,0 +1,263 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Graphics/BillboardSet.h>
+#include <Urho3D/Graphics/Camera.h>
+#include <Urho3D/Graphics/Graphics.h>
+#include <Urho3D/Graphics/Material.h>
+#include <Urho3D/Graphics/StaticModel.h>
+#include <Urho3D/Graphics/Texture.h>
+#include <Urho3D/Resource/Image.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "BodyImpostors.h"
+#include "FloatingOrigin.h"
+#include "TextureStreamer.h"
+
+#include <Urho3D/DebugNew.h>
+
+/// Default projected radius in pixels below which a body becomes an impostor.
+static const float DEFAULT_THRESHOLD = 2.0f;
+/// Default smallest impostor radius in pixels.
+static const float DEFAULT_MIN_SIZE = 1.0f;
+/// Factor applied to the threshold to swap an impostor back to its model.
+static const float IMPOSTOR_HYSTERESIS = 1.25f;
+
+BodyImpostors::BodyImpostors(Context* context) :
+    Component(context),
+    threshold_(DEFAULT_THRESHOLD),
+    minSize_(DEFAULT_MIN_SIZE),
+    numImpostors_(0)
+{
+}
+
+BodyImpostors::~BodyImpostors()
+{
+}
+
+void BodyImpostors::RegisterObject(Context* context)
+{
+    context->RegisterFactory<BodyImpostors>();
+}
+
+unsigned BodyImpostors::AddBody(StaticModel* model)
+{
+    return AddBody(model, GetMaterialColor(model ? model->GetMaterial() : 0));
+}
+
+unsigned BodyImpostors::AddBody(StaticModel* model, const Color& color)
+{
+    BodyImpostor body;
+    body.model_ = model;
+    body.color_ = color;
+    body.active_ = false;
+    bodies_.Push(body);
+
+    if (billboardSet_)
+    {
+        billboardSet_->SetNumBillboards(bodies_.Size());
+        billboardSet_->GetBillboard(bodies_.Size() - 1)->enabled_ = false;
+    }
+    return bodies_.Size() - 1;
+}
+
+void BodyImpostors::RemoveAllBodies()
+{
+    for (unsigned i = 0; i < bodies_.Size(); ++i)
+    {
+        if (bodies_[i].active_ && bodies_[i].model_)
+            bodies_[i].model_->SetEnabled(true);
+    }
+    bodies_.Clear();
+    numImpostors_ = 0;
+
+    if (billboardSet_)
+    {
+        billboardSet_->SetNumBillboards(0);
+        billboardSet_->Commit();
+    }
+}
+
+void BodyImpostors::SetBillboardSet(BillboardSet* billboardSet)
+{
+    billboardSet_ = billboardSet;
+    if (billboardSet_)
+    {
+        billboardSet_->SetNumBillboards(bodies_.Size());
+        for (unsigned i = 0; i < bodies_.Size(); ++i)
+            billboardSet_->GetBillboard(i)->enabled_ = false;
+    }
+    Update();
+}
+
+void BodyImpostors::SetCamera(Camera* camera)
+{
+    camera_ = camera;
+    Update();
+}
+
+void BodyImpostors::SetThreshold(float pixels)
+{
+    threshold_ = Max(pixels, 0.0f);
+}
+
+void BodyImpostors::SetMinSize(float pixels)
+{
+    minSize_ = Max(pixels, 0.0f);
+}
+
+void BodyImpostors::Update()
+{
+    if (!billboardSet_ || !camera_ || !camera_->GetNode())
+        return;
+
+    // Pixels covered by one world unit at unit distance
+    Graphics* graphics = GetSubsystem<Graphics>();
+    float screenHeight = graphics ? (float)graphics->GetHeight() : 1.0f;
+    float pixelScale = camera_->GetZoom() * screenHeight * 0.5f / tanf(camera_->GetFov() * 0.5f * M_DEGTORAD);
+    Vector3 cameraPosition = camera_->GetNode()->GetWorldPosition();
+
+    numImpostors_ = 0;
+    for (unsigned i = 0; i < bodies_.Size(); ++i)
+    {
+        BodyImpostor& body = bodies_[i];
+        Billboard* billboard = billboardSet_->GetBillboard(i);
+        StaticModel* model = body.model_;
+        if (!model || !model->GetNode())
+        {
+            billboard->enabled_ = false;
+            continue;
+        }
+
+        // Radius as the renderer sees it for LOD selection: the mean half size of the world bounding box
+        Vector3 size = model->GetWorldBoundingBox().Size();
+        float radius = (size.x_ + size.y_ + size.z_) / 6.0f;
+        Vector3 position = model->GetNode()->GetWorldPosition();
+        float distance = (position - cameraPosition).Length();
+        float pixels = distance > M_EPSILON ? radius * pixelScale / distance : M_INFINITY;
+
+        bool active = pixels < (body.active_ ? threshold_ * IMPOSTOR_HYSTERESIS : threshold_);
+        if (active != body.active_)
+        {
+            model->SetEnabled(!active);
+            body.active_ = active;
+        }
+
+        billboard->enabled_ = active;
+        if (active)
+        {
+            // Billboard size is the half extent
+            float impostorRadius = Max(radius, minSize_ * distance / pixelScale);
+            billboard->position_ = position;
+            billboard->size_ = Vector2(impostorRadius, impostorRadius);
+            billboard->color_ = body.color_;
+            ++numImpostors_;
+        }
+    }
+
+    billboardSet_->Commit();
+}
+
+Color BodyImpostors::GetMaterialColor(Material* material)
+{
+    Texture* texture = material ? material->GetTexture(TU_DIFFUSE) : 0;
+    if (!texture)
+        return Color::WHITE;
+
+    HashMap<StringHash, Color>::ConstIterator i = textureColors_.Find(texture->GetNameHash());
+    if (i != textureColors_.End())
+        return i->second_;
+
+    // A streamed texture knows its average color once decoded; until then the impostor stays white rather than
+    // decoding the image again on the main thread
+    TextureStreamer* streamer = GetSubsystem<TextureStreamer>();
+    Color streamedColor;
+    if (streamer && streamer->GetAverageColor(texture->GetName(), streamedColor))
+    {
+        textureColors_[texture->GetNameHash()] = streamedColor;
+        return streamedColor;
+    }
+    if (streamer && streamer->IsPending(texture->GetName()))
+        return Color::WHITE;
+
+    // Halving the image down to a single pixel averages the whole texture. Compressed images cannot be read back
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    SharedPtr<Image> image = cache->GetTempResource<Image>(texture->GetName(), false);
+    while (image && !image->IsCompressed() && (image->GetWidth() > 1 || image->GetHeight() > 1))
+        image = image->GetNextLevel();
+
+    Color color = image && !image->IsCompressed() ? image->GetPixel(0, 0) : Color::WHITE;
+    color.a_ = 1.0f;
+    textureColors_[texture->GetNameHash()] = color;
+    return color;
+}
+
+void BodyImpostors::OnSceneSet(Scene* scene)
+{
+    if (scene)
+    {
+        SubscribeToEvent(E_POSTUPDATE, URHO3D_HANDLER(BodyImpostors, HandlePostUpdate));
+        SubscribeToEvent(E_FLOATINGORIGINSHIFT, URHO3D_HANDLER(BodyImpostors, HandleFloatingOriginShift));
+        SubscribeToEvent(E_TEXTURESTREAMED, URHO3D_HANDLER(BodyImpostors, HandleTextureStreamed));
+    }
+    else
+    {
+        UnsubscribeFromEvent(E_POSTUPDATE);
+        UnsubscribeFromEvent(E_FLOATINGORIGINSHIFT);
+        UnsubscribeFromEvent(E_TEXTURESTREAMED);
+    }
+}
+
+void BodyImpostors::HandlePostUpdate(StringHash eventType, VariantMap& eventData)
+{
+    // Bodies have moved in the scene update and the camera in the update before
+    Update();
+}
+
+void BodyImpostors::HandleFloatingOriginShift(StringHash eventType, VariantMap& eventData)
+{
+    using namespace FloatingOriginShift;
+
+    // The origin may shift after this component's post-update; refresh so the impostors are not a frame behind
+    if (eventData[P_COMPONENT].GetPtr() == GetScene()->GetComponent<FloatingOrigin>())
+        Update();
+}
+
+void BodyImpostors::HandleTextureStreamed(StringHash eventType, VariantMap& eventData)
+{
+    using namespace TextureStreamed;
+
+    // Bodies added while their texture was streaming got a white impostor
+    Texture* texture = static_cast<Texture*>(eventData[P_TEXTURE].GetPtr());
+    for (unsigned i = 0; i < bodies_.Size(); ++i)
+    {
+        StaticModel* model = bodies_[i].model_;
+        Material* material = model ? model->GetMaterial() : 0;
+        if (material && material->GetTexture(TU_DIFFUSE) == texture)
+            bodies_[i].color_ = GetMaterialColor(material);
+    }
+}
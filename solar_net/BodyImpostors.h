@@ -0,0 +1,128 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+#pragma once
+
+#include <Urho3D/Math/Color.h>
+#include <Urho3D/Scene/Component.h>
+
+namespace Urho3D
+{
+
+class BillboardSet;
+class Camera;
+class Material;
+class StaticModel;
+
+}
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+/// Body that can be swapped to an impostor.
+struct BodyImpostor
+{
+    /// Full model of the body.
+    WeakPtr<StaticModel> model_;
+    /// Impostor color.
+    Color color_;
+    /// Whether the impostor is shown instead of the model.
+    bool active_;
+};
+
+/// Scene-level component swapping bodies that project to a few pixels for camera-facing billboards of their average
+/// color. The billboards all belong to one BillboardSet with a lit material, so however many moons are in view they
+/// cost a single batch per light and four vertices each instead of a full StaticModel. The projected radius is taken
+/// from the same world bounding box the renderer uses for LOD selection. Swapping back uses a slightly larger radius
+/// than swapping out, so that bodies at the threshold do not flicker. Impostors never get smaller than a minimum size,
+/// keeping sub-pixel bodies visible as dots.
+class BodyImpostors : public Component
+{
+    URHO3D_OBJECT(BodyImpostors, Component);
+
+public:
+    /// Construct.
+    BodyImpostors(Context* context);
+    /// Destruct.
+    virtual ~BodyImpostors();
+    /// Register object factory.
+    static void RegisterObject(Context* context);
+
+    /// Add a body. The impostor color is the average color of the diffuse texture of its material. Return the index.
+    unsigned AddBody(StaticModel* model);
+    /// Add a body with a given impostor color. Return the index.
+    unsigned AddBody(StaticModel* model, const Color& color);
+    /// Show every model again and remove all bodies.
+    void RemoveAllBodies();
+    /// Set billboard set displaying the impostors. Billboard i stands for body i.
+    void SetBillboardSet(BillboardSet* billboardSet);
+    /// Set camera used to measure the projected size.
+    void SetCamera(Camera* camera);
+    /// Set projected radius in pixels below which a body becomes an impostor.
+    void SetThreshold(float pixels);
+    /// Set smallest impostor radius in pixels.
+    void SetMinSize(float pixels);
+    /// Swap bodies and place the impostors for the current camera.
+    void Update();
+
+    /// Return number of bodies.
+    unsigned GetNumBodies() const { return bodies_.Size(); }
+    /// Return body.
+    const BodyImpostor& GetBody(unsigned index) const { return bodies_[index]; }
+    /// Return number of bodies currently shown as impostors.
+    unsigned GetNumImpostors() const { return numImpostors_; }
+    /// Return threshold radius in pixels.
+    float GetThreshold() const { return threshold_; }
+    /// Return smallest impostor radius in pixels.
+    float GetMinSize() const { return minSize_; }
+    /// Return average color of the diffuse texture of a material, white if it cannot be read back.
+    Color GetMaterialColor(Material* material);
+
+protected:
+    /// Handle scene being assigned.
+    virtual void OnSceneSet(Scene* scene);
+
+private:
+    /// Handle post-update event.
+    void HandlePostUpdate(StringHash eventType, VariantMap& eventData);
+    /// Handle floating origin shift event.
+    void HandleFloatingOriginShift(StringHash eventType, VariantMap& eventData);
+    /// Handle texture streamed event.
+    void HandleTextureStreamed(StringHash eventType, VariantMap& eventData);
+
+    /// Bodies.
+    Vector<BodyImpostor> bodies_;
+    /// Billboard set displaying the impostors.
+    WeakPtr<BillboardSet> billboardSet_;
+    /// Camera.
+    WeakPtr<Camera> camera_;
+    /// Average texture colors by texture name.
+    HashMap<StringHash, Color> textureColors_;
+    /// Threshold radius in pixels.
+    float threshold_;
+    /// Smallest impostor radius in pixels.
+    float minSize_;
+    /// Number of bodies shown as impostors.
+    unsigned numImpostors_;
+};
@@ -0,0 +1,155 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+// This file does not depend on Urho3D so that the benchmark in bench/ can be built on its own
+
+#include "CommandParser.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+/// Powers of ten exactly representable as doubles.
+static const double EXACT_POWERS_OF_TEN[] =
+{
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20,
+    1e21, 1e22
+};
+/// Largest exactly representable power of ten.
+static const int MAX_EXACT_EXPONENT = 22;
+/// Most significant digits that always fit a double's mantissa exactly.
+static const unsigned MAX_EXACT_DIGITS = 15;
+
+bool CommandLine::TokenizeLine(char*& pos, char* end)
+{
+    numTokens_ = 0;
+    bool valid = true;
+    for (;;)
+    {
+        // Control characters other than the newline, the null character included, separate tokens like spaces do
+        while (pos < end && (unsigned char)*pos <= ' ' && *pos != '\n')
+            ++pos;
+        if (pos == end)
+            return valid;
+        if (*pos == '\n')
+        {
+            ++pos;
+            return valid;
+        }
+
+        char* token = pos;
+        while (pos < end && (unsigned char)*pos > ' ')
+            ++pos;
+        // A rejected line is still scanned to its end, so that the next one starts at the right place
+        if (numTokens_ == MAX_COMMAND_TOKENS || (unsigned)(pos - token) > MAX_COMMAND_TOKEN_LENGTH)
+        {
+            numTokens_ = 0;
+            valid = false;
+        }
+        if (valid)
+            tokens_[numTokens_++] = token;
+
+        if (pos == end)
+        {
+            *pos = 0;
+            return valid;
+        }
+        bool endOfLine = *pos == '\n';
+        *pos++ = 0;
+        if (endOfLine)
+            return valid;
+    }
+}
+
+bool CommandLine::GetFloat(unsigned index, float& value) const
+{
+    if (index >= numTokens_)
+        return false;
+
+    // Plain decimals are converted here: their digits make an exact integer, and one multiplication or division by an
+    // exact power of ten rounds it correctly to a double, which fits a float. Anything else (more digits, large
+    // exponents, hexadecimal) goes through strtod, which is several times slower
+    const char* pos = tokens_[index];
+    bool negative = *pos == '-';
+    if (*pos == '-' || *pos == '+')
+        ++pos;
+    unsigned long long mantissa = 0;
+    unsigned numDigits = 0;
+    int exponent = 0;
+    for (; *pos >= '0' && *pos <= '9'; ++pos, ++numDigits)
+        mantissa = mantissa * 10 + (unsigned)(*pos - '0');
+    if (*pos == '.')
+    {
+        for (++pos; *pos >= '0' && *pos <= '9'; ++pos, ++numDigits, --exponent)
+            mantissa = mantissa * 10 + (unsigned)(*pos - '0');
+    }
+    if (*pos == 'e' || *pos == 'E')
+    {
+        ++pos;
+        bool negativeExponent = *pos == '-';
+        if (*pos == '-' || *pos == '+')
+            ++pos;
+        int written = 0;
+        unsigned numExponentDigits = 0;
+        for (; *pos >= '0' && *pos <= '9' && numExponentDigits < 4; ++pos, ++numExponentDigits)
+            written = written * 10 + (*pos - '0');
+        if (!numExponentDigits)
+            return false;
+        exponent += negativeExponent ? -written : written;
+    }
+
+    if (*pos || !numDigits || numDigits > MAX_EXACT_DIGITS || exponent < -MAX_EXACT_EXPONENT ||
+        exponent > MAX_EXACT_EXPONENT)
+    {
+        // Doubles beyond the float range would become infinities
+        double converted;
+        if (!GetDouble(index, converted) || !isfinite((float)converted))
+            return false;
+        value = (float)converted;
+        return true;
+    }
+
+    double converted = exponent < 0 ? (double)mantissa / EXACT_POWERS_OF_TEN[-exponent] :
+        (double)mantissa * EXACT_POWERS_OF_TEN[exponent];
+    value = (float)(negative ? -converted : converted);
+    return true;
+}
+
+bool CommandLine::GetDouble(unsigned index, double& value) const
+{
+    if (index >= numTokens_)
+        return false;
+    // strtod also reads nan and inf, which no command can use: a NaN would pass every range check
+    char* end;
+    value = strtod(tokens_[index], &end);
+    return end != tokens_[index] && !*end && isfinite(value);
+}
+
+bool CommandLine::GetInt(unsigned index, int& value) const
+{
+    if (index >= numTokens_)
+        return false;
+    char* end;
+    long converted = strtol(tokens_[index], &end, 10);
+    value = (int)converted;
+    return end != tokens_[index] && !*end && converted == value;
+}
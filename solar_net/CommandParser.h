@@ -0,0 +1,63 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+/// Most tokens of a text command, opcode included.
+const unsigned MAX_COMMAND_TOKENS = 16;
+/// Longest token of a text command, in characters.
+const unsigned MAX_COMMAND_TOKEN_LENGTH = 255;
+
+/// Text command split into tokens in place, without copying: the character after each token is overwritten with a
+/// null character, so the tokens are C strings lying in the received buffer. The first token is the opcode.
+/// Fields are bounded by the length of the buffer only, so nothing can overflow; commands with too many tokens or an
+/// overlong token are rejected as a whole.
+class CommandLine
+{
+public:
+    /// Construct empty.
+    CommandLine() : numTokens_(0) {}
+
+    /// Tokenize the line starting at pos, at whitespace and null characters, and advance pos past its newline or to
+    /// end. A buffer of many commands, one per line, is so handled in one pass. The newline, or the character at end
+    /// which must be writable, receives the terminator of the last token. Return false, leaving no tokens, if the line
+    /// has more than MAX_COMMAND_TOKENS tokens or one longer than MAX_COMMAND_TOKEN_LENGTH characters.
+    bool TokenizeLine(char*& pos, char* end);
+
+    /// Return number of tokens.
+    unsigned GetNumTokens() const { return numTokens_; }
+    /// Return token, or an empty string if there are not as many tokens.
+    const char* GetToken(unsigned index) const { return index < numTokens_ ? tokens_[index] : ""; }
+    /// Convert a token to a float. Return false if it is missing, not entirely a number, or not a finite float.
+    bool GetFloat(unsigned index, float& value) const;
+    /// Convert a token to a double. Return false if it is missing, not entirely a number, or not finite.
+    bool GetDouble(unsigned index, double& value) const;
+    /// Convert a token to an integer. Return false if it is missing or not entirely an integer.
+    bool GetInt(unsigned index, int& value) const;
+
+private:
+    /// Tokens.
+    const char* tokens_[MAX_COMMAND_TOKENS];
+    /// Number of tokens.
+    unsigned numTokens_;
+};
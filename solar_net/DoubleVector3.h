@@ -0,0 +1,109 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <Urho3D/Math/Vector3.h>
+
+#include <math.h>
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+/// Three-dimensional vector in double precision, for world positions that do not fit single precision at solar system
+/// scale. Converted to a Vector3 only after subtracting the floating origin.
+class DoubleVector3
+{
+public:
+    /// Construct a zero vector.
+    DoubleVector3() :
+        x_(0.0),
+        y_(0.0),
+        z_(0.0)
+    {
+    }
+
+    /// Construct from coordinates.
+    DoubleVector3(double x, double y, double z) :
+        x_(x),
+        y_(y),
+        z_(z)
+    {
+    }
+
+    /// Construct from a single precision vector.
+    explicit DoubleVector3(const Vector3& vector) :
+        x_(vector.x_),
+        y_(vector.y_),
+        z_(vector.z_)
+    {
+    }
+
+    /// Test for equality with another vector.
+    bool operator ==(const DoubleVector3& rhs) const { return x_ == rhs.x_ && y_ == rhs.y_ && z_ == rhs.z_; }
+    /// Test for inequality with another vector.
+    bool operator !=(const DoubleVector3& rhs) const { return x_ != rhs.x_ || y_ != rhs.y_ || z_ != rhs.z_; }
+    /// Add a vector.
+    DoubleVector3 operator +(const DoubleVector3& rhs) const { return DoubleVector3(x_ + rhs.x_, y_ + rhs.y_, z_ + rhs.z_); }
+    /// Return negation.
+    DoubleVector3 operator -() const { return DoubleVector3(-x_, -y_, -z_); }
+    /// Subtract a vector.
+    DoubleVector3 operator -(const DoubleVector3& rhs) const { return DoubleVector3(x_ - rhs.x_, y_ - rhs.y_, z_ - rhs.z_); }
+    /// Multiply with a scalar.
+    DoubleVector3 operator *(double rhs) const { return DoubleVector3(x_ * rhs, y_ * rhs, z_ * rhs); }
+
+    /// Add-assign a vector.
+    DoubleVector3& operator +=(const DoubleVector3& rhs)
+    {
+        x_ += rhs.x_;
+        y_ += rhs.y_;
+        z_ += rhs.z_;
+        return *this;
+    }
+
+    /// Subtract-assign a vector.
+    DoubleVector3& operator -=(const DoubleVector3& rhs)
+    {
+        x_ -= rhs.x_;
+        y_ -= rhs.y_;
+        z_ -= rhs.z_;
+        return *this;
+    }
+
+    /// Return length.
+    double Length() const { return sqrt(x_ * x_ + y_ * y_ + z_ * z_); }
+    /// Return squared length.
+    double LengthSquared() const { return x_ * x_ + y_ * y_ + z_ * z_; }
+    /// Return as a single precision vector.
+    Vector3 ToVector3() const { return Vector3((float)x_, (float)y_, (float)z_); }
+
+    /// X coordinate.
+    double x_;
+    /// Y coordinate.
+    double y_;
+    /// Z coordinate.
+    double z_;
+
+    /// Zero vector.
+    static const DoubleVector3 ZERO;
+};
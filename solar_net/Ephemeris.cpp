@@ -0,0 +1,125 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "Ephemeris.h"
+
+#include <math.h>
+
+#include <Urho3D/DebugNew.h>
+
+OrbitBasis MakeOrbitBasis(const OrbitalElements& elements)
+{
+    OrbitBasis orbit;
+
+    double e = elements.eccentricity_;
+    orbit.semiMajorAxis_ = elements.semiMajorAxis_;
+    orbit.semiMinorAxis_ = elements.semiMajorAxis_ * sqrt(1.0 - e * e);
+    orbit.eccentricity_ = e;
+    orbit.meanAnomalyAtEpoch_ = elements.meanAnomalyAtEpoch_ * DOUBLE_DEGTORAD;
+    orbit.meanMotion_ = elements.period_ > 0.0 ? 2.0 * DOUBLE_PI / elements.period_ : 0.0;
+    orbit.epoch_ = elements.epoch_;
+
+    double cosNode = cos(elements.ascendingNode_ * DOUBLE_DEGTORAD);
+    double sinNode = sin(elements.ascendingNode_ * DOUBLE_DEGTORAD);
+    double cosPeri = cos(elements.argumentOfPeriapsis_ * DOUBLE_DEGTORAD);
+    double sinPeri = sin(elements.argumentOfPeriapsis_ * DOUBLE_DEGTORAD);
+    double cosIncl = cos(elements.inclination_ * DOUBLE_DEGTORAD);
+    double sinIncl = sin(elements.inclination_ * DOUBLE_DEGTORAD);
+
+    // Rotate the orbital plane by periapsis, inclination and node (ecliptic X, Y, Z), then map ecliptic north to scene
+    // up: ecliptic (x, y, z) becomes scene (x, z, y), which keeps prograde orbits turning the same way the scene's
+    // former negative-yaw revolutions did
+    double px = cosNode * cosPeri - sinNode * sinPeri * cosIncl;
+    double py = sinNode * cosPeri + cosNode * sinPeri * cosIncl;
+    double pz = sinPeri * sinIncl;
+    double qx = -cosNode * sinPeri - sinNode * cosPeri * cosIncl;
+    double qy = -sinNode * sinPeri + cosNode * cosPeri * cosIncl;
+    double qz = cosPeri * sinIncl;
+
+    orbit.periapsisAxis_[0] = px;
+    orbit.periapsisAxis_[1] = pz;
+    orbit.periapsisAxis_[2] = py;
+    orbit.normalAxis_[0] = qx;
+    orbit.normalAxis_[1] = qz;
+    orbit.normalAxis_[2] = qy;
+
+    return orbit;
+}
+
+double GetMeanAnomaly(const OrbitBasis& orbit, double time)
+{
+    double meanAnomaly = orbit.meanAnomalyAtEpoch_ + orbit.meanMotion_ * (time - orbit.epoch_);
+    meanAnomaly = fmod(meanAnomaly + DOUBLE_PI, 2.0 * DOUBLE_PI);
+    if (meanAnomaly < 0.0)
+        meanAnomaly += 2.0 * DOUBLE_PI;
+    return meanAnomaly - DOUBLE_PI;
+}
+
+double SolveKepler(double meanAnomaly, double eccentricity)
+{
+    // Danby's starting value keeps Newton's iteration convergent for every eccentricity below 1
+    double eccentricAnomaly = meanAnomaly + (meanAnomaly < 0.0 ? -0.85 : 0.85) * eccentricity;
+
+    for (unsigned i = 0; i < 16; ++i)
+    {
+        double f = eccentricAnomaly - eccentricity * sin(eccentricAnomaly) - meanAnomaly;
+        double delta = f / (1.0 - eccentricity * cos(eccentricAnomaly));
+        eccentricAnomaly -= delta;
+        if (fabs(delta) < 1e-12)
+            break;
+    }
+
+    return eccentricAnomaly;
+}
+
+double RefineKepler(double meanAnomaly, double eccentricity, double eccentricAnomaly)
+{
+    double f = eccentricAnomaly - eccentricity * sin(eccentricAnomaly) - meanAnomaly;
+    return eccentricAnomaly - f / (1.0 - eccentricity * cos(eccentricAnomaly));
+}
+
+DoubleVector3 GetOrbitPositionAtAnomaly(const OrbitBasis& orbit, double eccentricAnomaly)
+{
+    double x = orbit.semiMajorAxis_ * (cos(eccentricAnomaly) - orbit.eccentricity_);
+    double y = orbit.semiMinorAxis_ * sin(eccentricAnomaly);
+
+    return DoubleVector3(
+        orbit.periapsisAxis_[0] * x + orbit.normalAxis_[0] * y,
+        orbit.periapsisAxis_[1] * x + orbit.normalAxis_[1] * y,
+        orbit.periapsisAxis_[2] * x + orbit.normalAxis_[2] * y);
+}
+
+DoubleVector3 GetOrbitPosition(const OrbitBasis& orbit, double time)
+{
+    return GetOrbitPositionAtAnomaly(orbit, SolveKepler(GetMeanAnomaly(orbit, time), orbit.eccentricity_));
+}
+
+DoubleVector3 GetOrbitPosition(const OrbitalElements& elements, double time)
+{
+    return GetOrbitPosition(MakeOrbitBasis(elements), time);
+}
+
+float GetRotationSpeed(double periodHours)
+{
+    return periodHours != 0.0 ? (float)(-360.0 / (periodHours * 3600.0)) : 0.0f;
+}
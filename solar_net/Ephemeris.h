@@ -0,0 +1,128 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "DoubleVector3.h"
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+/// Seconds in a day.
+static const double SECONDS_PER_DAY = 86400.0;
+/// Pi in double precision.
+static const double DOUBLE_PI = 3.14159265358979323846;
+/// Degrees to radians in double precision.
+static const double DOUBLE_DEGTORAD = DOUBLE_PI / 180.0;
+/// Scene units per astronomical unit. One scene unit is a thousand kilometres.
+static const double UNITS_PER_AU = 149597.8707;
+/// Gravitational parameter (G * mass) of the Sun in world units cubed per second squared.
+static const double SUN_GRAVITATIONAL_PARAMETER = 132.712440018;
+
+/// Classical Keplerian orbital elements of a body around its parent. Time is counted in seconds since the J2000 epoch,
+/// angles are in degrees and the semi-major axis is in scene units (thousands of km, see UNITS_PER_AU).
+struct OrbitalElements
+{
+    /// Construct with a circular orbit of unit radius and a one day period.
+    OrbitalElements() :
+        semiMajorAxis_(1.0),
+        eccentricity_(0.0),
+        inclination_(0.0),
+        ascendingNode_(0.0),
+        argumentOfPeriapsis_(0.0),
+        meanAnomalyAtEpoch_(0.0),
+        period_(SECONDS_PER_DAY),
+        epoch_(0.0)
+    {
+    }
+
+    /// Construct from elements, period in days.
+    OrbitalElements(double semiMajorAxis, double eccentricity, double inclination, double ascendingNode,
+        double argumentOfPeriapsis, double meanAnomalyAtEpoch, double periodDays, double epoch = 0.0) :
+        semiMajorAxis_(semiMajorAxis),
+        eccentricity_(eccentricity),
+        inclination_(inclination),
+        ascendingNode_(ascendingNode),
+        argumentOfPeriapsis_(argumentOfPeriapsis),
+        meanAnomalyAtEpoch_(meanAnomalyAtEpoch),
+        period_(periodDays * SECONDS_PER_DAY),
+        epoch_(epoch)
+    {
+    }
+
+    /// Semi-major axis.
+    double semiMajorAxis_;
+    /// Eccentricity, in [0, 1).
+    double eccentricity_;
+    /// Inclination to the reference plane.
+    double inclination_;
+    /// Longitude of the ascending node.
+    double ascendingNode_;
+    /// Argument of periapsis.
+    double argumentOfPeriapsis_;
+    /// Mean anomaly at epoch.
+    double meanAnomalyAtEpoch_;
+    /// Orbital period in seconds.
+    double period_;
+    /// Epoch of the elements in seconds since J2000.
+    double epoch_;
+};
+
+/// Orbit in the form evaluated every frame: the in-plane ellipse plus the two unit vectors spanning the orbital plane.
+/// Position at time t is periapsisAxis_ * a * (cos E - e) + normalAxis_ * b * sin E, with E the eccentric anomaly.
+struct OrbitBasis
+{
+    /// Semi-major axis.
+    double semiMajorAxis_;
+    /// Semi-minor axis.
+    double semiMinorAxis_;
+    /// Eccentricity.
+    double eccentricity_;
+    /// Mean anomaly at epoch in radians.
+    double meanAnomalyAtEpoch_;
+    /// Mean motion in radians per second.
+    double meanMotion_;
+    /// Epoch in seconds since J2000.
+    double epoch_;
+    /// Unit vector towards periapsis, in scene axes.
+    double periapsisAxis_[3];
+    /// Unit vector 90 degrees ahead of periapsis in the orbital plane, in scene axes.
+    double normalAxis_[3];
+};
+
+/// Precompute the evaluation basis of an orbit.
+OrbitBasis MakeOrbitBasis(const OrbitalElements& elements);
+/// Return mean anomaly of an orbit at time, wrapped to [-pi, pi).
+double GetMeanAnomaly(const OrbitBasis& orbit, double time);
+/// Solve Kepler's equation M = E - e sin E for the eccentric anomaly. Mean anomaly in radians within [-pi, pi).
+double SolveKepler(double meanAnomaly, double eccentricity);
+/// Refine an eccentric anomaly estimate (e.g. from the single precision batch solver) with one Newton step.
+double RefineKepler(double meanAnomaly, double eccentricity, double eccentricAnomaly);
+/// Return position of an orbiting body relative to its parent from its eccentric anomaly, in scene axes.
+DoubleVector3 GetOrbitPositionAtAnomaly(const OrbitBasis& orbit, double eccentricAnomaly);
+/// Return position of an orbiting body relative to its parent at time, in scene axes.
+DoubleVector3 GetOrbitPosition(const OrbitBasis& orbit, double time);
+/// Return position of an orbiting body relative to its parent at time, in scene axes.
+DoubleVector3 GetOrbitPosition(const OrbitalElements& elements, double time);
+/// Return rotation speed about the body axis in degrees per second for a sidereal rotation period in hours.
+float GetRotationSpeed(double periodHours);
@@ -0,0 +1,112 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "FloatingOrigin.h"
+
+#include <Urho3D/DebugNew.h>
+
+const DoubleVector3 DoubleVector3::ZERO;
+
+/// Default rebase distance. Single precision still resolves half a metre at this distance in thousand-km units.
+static const float DEFAULT_REBASE_DISTANCE = 4096.0f;
+
+FloatingOrigin::FloatingOrigin(Context* context) :
+    Component(context),
+    rebaseDistance_(DEFAULT_REBASE_DISTANCE)
+{
+}
+
+FloatingOrigin::~FloatingOrigin()
+{
+}
+
+void FloatingOrigin::RegisterObject(Context* context)
+{
+    context->RegisterFactory<FloatingOrigin>();
+}
+
+void FloatingOrigin::SetCameraNode(Node* node)
+{
+    cameraNode_ = node;
+}
+
+void FloatingOrigin::SetWorldRoot(Node* node)
+{
+    worldRoot_ = node;
+    if (worldRoot_)
+        worldRoot_->SetPosition(ToRender(DoubleVector3::ZERO));
+}
+
+void FloatingOrigin::SetRebaseDistance(float distance)
+{
+    rebaseDistance_ = Max(distance, 0.0f);
+}
+
+void FloatingOrigin::SetOrigin(const DoubleVector3& origin)
+{
+    if (origin == origin_)
+        return;
+
+    DoubleVector3 delta = origin - origin_;
+    origin_ = origin;
+
+    if (cameraNode_)
+        cameraNode_->SetPosition((DoubleVector3(cameraNode_->GetPosition()) - delta).ToVector3());
+    if (worldRoot_)
+        worldRoot_->SetPosition(ToRender(DoubleVector3::ZERO));
+
+    using namespace FloatingOriginShift;
+
+    VariantMap& eventData = GetEventDataMap();
+    eventData[P_COMPONENT] = this;
+    SendEvent(E_FLOATINGORIGINSHIFT, eventData);
+}
+
+void FloatingOrigin::Rebase()
+{
+    if (cameraNode_)
+        SetOrigin(GetCameraWorldPosition());
+}
+
+DoubleVector3 FloatingOrigin::GetCameraWorldPosition() const
+{
+    return cameraNode_ ? ToWorld(cameraNode_->GetPosition()) : origin_;
+}
+
+void FloatingOrigin::OnSceneSet(Scene* scene)
+{
+    if (scene)
+        SubscribeToEvent(E_POSTUPDATE, URHO3D_HANDLER(FloatingOrigin, HandlePostUpdate));
+    else
+        UnsubscribeFromEvent(E_POSTUPDATE);
+}
+
+void FloatingOrigin::HandlePostUpdate(StringHash eventType, VariantMap& eventData)
+{
+    if (cameraNode_ && cameraNode_->GetPosition().LengthSquared() > rebaseDistance_ * rebaseDistance_)
+        Rebase();
+}
@@ -0,0 +1,98 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <Urho3D/Scene/Component.h>
+
+#include "DoubleVector3.h"
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+/// Floating origin moved. Components holding double precision world positions should refresh their render positions.
+URHO3D_EVENT(E_FLOATINGORIGINSHIFT, FloatingOriginShift)
+{
+    URHO3D_PARAM(P_COMPONENT, Component);       // FloatingOrigin pointer
+}
+
+/// Scene-level component mapping the double precision world to single precision render space around the camera.
+/// Render position = world position - origin. The origin jumps to the camera whenever the camera gets further than the
+/// rebase distance from it, so everything near the camera always has small, precise render coordinates, while the
+/// octree only sees the scene shift on those rare jumps instead of every frame. Static content lives under a world root
+/// node that is kept at -origin; moving bodies convert their own double precision positions with ToRender().
+class FloatingOrigin : public Component
+{
+    URHO3D_OBJECT(FloatingOrigin, Component);
+
+public:
+    /// Construct.
+    FloatingOrigin(Context* context);
+    /// Destruct.
+    virtual ~FloatingOrigin();
+    /// Register object factory.
+    static void RegisterObject(Context* context);
+
+    /// Set camera node. Its position is in render space.
+    void SetCameraNode(Node* node);
+    /// Set world root node, parent of the static content placed in world coordinates. Must be a child of the scene.
+    void SetWorldRoot(Node* node);
+    /// Set distance from the origin at which the camera triggers a rebase. Zero rebases on every camera move.
+    void SetRebaseDistance(float distance);
+    /// Move the origin to a world position. Camera and world root keep their world positions.
+    void SetOrigin(const DoubleVector3& origin);
+    /// Move the origin to the camera now.
+    void Rebase();
+
+    /// Return origin in world coordinates.
+    const DoubleVector3& GetOrigin() const { return origin_; }
+    /// Return camera node.
+    Node* GetCameraNode() const { return cameraNode_; }
+    /// Return world root node.
+    Node* GetWorldRoot() const { return worldRoot_; }
+    /// Return rebase distance.
+    float GetRebaseDistance() const { return rebaseDistance_; }
+    /// Return camera position in world coordinates.
+    DoubleVector3 GetCameraWorldPosition() const;
+    /// Convert a world position to render space.
+    Vector3 ToRender(const DoubleVector3& worldPosition) const { return (worldPosition - origin_).ToVector3(); }
+    /// Convert a render space position to world coordinates.
+    DoubleVector3 ToWorld(const Vector3& renderPosition) const { return origin_ + DoubleVector3(renderPosition); }
+
+protected:
+    /// Handle scene being assigned.
+    virtual void OnSceneSet(Scene* scene);
+
+private:
+    /// Handle logic post-update event, after the camera and the scene have moved for this frame.
+    void HandlePostUpdate(StringHash eventType, VariantMap& eventData);
+
+    /// Camera node.
+    WeakPtr<Node> cameraNode_;
+    /// World root node.
+    WeakPtr<Node> worldRoot_;
+    /// Origin in world coordinates.
+    DoubleVector3 origin_;
+    /// Rebase distance.
+    float rebaseDistance_;
+};
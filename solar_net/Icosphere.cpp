@@ -0,0 +1,281 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Graphics/Geometry.h>
+#include <Urho3D/Graphics/IndexBuffer.h>
+#include <Urho3D/Graphics/Model.h>
+#include <Urho3D/Graphics/VertexBuffer.h>
+
+#include "Icosphere.h"
+
+#include <Urho3D/DebugNew.h>
+
+/// Angle between neighbouring vertices of the icosahedron, in radians.
+static const float ICOSAHEDRON_EDGE_ANGLE = 1.10714872f;
+/// Floats per vertex: position, normal and texture coordinate.
+static const unsigned ICOSPHERE_VERTEX_SIZE = 8;
+/// Vertex elements of the icosphere.
+static const unsigned ICOSPHERE_ELEMENT_MASK = MASK_POSITION | MASK_NORMAL | MASK_TEXCOORD1;
+
+/// Triangulated unit sphere.
+struct SphereMesh
+{
+    /// Vertex directions.
+    PODVector<Vector3> directions_;
+    /// Triangle vertex indices, wound clockwise seen from outside.
+    PODVector<unsigned> indices_;
+};
+
+static void AddTriangle(SphereMesh& mesh, unsigned a, unsigned b, unsigned c)
+{
+    const Vector3& va = mesh.directions_[a];
+    const Vector3& vb = mesh.directions_[b];
+    const Vector3& vc = mesh.directions_[c];
+    // Front faces are clockwise, whose plain cross product points towards the viewer
+    if ((vb - va).CrossProduct(vc - va).DotProduct(va + vb + vc) < 0.0f)
+        Swap(b, c);
+    mesh.indices_.Push(a);
+    mesh.indices_.Push(b);
+    mesh.indices_.Push(c);
+}
+
+static void CreateIcosahedron(SphereMesh& mesh)
+{
+    // The poles, then two rings of five vertices at latitude +-atan(1/2) offset by 36 degrees
+    float ringY = 1.0f / sqrtf(5.0f);
+    float ringRadius = 2.0f / sqrtf(5.0f);
+    mesh.directions_.Push(Vector3::UP);
+    mesh.directions_.Push(Vector3::DOWN);
+    for (unsigned i = 0; i < 5; ++i)
+        mesh.directions_.Push(Vector3(ringRadius * Cos(i * 72.0f), ringY, ringRadius * Sin(i * 72.0f)));
+    for (unsigned i = 0; i < 5; ++i)
+        mesh.directions_.Push(Vector3(ringRadius * Cos(i * 72.0f + 36.0f), -ringY, ringRadius * Sin(i * 72.0f + 36.0f)));
+
+    for (unsigned i = 0; i < 5; ++i)
+    {
+        unsigned upper = 2 + i;
+        unsigned nextUpper = 2 + (i + 1) % 5;
+        unsigned lower = 7 + i;
+        unsigned nextLower = 7 + (i + 1) % 5;
+        AddTriangle(mesh, 0, upper, nextUpper);
+        AddTriangle(mesh, upper, lower, nextUpper);
+        AddTriangle(mesh, nextUpper, lower, nextLower);
+        AddTriangle(mesh, 1, lower, nextLower);
+    }
+}
+
+static unsigned GetMidpoint(SphereMesh& mesh, HashMap<unsigned long long, unsigned>& midpoints, unsigned a, unsigned b)
+{
+    unsigned long long key = a < b ? ((unsigned long long)a << 32) | b : ((unsigned long long)b << 32) | a;
+    HashMap<unsigned long long, unsigned>::ConstIterator i = midpoints.Find(key);
+    if (i != midpoints.End())
+        return i->second_;
+
+    unsigned index = mesh.directions_.Size();
+    mesh.directions_.Push((mesh.directions_[a] + mesh.directions_[b]).Normalized());
+    midpoints[key] = index;
+    return index;
+}
+
+static void Subdivide(SphereMesh& mesh)
+{
+    // Split every triangle in four. The corner triangles keep the winding of their parent
+    PODVector<unsigned> source(mesh.indices_);
+    HashMap<unsigned long long, unsigned> midpoints;
+    mesh.indices_.Clear();
+    mesh.indices_.Reserve(source.Size() * 4);
+    for (unsigned i = 0; i < source.Size(); i += 3)
+    {
+        unsigned a = source[i];
+        unsigned b = source[i + 1];
+        unsigned c = source[i + 2];
+        unsigned ab = GetMidpoint(mesh, midpoints, a, b);
+        unsigned bc = GetMidpoint(mesh, midpoints, b, c);
+        unsigned ca = GetMidpoint(mesh, midpoints, c, a);
+        unsigned triangles[] = { a, ab, ca, ab, b, bc, ca, bc, c, ab, bc, ca };
+        for (unsigned j = 0; j < 12; ++j)
+            mesh.indices_.Push(triangles[j]);
+    }
+}
+
+static unsigned AddVertex(PODVector<float>& vertexData, const Vector3& direction, float u, float v)
+{
+    unsigned index = vertexData.Size() / ICOSPHERE_VERTEX_SIZE;
+    Vector3 position = direction * 0.5f;
+    vertexData.Push(position.x_);
+    vertexData.Push(position.y_);
+    vertexData.Push(position.z_);
+    vertexData.Push(direction.x_);
+    vertexData.Push(direction.y_);
+    vertexData.Push(direction.z_);
+    vertexData.Push(u);
+    vertexData.Push(v);
+    return index;
+}
+
+static SharedPtr<Geometry> CreateGeometry(Context* context, const SphereMesh& mesh,
+    Vector<SharedPtr<VertexBuffer> >& vertexBuffers, Vector<SharedPtr<IndexBuffer> >& indexBuffers)
+{
+    unsigned numDirections = mesh.directions_.Size();
+    PODVector<float> vertexData;
+    PODVector<float> texCoordU(numDirections);
+    PODVector<unsigned> wrapped(numDirections);
+    PODVector<unsigned> indices;
+    vertexData.Reserve(numDirections * ICOSPHERE_VERTEX_SIZE);
+    indices.Reserve(mesh.indices_.Size());
+
+    // Equirectangular mapping, u growing eastwards from the -X meridian and v from the north pole. Every direction
+    // gets a vertex; triangles across the seam use a copy with u + 1, created on demand
+    for (unsigned i = 0; i < numDirections; ++i)
+    {
+        const Vector3& direction = mesh.directions_[i];
+        texCoordU[i] = 0.5f + atan2f(direction.z_, direction.x_) / (2.0f * M_PI);
+        AddVertex(vertexData, direction, texCoordU[i], 0.5f - asinf(Clamp(direction.y_, -1.0f, 1.0f)) / M_PI);
+        wrapped[i] = M_MAX_UNSIGNED;
+    }
+
+    for (unsigned i = 0; i < mesh.indices_.Size(); i += 3)
+    {
+        unsigned triangle[3];
+        float u[3];
+        bool pole[3];
+        float minU = 1.0f;
+        float maxU = 0.0f;
+        for (unsigned j = 0; j < 3; ++j)
+        {
+            triangle[j] = mesh.indices_[i + j];
+            u[j] = texCoordU[triangle[j]];
+            pole[j] = Abs(mesh.directions_[triangle[j]].y_) > 0.9999f;
+            if (!pole[j])
+            {
+                minU = Min(minU, u[j]);
+                maxU = Max(maxU, u[j]);
+            }
+        }
+
+        if (maxU - minU > 0.5f)
+        {
+            for (unsigned j = 0; j < 3; ++j)
+            {
+                if (pole[j] || u[j] >= 0.5f)
+                    continue;
+                unsigned index = triangle[j];
+                if (wrapped[index] == M_MAX_UNSIGNED)
+                {
+                    const float* source = &vertexData[index * ICOSPHERE_VERTEX_SIZE];
+                    wrapped[index] = AddVertex(vertexData, mesh.directions_[index], u[j] + 1.0f, source[7]);
+                }
+                triangle[j] = wrapped[index];
+                u[j] += 1.0f;
+            }
+        }
+
+        // A pole has no longitude: each triangle gets its own pole vertex halfway between its other two
+        for (unsigned j = 0; j < 3; ++j)
+        {
+            if (pole[j])
+            {
+                const Vector3& direction = mesh.directions_[triangle[j]];
+                float poleU = 0.5f * (u[(j + 1) % 3] + u[(j + 2) % 3]);
+                triangle[j] = AddVertex(vertexData, direction, poleU, direction.y_ > 0.0f ? 0.0f : 1.0f);
+            }
+        }
+
+        for (unsigned j = 0; j < 3; ++j)
+            indices.Push(triangle[j]);
+    }
+
+    unsigned numVertices = vertexData.Size() / ICOSPHERE_VERTEX_SIZE;
+    SharedPtr<VertexBuffer> vertexBuffer(new VertexBuffer(context));
+    vertexBuffer->SetShadowed(true);
+    vertexBuffer->SetSize(numVertices, ICOSPHERE_ELEMENT_MASK);
+    vertexBuffer->SetData(&vertexData[0]);
+
+    bool largeIndices = numVertices > 65535;
+    SharedPtr<IndexBuffer> indexBuffer(new IndexBuffer(context));
+    indexBuffer->SetShadowed(true);
+    indexBuffer->SetSize(indices.Size(), largeIndices);
+    if (largeIndices)
+        indexBuffer->SetData(&indices[0]);
+    else
+    {
+        PODVector<unsigned short> shortIndices(indices.Size());
+        for (unsigned i = 0; i < indices.Size(); ++i)
+            shortIndices[i] = (unsigned short)indices[i];
+        indexBuffer->SetData(&shortIndices[0]);
+    }
+
+    SharedPtr<Geometry> geometry(new Geometry(context));
+    geometry->SetVertexBuffer(0, vertexBuffer, ICOSPHERE_ELEMENT_MASK);
+    geometry->SetIndexBuffer(indexBuffer);
+    geometry->SetDrawRange(TRIANGLE_LIST, 0, indices.Size());
+
+    vertexBuffers.Push(vertexBuffer);
+    indexBuffers.Push(indexBuffer);
+    return geometry;
+}
+
+SharedPtr<Model> CreateIcosphereModel(Context* context, unsigned maxSubdivisions, float screenHeight, float fov,
+    float maxError)
+{
+    SharedPtr<Model> model(new Model(context));
+    Vector<SharedPtr<VertexBuffer> > vertexBuffers;
+    Vector<SharedPtr<IndexBuffer> > indexBuffers;
+    model->SetNumGeometries(1);
+    model->SetNumGeometryLodLevels(0, maxSubdivisions + 1);
+
+    // A chord spanning an angle a sags r a^2 / 8 below the sphere. The renderer compares view distance divided by the
+    // drawable size (here the diameter) to the LOD distances, and at that ratio d the radius r projects to
+    // screenHeight / (4 d tan(fov / 2)) pixels, so a level with edge angle a is good enough from
+    // d = screenHeight a^2 / (32 maxError tan(fov / 2)) on
+    float lodScale = screenHeight / (32.0f * Max(maxError, M_EPSILON) * tanf(fov * 0.5f * M_DEGTORAD));
+
+    SphereMesh mesh;
+    CreateIcosahedron(mesh);
+    for (unsigned subdivisions = 0; subdivisions <= maxSubdivisions; ++subdivisions)
+    {
+        if (subdivisions)
+            Subdivide(mesh);
+
+        float edgeAngle = ICOSAHEDRON_EDGE_ANGLE / (float)(1u << subdivisions);
+        unsigned lodLevel = maxSubdivisions - subdivisions;
+        SharedPtr<Geometry> geometry = CreateGeometry(context, mesh, vertexBuffers, indexBuffers);
+        geometry->SetLodDistance(lodLevel ? lodScale * edgeAngle * edgeAngle : 0.0f);
+        model->SetGeometry(0, lodLevel, geometry);
+    }
+
+    PODVector<unsigned> morphRangeStarts(vertexBuffers.Size());
+    PODVector<unsigned> morphRangeCounts(vertexBuffers.Size());
+    for (unsigned i = 0; i < vertexBuffers.Size(); ++i)
+    {
+        morphRangeStarts[i] = 0;
+        morphRangeCounts[i] = 0;
+    }
+    model->SetVertexBuffers(vertexBuffers, morphRangeStarts, morphRangeCounts);
+    model->SetIndexBuffers(indexBuffers);
+    model->SetBoundingBox(BoundingBox(-0.5f, 0.5f));
+    model->SetGeometryCenter(0, Vector3::ZERO);
+    return model;
+}
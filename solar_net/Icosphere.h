@@ -20,28 +20,27 @@
 // THE SOFTWARE.
 //
 
-#include <Urho3D/Scene/Scene.h>
 
-#include "Rotator.h"
 
-#include <Urho3D/DebugNew.h>
+#pragma once
 
-Rotator::Rotator(Context* context) :
-    LogicComponent(context),
-    rotationSpeed_(Vector3::ZERO)
-{
-    // Only the scene update event is needed: unsubscribe from the rest for optimization
-    SetUpdateEventMask(USE_UPDATE);
-}
+#include <Urho3D/Container/Ptr.h>
 
-void Rotator::SetRotationSpeed(const Vector3& speed)
+namespace Urho3D
 {
-    rotationSpeed_ = speed;
-}
 
-void Rotator::Update(float timeStep)
-{
-    // Components have their scene node as a member variable for convenient access. Rotate the scene node now: construct a
-    // rotation quaternion from Euler angles, scale rotation speed with the scene update time step
-    node_->Rotate(Quaternion(rotationSpeed_.x_ * timeStep, rotationSpeed_.y_ * timeStep, rotationSpeed_.z_ * timeStep));
+class Context;
+class Model;
+
 }
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+/// Create a unit diameter sphere model from a subdivided icosahedron, with one LOD level per subdivision count from
+/// maxSubdivisions (LOD 0) down to the bare icosahedron. Vertices have a normal and equirectangular texture
+/// coordinates; the north pole is +Y. The LOD distances are set so that the silhouette of each level deviates from the
+/// true sphere by at most maxError pixels on a screenHeight pixels high viewport with the given vertical field of view in
+/// degrees. As the renderer divides the view distance by the drawable size, this picks the level by projected radius.
+SharedPtr<Model> CreateIcosphereModel(Context* context, unsigned maxSubdivisions, float screenHeight, float fov,
+    float maxError = 1.0f);
@@ -0,0 +1,397 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+// This file does not depend on Urho3D so that the benchmark in bench/ can be built on its own
+
+#include "KeplerSolver.h"
+
+#include <math.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define KEPLER_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define KEPLER_TARGET_AVX2
+#else
+#define KEPLER_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// Every path runs the same sequence of single precision operations per body, without fused multiply-adds, so that
+// machines picking different paths return bit-identical results. A body stops iterating on its own once converged,
+// whichever lanes it shares a vector with. Compilers must not contract them either: see the -ffp-contract=off flag
+// in CMakeLists.txt and bench/cmd.sh
+
+/// Newton iterations of a body are stopped once it moved less than this (a few float ulps around pi).
+static const float KEPLER_TOLERANCE = 2e-6f;
+/// Iteration cap. Danby's starting value converges in under 6 iterations except for e close to 1 near periapsis.
+static const unsigned KEPLER_MAX_ITERATIONS = 12;
+
+// Cephes single precision sine / cosine coefficients
+static const float SINCOS_FOPI = 1.27323954473516f;
+static const float SINCOS_DP1 = 0.78515625f;
+static const float SINCOS_DP2 = 2.4187564849853515625e-4f;
+static const float SINCOS_DP3 = 3.77489497744594108e-8f;
+static const float SINCOS_SIN0 = -1.9515295891e-4f;
+static const float SINCOS_SIN1 = 8.3321608736e-3f;
+static const float SINCOS_SIN2 = -1.6666654611e-1f;
+static const float SINCOS_COS0 = 2.443315711809948e-5f;
+static const float SINCOS_COS1 = -1.388731625493765e-3f;
+static const float SINCOS_COS2 = 4.166664568298827e-2f;
+
+static void SinCosScalar(float x, float& s, float& c)
+{
+    bool negative = signbit(x) != 0;
+    x = fabsf(x);
+
+    // Octant of the argument, rounded up to even
+    int octant = ((int)(x * SINCOS_FOPI) + 1) & ~1;
+    float y = (float)octant;
+
+    bool negateSin = negative != ((octant & 4) != 0);
+    bool negateCos = ((octant - 2) & 4) == 0;
+
+    // Extended precision modular arithmetic
+    x = x - y * SINCOS_DP1;
+    x = x - y * SINCOS_DP2;
+    x = x - y * SINCOS_DP3;
+    float z = x * x;
+
+    float polyCos = SINCOS_COS0 * z + SINCOS_COS1;
+    polyCos = polyCos * z + SINCOS_COS2;
+    polyCos = polyCos * z * z;
+    polyCos = polyCos - z * 0.5f + 1.0f;
+
+    float polySin = SINCOS_SIN0 * z + SINCOS_SIN1;
+    polySin = polySin * z + SINCOS_SIN2;
+    polySin = polySin * z * x + x;
+
+    bool swap = (octant & 2) != 0;
+    float sinValue = swap ? polyCos : polySin;
+    float cosValue = swap ? polySin : polyCos;
+    s = negateSin ? -sinValue : sinValue;
+    c = negateCos ? -cosValue : cosValue;
+}
+
+static void SolveScalar(const float* meanAnomaly, const float* eccentricity, float* eccentricAnomaly, float* cosE, float* sinE,
+    unsigned count)
+{
+    for (unsigned i = 0; i < count; ++i)
+    {
+        float m = meanAnomaly[i];
+        float e = eccentricity[i];
+        float ea = m + copysignf(0.85f, m) * e;
+        float s, c;
+
+        for (unsigned j = 0; j < KEPLER_MAX_ITERATIONS; ++j)
+        {
+            SinCosScalar(ea, s, c);
+            float delta = (ea - e * s - m) / (1.0f - e * c);
+            ea -= delta;
+            if (!(fabsf(delta) >= KEPLER_TOLERANCE))
+                break;
+        }
+
+        eccentricAnomaly[i] = ea;
+        if (cosE || sinE)
+        {
+            SinCosScalar(ea, s, c);
+            if (cosE)
+                cosE[i] = c;
+            if (sinE)
+                sinE[i] = s;
+        }
+    }
+}
+
+#ifdef KEPLER_X86
+
+static inline void SinCosSSE(__m128 x, __m128& s, __m128& c)
+{
+    const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32((int)0x80000000));
+
+    __m128 signSin = _mm_and_ps(x, signMask);
+    x = _mm_andnot_ps(signMask, x);
+
+    // Octant of the argument, rounded up to even
+    __m128i octant = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(SINCOS_FOPI)));
+    octant = _mm_and_si128(_mm_add_epi32(octant, _mm_set1_epi32(1)), _mm_set1_epi32(~1));
+    __m128 y = _mm_cvtepi32_ps(octant);
+
+    __m128 swapSignSin = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(octant, _mm_set1_epi32(4)), 29));
+    __m128 polyMask = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(octant, _mm_set1_epi32(2)), _mm_setzero_si128()));
+    __m128 signCos = _mm_castsi128_ps(_mm_slli_epi32(
+        _mm_andnot_si128(_mm_sub_epi32(octant, _mm_set1_epi32(2)), _mm_set1_epi32(4)), 29));
+    signSin = _mm_xor_ps(signSin, swapSignSin);
+
+    // Extended precision modular arithmetic
+    x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(SINCOS_DP1)));
+    x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(SINCOS_DP2)));
+    x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(SINCOS_DP3)));
+    __m128 z = _mm_mul_ps(x, x);
+
+    __m128 polyCos = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(SINCOS_COS0), z), _mm_set1_ps(SINCOS_COS1));
+    polyCos = _mm_add_ps(_mm_mul_ps(polyCos, z), _mm_set1_ps(SINCOS_COS2));
+    polyCos = _mm_mul_ps(_mm_mul_ps(polyCos, z), z);
+    polyCos = _mm_add_ps(_mm_sub_ps(polyCos, _mm_mul_ps(z, _mm_set1_ps(0.5f))), _mm_set1_ps(1.0f));
+
+    __m128 polySin = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(SINCOS_SIN0), z), _mm_set1_ps(SINCOS_SIN1));
+    polySin = _mm_add_ps(_mm_mul_ps(polySin, z), _mm_set1_ps(SINCOS_SIN2));
+    polySin = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(polySin, z), x), x);
+
+    __m128 sinValue = _mm_or_ps(_mm_and_ps(polyMask, polySin), _mm_andnot_ps(polyMask, polyCos));
+    __m128 cosValue = _mm_or_ps(_mm_and_ps(polyMask, polyCos), _mm_andnot_ps(polyMask, polySin));
+    s = _mm_xor_ps(sinValue, signSin);
+    c = _mm_xor_ps(cosValue, signCos);
+}
+
+static void SolveSSE(const float* meanAnomaly, const float* eccentricity, float* eccentricAnomaly, float* cosE, float* sinE,
+    unsigned count)
+{
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32((int)0x80000000));
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 tolerance = _mm_set1_ps(KEPLER_TOLERANCE);
+
+    unsigned vectorCount = count & ~3u;
+    for (unsigned i = 0; i < vectorCount; i += 4)
+    {
+        __m128 m = _mm_loadu_ps(meanAnomaly + i);
+        __m128 e = _mm_loadu_ps(eccentricity + i);
+        __m128 start = _mm_or_ps(_mm_set1_ps(0.85f), _mm_and_ps(m, signMask));
+        __m128 ea = _mm_add_ps(m, _mm_mul_ps(start, e));
+        __m128 active = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        __m128 s, c;
+
+        for (unsigned j = 0; j < KEPLER_MAX_ITERATIONS; ++j)
+        {
+            SinCosSSE(ea, s, c);
+            __m128 f = _mm_sub_ps(_mm_sub_ps(ea, _mm_mul_ps(e, s)), m);
+            __m128 delta = _mm_div_ps(f, _mm_sub_ps(one, _mm_mul_ps(e, c)));
+            ea = _mm_or_ps(_mm_and_ps(active, _mm_sub_ps(ea, delta)), _mm_andnot_ps(active, ea));
+            active = _mm_and_ps(active, _mm_cmpge_ps(_mm_and_ps(delta, absMask), tolerance));
+            if (!_mm_movemask_ps(active))
+                break;
+        }
+
+        _mm_storeu_ps(eccentricAnomaly + i, ea);
+        if (cosE || sinE)
+        {
+            SinCosSSE(ea, s, c);
+            if (cosE)
+                _mm_storeu_ps(cosE + i, c);
+            if (sinE)
+                _mm_storeu_ps(sinE + i, s);
+        }
+    }
+
+    SolveScalar(meanAnomaly + vectorCount, eccentricity + vectorCount, eccentricAnomaly + vectorCount,
+        cosE ? cosE + vectorCount : 0, sinE ? sinE + vectorCount : 0, count - vectorCount);
+}
+
+KEPLER_TARGET_AVX2 static inline void SinCosAVX2(__m256 x, __m256& s, __m256& c)
+{
+    const __m256 signMask = _mm256_castsi256_ps(_mm256_set1_epi32((int)0x80000000));
+
+    __m256 signSin = _mm256_and_ps(x, signMask);
+    x = _mm256_andnot_ps(signMask, x);
+
+    __m256i octant = _mm256_cvttps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(SINCOS_FOPI)));
+    octant = _mm256_and_si256(_mm256_add_epi32(octant, _mm256_set1_epi32(1)), _mm256_set1_epi32(~1));
+    __m256 y = _mm256_cvtepi32_ps(octant);
+
+    __m256 swapSignSin = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(octant, _mm256_set1_epi32(4)), 29));
+    __m256 polyMask = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(octant, _mm256_set1_epi32(2)),
+        _mm256_setzero_si256()));
+    __m256 signCos = _mm256_castsi256_ps(_mm256_slli_epi32(
+        _mm256_andnot_si256(_mm256_sub_epi32(octant, _mm256_set1_epi32(2)), _mm256_set1_epi32(4)), 29));
+    signSin = _mm256_xor_ps(signSin, swapSignSin);
+
+    x = _mm256_sub_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(SINCOS_DP1)));
+    x = _mm256_sub_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(SINCOS_DP2)));
+    x = _mm256_sub_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(SINCOS_DP3)));
+    __m256 z = _mm256_mul_ps(x, x);
+
+    __m256 polyCos = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(SINCOS_COS0), z), _mm256_set1_ps(SINCOS_COS1));
+    polyCos = _mm256_add_ps(_mm256_mul_ps(polyCos, z), _mm256_set1_ps(SINCOS_COS2));
+    polyCos = _mm256_mul_ps(_mm256_mul_ps(polyCos, z), z);
+    polyCos = _mm256_add_ps(_mm256_sub_ps(polyCos, _mm256_mul_ps(z, _mm256_set1_ps(0.5f))), _mm256_set1_ps(1.0f));
+
+    __m256 polySin = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(SINCOS_SIN0), z), _mm256_set1_ps(SINCOS_SIN1));
+    polySin = _mm256_add_ps(_mm256_mul_ps(polySin, z), _mm256_set1_ps(SINCOS_SIN2));
+    polySin = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(polySin, z), x), x);
+
+    __m256 sinValue = _mm256_blendv_ps(polyCos, polySin, polyMask);
+    __m256 cosValue = _mm256_blendv_ps(polySin, polyCos, polyMask);
+    s = _mm256_xor_ps(sinValue, signSin);
+    c = _mm256_xor_ps(cosValue, signCos);
+}
+
+KEPLER_TARGET_AVX2 static void SolveAVX2(const float* meanAnomaly, const float* eccentricity, float* eccentricAnomaly,
+    float* cosE, float* sinE, unsigned count)
+{
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    const __m256 signMask = _mm256_castsi256_ps(_mm256_set1_epi32((int)0x80000000));
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 tolerance = _mm256_set1_ps(KEPLER_TOLERANCE);
+
+    unsigned vectorCount = count & ~7u;
+    for (unsigned i = 0; i < vectorCount; i += 8)
+    {
+        __m256 m = _mm256_loadu_ps(meanAnomaly + i);
+        __m256 e = _mm256_loadu_ps(eccentricity + i);
+        __m256 start = _mm256_or_ps(_mm256_set1_ps(0.85f), _mm256_and_ps(m, signMask));
+        __m256 ea = _mm256_add_ps(m, _mm256_mul_ps(start, e));
+        __m256 active = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        __m256 s, c;
+
+        for (unsigned j = 0; j < KEPLER_MAX_ITERATIONS; ++j)
+        {
+            SinCosAVX2(ea, s, c);
+            __m256 f = _mm256_sub_ps(_mm256_sub_ps(ea, _mm256_mul_ps(e, s)), m);
+            __m256 delta = _mm256_div_ps(f, _mm256_sub_ps(one, _mm256_mul_ps(e, c)));
+            ea = _mm256_blendv_ps(ea, _mm256_sub_ps(ea, delta), active);
+            active = _mm256_and_ps(active, _mm256_cmp_ps(_mm256_and_ps(delta, absMask), tolerance, _CMP_GE_OQ));
+            if (!_mm256_movemask_ps(active))
+                break;
+        }
+
+        _mm256_storeu_ps(eccentricAnomaly + i, ea);
+        if (cosE || sinE)
+        {
+            SinCosAVX2(ea, s, c);
+            if (cosE)
+                _mm256_storeu_ps(cosE + i, c);
+            if (sinE)
+                _mm256_storeu_ps(sinE + i, s);
+        }
+    }
+
+    // Finish the tail with the 4-wide path, which itself falls back to scalar for the last elements
+    SolveSSE(meanAnomaly + vectorCount, eccentricity + vectorCount, eccentricAnomaly + vectorCount,
+        cosE ? cosE + vectorCount : 0, sinE ? sinE + vectorCount : 0, count - vectorCount);
+}
+
+static bool CPUHasAVX2()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    if (!osxsave || (_xgetbv(0) & 6) != 6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+static bool CPUHasSSE()
+{
+#if defined(__x86_64__) || defined(_M_X64)
+    return true;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[3] & (1 << 26)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+#endif
+}
+
+#endif
+
+KeplerSolverPath GetBestKeplerSolverPath()
+{
+    static int bestPath = -1;
+    if (bestPath < 0)
+    {
+        if (IsKeplerSolverPathSupported(KSP_AVX2))
+            bestPath = KSP_AVX2;
+        else if (IsKeplerSolverPathSupported(KSP_SSE))
+            bestPath = KSP_SSE;
+        else
+            bestPath = KSP_SCALAR;
+    }
+
+    return (KeplerSolverPath)bestPath;
+}
+
+bool IsKeplerSolverPathSupported(KeplerSolverPath path)
+{
+    switch (path)
+    {
+    case KSP_SCALAR:
+        return true;
+#ifdef KEPLER_X86
+    case KSP_SSE:
+        return CPUHasSSE();
+    case KSP_AVX2:
+        return CPUHasSSE() && CPUHasAVX2();
+#endif
+    default:
+        return false;
+    }
+}
+
+const char* GetKeplerSolverPathName(KeplerSolverPath path)
+{
+    static const char* names[] = { "scalar", "SSE", "AVX2" };
+    return path < MAX_KEPLERSOLVER_PATHS ? names[path] : "unknown";
+}
+
+void SolveKeplerBatch(const float* meanAnomaly, const float* eccentricity, float* eccentricAnomaly, float* cosEccentricAnomaly,
+    float* sinEccentricAnomaly, unsigned count)
+{
+    SolveKeplerBatch(meanAnomaly, eccentricity, eccentricAnomaly, cosEccentricAnomaly, sinEccentricAnomaly, count,
+        GetBestKeplerSolverPath());
+}
+
+void SolveKeplerBatch(const float* meanAnomaly, const float* eccentricity, float* eccentricAnomaly, float* cosEccentricAnomaly,
+    float* sinEccentricAnomaly, unsigned count, KeplerSolverPath path)
+{
+    if (!IsKeplerSolverPathSupported(path))
+        path = KSP_SCALAR;
+
+    switch (path)
+    {
+#ifdef KEPLER_X86
+    case KSP_AVX2:
+        SolveAVX2(meanAnomaly, eccentricity, eccentricAnomaly, cosEccentricAnomaly, sinEccentricAnomaly, count);
+        break;
+    case KSP_SSE:
+        SolveSSE(meanAnomaly, eccentricity, eccentricAnomaly, cosEccentricAnomaly, sinEccentricAnomaly, count);
+        break;
+#endif
+    default:
+        SolveScalar(meanAnomaly, eccentricity, eccentricAnomaly, cosEccentricAnomaly, sinEccentricAnomaly, count);
+        break;
+    }
+}
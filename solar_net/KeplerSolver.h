@@ -0,0 +1,49 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+/// Instruction set used to solve Kepler's equation in batches.
+enum KeplerSolverPath
+{
+    KSP_SCALAR = 0,
+    KSP_SSE,
+    KSP_AVX2,
+    MAX_KEPLERSOLVER_PATHS
+};
+
+/// Return the fastest solver path supported by the running CPU.
+KeplerSolverPath GetBestKeplerSolverPath();
+/// Return whether the running CPU supports a solver path.
+bool IsKeplerSolverPathSupported(KeplerSolverPath path);
+/// Return display name of a solver path.
+const char* GetKeplerSolverPathName(KeplerSolverPath path);
+
+/// Solve Kepler's equation M = E - e sin E for a batch of bodies using the fastest supported path. Mean anomalies are in
+/// radians and must be wrapped to [-pi, pi]; eccentricities must be in [0, 1). The cosine and sine outputs of the
+/// eccentric anomaly are optional (may be null) and save the caller two transcendentals per body.
+void SolveKeplerBatch(const float* meanAnomaly, const float* eccentricity, float* eccentricAnomaly, float* cosEccentricAnomaly,
+    float* sinEccentricAnomaly, unsigned count);
+/// Solve Kepler's equation for a batch of bodies using a specific path. Falls back to scalar if it is not supported.
+void SolveKeplerBatch(const float* meanAnomaly, const float* eccentricity, float* eccentricAnomaly, float* cosEccentricAnomaly,
+    float* sinEccentricAnomaly, unsigned count, KeplerSolverPath path);
@@ -0,0 +1,139 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/Log.h>
+
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <Urho3D/DebugNew.h>
+
+MappedFile::MappedFile() :
+    data_(0),
+    size_(0)
+#ifdef _WIN32
+    , fileHandle_(0),
+    mappingHandle_(0)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+bool MappedFile::Open(const String& fileName)
+{
+    Close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileW(WString(GetNativePath(fileName)).CString(), GENERIC_READ, FILE_SHARE_READ, 0,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        URHO3D_LOGERROR("Could not open file " + fileName);
+        return false;
+    }
+    fileHandle_ = file;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.HighPart || !fileSize.LowPart)
+    {
+        URHO3D_LOGERROR("Could not map empty or oversized file " + fileName);
+        Close();
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingW(file, 0, PAGE_READONLY, 0, 0, 0);
+    void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : 0;
+    mappingHandle_ = mapping;
+    if (!data)
+    {
+        URHO3D_LOGERROR("Could not map file " + fileName);
+        Close();
+        return false;
+    }
+
+    data_ = (const unsigned char*)data;
+    size_ = fileSize.LowPart;
+#else
+    int file = open(GetNativePath(fileName).CString(), O_RDONLY);
+    if (file < 0)
+    {
+        URHO3D_LOGERROR("Could not open file " + fileName);
+        return false;
+    }
+
+    struct stat fileStat;
+    if (fstat(file, &fileStat) || fileStat.st_size <= 0 || (unsigned long long)fileStat.st_size > M_MAX_UNSIGNED)
+    {
+        URHO3D_LOGERROR("Could not map empty or oversized file " + fileName);
+        close(file);
+        return false;
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    void* data = mmap(0, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (data == MAP_FAILED)
+    {
+        URHO3D_LOGERROR("Could not map file " + fileName);
+        return false;
+    }
+
+    data_ = (const unsigned char*)data;
+    size_ = (unsigned)fileStat.st_size;
+#endif
+
+    return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+    if (data_)
+        UnmapViewOfFile(data_);
+    if (mappingHandle_)
+        CloseHandle((HANDLE)mappingHandle_);
+    if (fileHandle_)
+        CloseHandle((HANDLE)fileHandle_);
+    mappingHandle_ = 0;
+    fileHandle_ = 0;
+#else
+    if (data_)
+        munmap((void*)data_, size_);
+#endif
+
+    data_ = 0;
+    size_ = 0;
+}
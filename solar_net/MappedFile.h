@@ -0,0 +1,65 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <Urho3D/Container/RefCounted.h>
+#include <Urho3D/Container/Str.h>
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+/// Read-only view of a whole file mapped into memory. Pages are brought in by the operating system on first access and
+/// shared with its file cache, so opening even a large file costs no read or copy.
+class MappedFile : public RefCounted
+{
+public:
+    /// Construct.
+    MappedFile();
+    /// Destruct. Unmap the file.
+    virtual ~MappedFile();
+
+    /// Map a file. Return true if successful.
+    bool Open(const String& fileName);
+    /// Unmap the file.
+    void Close();
+
+    /// Return mapped data, or null if not open.
+    const unsigned char* GetData() const { return data_; }
+    /// Return size of the mapped data in bytes.
+    unsigned GetSize() const { return size_; }
+    /// Return whether a file is mapped.
+    bool IsOpen() const { return data_ != 0; }
+
+private:
+    /// Mapped data.
+    const unsigned char* data_;
+    /// Mapped size.
+    unsigned size_;
+#ifdef _WIN32
+    /// File handle.
+    void* fileHandle_;
+    /// File mapping handle.
+    void* mappingHandle_;
+#endif
+};
@@ -0,0 +1,745 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/Graphics/BillboardSet.h>
+#include <Urho3D/IO/Deserializer.h>
+#include <Urho3D/IO/Serializer.h>
+#include <Urho3D/Scene/Scene.h>
+#include <Urho3D/Scene/SceneEvents.h>
+
+#include "Ephemeris.h"
+#include "FloatingOrigin.h"
+#include "NBodySystem.h"
+#include "OrbitSystem.h"
+#include "SimulationClock.h"
+#include "WorkRange.h"
+
+#include <Urho3D/DebugNew.h>
+
+/// Default maximum integration step: one hour.
+static const double DEFAULT_MAX_STEP = 3600.0;
+/// Default maximum number of steps per frame.
+static const unsigned DEFAULT_MAX_STEPS_PER_FRAME = 16;
+/// Default Barnes-Hut opening angle.
+static const float DEFAULT_OPENING_ANGLE = 0.5f;
+/// Default softening length, a thousand kilometres.
+static const double DEFAULT_SOFTENING = 1.0;
+/// Default minimum number of particles per work item.
+static const unsigned DEFAULT_MIN_PARTICLES_PER_WORKITEM = 1024;
+/// Maximum octree depth. Particles closer than the root size / 2^depth share a leaf.
+static const unsigned MAX_TREE_DEPTH = 32;
+/// Stack size of the force pass tree walk: eight children pushed per level.
+static const unsigned MAX_TREE_STACK = (MAX_TREE_DEPTH + 1) * 8;
+/// Bits per quantized coordinate of replicated positions, three of them packed in two 32-bit words.
+static const unsigned POSITION_BITS = 21;
+/// Largest quantized coordinate.
+static const unsigned MAX_QUANTIZED_POSITION = (1U << POSITION_BITS) - 1;
+/// Most ticks a replicated chunk interpolates over, so that lost states do not slow it down for long.
+static const unsigned MAX_CHUNK_INTERPOLATION_TICKS = 64;
+
+static void KickDriftWork(const WorkItem* item, unsigned threadIndex)
+{
+    NBodySystem* system = reinterpret_cast<NBodySystem*>(item->aux_);
+    system->KickDrift((unsigned)(size_t)item->start_, (unsigned)(size_t)item->end_);
+}
+
+static void ComputeForcesWork(const WorkItem* item, unsigned threadIndex)
+{
+    NBodySystem* system = reinterpret_cast<NBodySystem*>(item->aux_);
+    system->ComputeForces((unsigned)(size_t)item->start_, (unsigned)(size_t)item->end_);
+}
+
+/// Add the softened attraction of a point mass to an acceleration.
+static inline void Attract(DoubleVector3& acceleration, const DoubleVector3& position, const DoubleVector3& source,
+    double mass, double softening2)
+{
+    DoubleVector3 delta = source - position;
+    double distance2 = delta.LengthSquared() + softening2;
+    acceleration += delta * (mass / (distance2 * sqrt(distance2)));
+}
+
+NBodySystem::NBodySystem(Context* context) :
+    Component(context),
+    billboardSize_(Vector2::ONE),
+    time_(0.0),
+    step_(0.0),
+    maxStep_(DEFAULT_MAX_STEP),
+    softening_(DEFAULT_SOFTENING),
+    openingAngle_(DEFAULT_OPENING_ANGLE),
+    maxStepsPerFrame_(DEFAULT_MAX_STEPS_PER_FRAME),
+    minParticlesPerWorkItem_(DEFAULT_MIN_PARTICLES_PER_WORKITEM),
+    numMassive_(0),
+    accelerationsDirty_(true),
+    billboardsDirty_(false),
+    lastInterpolation_(0.0f),
+    replicated_(false)
+{
+}
+
+NBodySystem::~NBodySystem()
+{
+}
+
+void NBodySystem::RegisterObject(Context* context)
+{
+    context->RegisterFactory<NBodySystem>();
+}
+
+unsigned NBodySystem::AddParticle(const DoubleVector3& position, const DoubleVector3& velocity,
+    double gravitationalParameter)
+{
+    positions_.Push(position);
+    previousPositions_.Push(position);
+    velocities_.Push(velocity);
+    accelerations_.Push(DoubleVector3::ZERO);
+    masses_.Push(gravitationalParameter);
+    if (gravitationalParameter > 0.0)
+        ++numMassive_;
+
+    accelerationsDirty_ = true;
+    billboardsDirty_ = true;
+    return positions_.Size() - 1;
+}
+
+void NBodySystem::AddAttractor(double gravitationalParameter, unsigned orbit)
+{
+    NBodyAttractor attractor;
+    attractor.gravitationalParameter_ = gravitationalParameter;
+    attractor.orbit_ = orbit;
+    attractors_.Push(attractor);
+    accelerationsDirty_ = true;
+}
+
+void NBodySystem::RemoveAllParticles()
+{
+    positions_.Clear();
+    previousPositions_.Clear();
+    velocities_.Clear();
+    accelerations_.Clear();
+    masses_.Clear();
+    cells_.Clear();
+    numMassive_ = 0;
+    billboardsDirty_ = true;
+}
+
+void NBodySystem::RemoveAllAttractors()
+{
+    attractors_.Clear();
+    attractorPositions_.Clear();
+    accelerationsDirty_ = true;
+}
+
+void NBodySystem::SetBillboardSet(BillboardSet* billboardSet, const Vector2& size)
+{
+    billboardSet_ = billboardSet;
+    billboardSize_ = size;
+    if (billboardSet_)
+        billboardSet_->SetNumBillboards(0);
+    billboardsDirty_ = true;
+}
+
+void NBodySystem::SetMaxStep(double step)
+{
+    maxStep_ = Max(step, 1.0);
+}
+
+void NBodySystem::SetMaxStepsPerFrame(unsigned count)
+{
+    maxStepsPerFrame_ = Max(count, 1U);
+}
+
+void NBodySystem::SetOpeningAngle(float angle)
+{
+    openingAngle_ = Max(angle, 0.0f);
+}
+
+void NBodySystem::SetSoftening(double softening)
+{
+    softening_ = Max(softening, 0.0);
+    accelerationsDirty_ = true;
+}
+
+void NBodySystem::SetMinParticlesPerWorkItem(unsigned count)
+{
+    minParticlesPerWorkItem_ = Max(count, 1U);
+}
+
+void NBodySystem::Step(double step)
+{
+    if (positions_.Empty())
+    {
+        time_ += step;
+        return;
+    }
+
+    // The first kick needs the accelerations at the starting positions
+    if (accelerationsDirty_)
+    {
+        step_ = 0.0;
+        UpdateAttractors();
+        BuildTree();
+        RunPass(ComputeForcesWork);
+        accelerationsDirty_ = false;
+    }
+
+    step_ = step;
+    RunPass(KickDriftWork);
+
+    time_ += step;
+    UpdateAttractors();
+    BuildTree();
+    RunPass(ComputeForcesWork);
+
+    billboardsDirty_ = true;
+}
+
+void NBodySystem::Advance(double time)
+{
+    double delta = time - time_;
+    if (delta == 0.0)
+        return;
+
+    // Equal sub-steps keep the leapfrog symmetric within the frame
+    unsigned numSteps = Clamp((unsigned)ceil(Abs(delta) / maxStep_), 1U, maxStepsPerFrame_);
+    double step = delta / numSteps;
+    for (unsigned i = 0; i < numSteps - 1; ++i)
+        Step(step);
+    // Land exactly on the target time
+    Step(time - time_);
+}
+
+void NBodySystem::SetReplicated(bool enable)
+{
+    if (enable == replicated_)
+        return;
+
+    replicated_ = enable;
+    ResetStateChunks();
+    if (!enable)
+    {
+        // The chunks were read at different ticks of the source; all carry on from the time the clock resumes from
+        SimulationClock* clock = GetSubsystem<SimulationClock>();
+        if (clock)
+            time_ = clock->GetTime();
+        previousPositions_ = positions_;
+        accelerationsDirty_ = true;
+        billboardsDirty_ = true;
+    }
+}
+
+void NBodySystem::WriteState(Serializer& dest) const
+{
+    // A single precision step is about 15 km at 1 AU and 500 km at 40 AU (0.015 and 0.5 units), still hundreds of
+    // times below the size of a debris billboard
+    unsigned numParticles = positions_.Size();
+    dest.WriteVLE(numParticles);
+    for (unsigned i = 0; i < numParticles; ++i)
+    {
+        dest.WriteVector3(positions_[i].ToVector3());
+        dest.WriteVector3(velocities_[i].ToVector3());
+    }
+}
+
+void NBodySystem::ReadState(Deserializer& source)
+{
+    unsigned numParticles = source.ReadVLE();
+    if (numParticles != positions_.Size())
+    {
+        RemoveAllParticles();
+        for (unsigned i = 0; i < numParticles; ++i)
+        {
+            DoubleVector3 position(source.ReadVector3());
+            AddParticle(position, DoubleVector3(source.ReadVector3()));
+        }
+    }
+    else
+    {
+        for (unsigned i = 0; i < numParticles; ++i)
+        {
+            positions_[i] = DoubleVector3(source.ReadVector3());
+            previousPositions_[i] = positions_[i];
+            velocities_[i] = DoubleVector3(source.ReadVector3());
+        }
+    }
+
+    // Integration resumes from this state and time if the clock starts ticking again
+    SimulationClock* clock = GetSubsystem<SimulationClock>();
+    if (clock)
+        time_ = clock->GetTime();
+    ResetStateChunks();
+    accelerationsDirty_ = true;
+    billboardsDirty_ = true;
+}
+
+void NBodySystem::WriteChunk(Serializer& dest, unsigned chunk) const
+{
+    unsigned numParticles = positions_.Size();
+    unsigned start = chunk * PARTICLES_PER_STATE_CHUNK;
+    unsigned end = Min(start + PARTICLES_PER_STATE_CHUNK, numParticles);
+
+    // The particles of a chunk were created together, so they share a region: a debris field at 50 AU quantizes to
+    // about 7 units, a field at 1 AU to a small fraction of a unit
+    DoubleVector3 min = positions_[start];
+    DoubleVector3 max = min;
+    for (unsigned i = start + 1; i < end; ++i)
+    {
+        const DoubleVector3& position = positions_[i];
+        min = DoubleVector3(Min(min.x_, position.x_), Min(min.y_, position.y_), Min(min.z_, position.z_));
+        max = DoubleVector3(Max(max.x_, position.x_), Max(max.y_, position.y_), Max(max.z_, position.z_));
+    }
+    Vector3 extent = (max - min).ToVector3();
+    DoubleVector3 scale(extent.x_ > 0.0f ? MAX_QUANTIZED_POSITION / (double)extent.x_ : 0.0,
+        extent.y_ > 0.0f ? MAX_QUANTIZED_POSITION / (double)extent.y_ : 0.0,
+        extent.z_ > 0.0f ? MAX_QUANTIZED_POSITION / (double)extent.z_ : 0.0);
+
+    dest.WriteVLE(numParticles);
+    dest.WriteVLE(chunk);
+    dest.WriteDouble(min.x_);
+    dest.WriteDouble(min.y_);
+    dest.WriteDouble(min.z_);
+    dest.WriteVector3(extent);
+    for (unsigned i = start; i < end; ++i)
+    {
+        DoubleVector3 offset = positions_[i] - min;
+        unsigned x = Min((unsigned)(offset.x_ * scale.x_ + 0.5), MAX_QUANTIZED_POSITION);
+        unsigned y = Min((unsigned)(offset.y_ * scale.y_ + 0.5), MAX_QUANTIZED_POSITION);
+        unsigned z = Min((unsigned)(offset.z_ * scale.z_ + 0.5), MAX_QUANTIZED_POSITION);
+        dest.WriteUInt(x | y << POSITION_BITS);
+        dest.WriteUInt(y >> (32 - POSITION_BITS) | z << (2 * POSITION_BITS - 32));
+    }
+}
+
+bool NBodySystem::ReadChunk(Deserializer& source, unsigned tick, float tickLength)
+{
+    unsigned numParticles = source.ReadVLE();
+    unsigned chunk = source.ReadVLE();
+    if (numParticles != positions_.Size() || chunk >= stateChunks_.Size())
+        return false;
+
+    // States may arrive out of order; a chunk only moves forward
+    NBodyStateChunk& state = stateChunks_[chunk];
+    if (state.valid_ && (int)(tick - state.tick_) <= 0)
+        return true;
+
+    DoubleVector3 min;
+    min.x_ = source.ReadDouble();
+    min.y_ = source.ReadDouble();
+    min.z_ = source.ReadDouble();
+    Vector3 extent = source.ReadVector3();
+    DoubleVector3 step(extent.x_ / (double)MAX_QUANTIZED_POSITION, extent.y_ / (double)MAX_QUANTIZED_POSITION,
+        extent.z_ / (double)MAX_QUANTIZED_POSITION);
+
+    // Each particle moves on from where it is shown now
+    float interpolation = GetChunkInterpolation(chunk);
+    unsigned start = chunk * PARTICLES_PER_STATE_CHUNK;
+    unsigned end = Min(start + PARTICLES_PER_STATE_CHUNK, numParticles);
+    for (unsigned i = start; i < end; ++i)
+    {
+        unsigned low = source.ReadUInt();
+        unsigned high = source.ReadUInt();
+        unsigned x = low & MAX_QUANTIZED_POSITION;
+        unsigned y = (low >> POSITION_BITS | high << (32 - POSITION_BITS)) & MAX_QUANTIZED_POSITION;
+        unsigned z = high >> (2 * POSITION_BITS - 32);
+        previousPositions_[i] += (positions_[i] - previousPositions_[i]) * interpolation;
+        positions_[i] = min + DoubleVector3(x * step.x_, y * step.y_, z * step.z_);
+    }
+
+    unsigned numTicks = state.valid_ ? Clamp(tick - state.tick_, 1U, MAX_CHUNK_INTERPOLATION_TICKS) : 1;
+    state.tick_ = tick;
+    state.elapsed_ = 0.0f;
+    state.duration_ = numTicks * tickLength;
+    state.valid_ = true;
+    billboardsDirty_ = true;
+    return true;
+}
+
+unsigned NBodySystem::GetNumChunks() const
+{
+    return (positions_.Size() + PARTICLES_PER_STATE_CHUNK - 1) / PARTICLES_PER_STATE_CHUNK;
+}
+
+void NBodySystem::RunPass(void (*workFunction)(const WorkItem*, unsigned))
+{
+    unsigned count = positions_.Size();
+    if (!count)
+        return;
+
+    WorkQueue* queue = GetSubsystem<WorkQueue>();
+    if (QueueRangeWork(queue, workFunction, this, count, minParticlesPerWorkItem_))
+        queue->Complete(M_MAX_UNSIGNED);
+    else if (workFunction == KickDriftWork)
+        KickDrift(0, count);
+    else
+        ComputeForces(0, count);
+}
+
+void NBodySystem::KickDrift(unsigned start, unsigned end)
+{
+    double halfStep = step_ * 0.5;
+    double step = step_;
+    DoubleVector3* positions = positions_.Buffer();
+    DoubleVector3* velocities = velocities_.Buffer();
+    const DoubleVector3* accelerations = accelerations_.Buffer();
+
+    for (unsigned i = start; i < end; ++i)
+    {
+        velocities[i] += accelerations[i] * halfStep;
+        positions[i] += velocities[i] * step;
+    }
+}
+
+void NBodySystem::ComputeForces(unsigned start, unsigned end)
+{
+    double halfStep = step_ * 0.5;
+    double softening2 = softening_ * softening_;
+    double openingAngle2 = (double)openingAngle_ * openingAngle_;
+    const DoubleVector3* positions = positions_.Buffer();
+    DoubleVector3* velocities = velocities_.Buffer();
+    DoubleVector3* accelerations = accelerations_.Buffer();
+    const NBodyAttractor* attractors = attractors_.Buffer();
+    const DoubleVector3* attractorPositions = attractorPositions_.Buffer();
+    unsigned numAttractors = attractors_.Size();
+    const BarnesHutCell* cells = cells_.Buffer();
+    bool useTree = numMassive_ && !cells_.Empty();
+
+    unsigned stack[MAX_TREE_STACK];
+
+    for (unsigned i = start; i < end; ++i)
+    {
+        const DoubleVector3& position = positions[i];
+        DoubleVector3 acceleration;
+
+        for (unsigned j = 0; j < numAttractors; ++j)
+            Attract(acceleration, position, attractorPositions[j], attractors[j].gravitationalParameter_, softening2);
+
+        if (useTree)
+        {
+            unsigned stackSize = 0;
+            stack[stackSize++] = 0;
+
+            while (stackSize)
+            {
+                const BarnesHutCell& cell = cells[stack[--stackSize]];
+                if (cell.mass_ <= 0.0)
+                    continue;
+
+                if (cell.firstChild_ < 0)
+                {
+                    // A particle does not attract itself
+                    if (cell.particle_ != (int)i)
+                        Attract(acceleration, position, cell.massCenter_, cell.mass_, softening2);
+                    continue;
+                }
+
+                // Far enough cells act as a single mass at their center of mass
+                double size = cell.halfSize_ * 2.0;
+                if (size * size < openingAngle2 * (cell.massCenter_ - position).LengthSquared())
+                    Attract(acceleration, position, cell.massCenter_, cell.mass_, softening2);
+                else
+                {
+                    for (int k = 0; k < 8; ++k)
+                        stack[stackSize++] = (unsigned)(cell.firstChild_ + k);
+                }
+            }
+        }
+
+        accelerations[i] = acceleration;
+        velocities[i] += acceleration * halfStep;
+    }
+}
+
+void NBodySystem::UpdateAttractors()
+{
+    Scene* scene = GetScene();
+    OrbitSystem* orbitSystem = scene ? scene->GetComponent<OrbitSystem>() : 0;
+    unsigned numAttractors = attractors_.Size();
+    attractorPositions_.Resize(numAttractors);
+
+    for (unsigned i = 0; i < numAttractors; ++i)
+    {
+        // Walk up the parent orbits of satellites to the world origin
+        DoubleVector3 position;
+        unsigned orbit = attractors_[i].orbit_;
+        while (orbitSystem && orbit < orbitSystem->GetNumOrbits())
+        {
+            position += GetOrbitPosition(orbitSystem->GetOrbit(orbit), time_);
+            orbit = orbitSystem->GetParentOrbit(orbit);
+        }
+        attractorPositions_[i] = position;
+    }
+}
+
+void NBodySystem::BuildTree()
+{
+    cells_.Clear();
+    if (!numMassive_)
+        return;
+
+    // Root cube enclosing all massive particles
+    DoubleVector3 min(M_INFINITY, M_INFINITY, M_INFINITY);
+    DoubleVector3 max(-M_INFINITY, -M_INFINITY, -M_INFINITY);
+    unsigned numParticles = positions_.Size();
+    for (unsigned i = 0; i < numParticles; ++i)
+    {
+        if (masses_[i] <= 0.0)
+            continue;
+        const DoubleVector3& position = positions_[i];
+        min = DoubleVector3(Min(min.x_, position.x_), Min(min.y_, position.y_), Min(min.z_, position.z_));
+        max = DoubleVector3(Max(max.x_, position.x_), Max(max.y_, position.y_), Max(max.z_, position.z_));
+    }
+
+    DoubleVector3 extent = max - min;
+    BarnesHutCell root;
+    root.center_ = (min + max) * 0.5;
+    root.halfSize_ = Max(Max(extent.x_, extent.y_), Max(extent.z_, 1.0)) * 0.5;
+    root.mass_ = 0.0;
+    root.firstChild_ = -1;
+    root.particle_ = -1;
+    cells_.Reserve(numMassive_ * 2);
+    cells_.Push(root);
+
+    for (unsigned i = 0; i < numParticles; ++i)
+    {
+        if (masses_[i] > 0.0)
+            InsertParticle(i);
+    }
+
+    // Turn the mass-weighted position sums into centers of mass
+    for (unsigned i = 0; i < cells_.Size(); ++i)
+    {
+        BarnesHutCell& cell = cells_[i];
+        if (cell.mass_ > 0.0)
+            cell.massCenter_ = cell.massCenter_ * (1.0 / cell.mass_);
+    }
+}
+
+void NBodySystem::InsertParticle(unsigned index)
+{
+    const DoubleVector3& position = positions_[index];
+    double mass = masses_[index];
+    unsigned cellIndex = 0;
+
+    for (unsigned depth = 0;; ++depth)
+    {
+        // Cells may move as the vector grows, so they are only referred to by index across subdivisions
+        BarnesHutCell& cell = cells_[cellIndex];
+        cell.mass_ += mass;
+        cell.massCenter_ += position * mass;
+
+        if (cell.firstChild_ < 0)
+        {
+            if (cell.particle_ < 0)
+            {
+                cell.particle_ = (int)index;
+                return;
+            }
+            // Coincident particles end up sharing the deepest leaf
+            if (depth >= MAX_TREE_DEPTH)
+                return;
+
+            // Push the resident particle one level down, then carry on with the new one
+            unsigned resident = (unsigned)cell.particle_;
+            const DoubleVector3& residentPosition = positions_[resident];
+            DoubleVector3 center = cell.center_;
+            int firstChild = Subdivide(cellIndex);
+            BarnesHutCell& child = cells_[firstChild + (residentPosition.x_ >= center.x_ ? 1 : 0) +
+                (residentPosition.y_ >= center.y_ ? 2 : 0) + (residentPosition.z_ >= center.z_ ? 4 : 0)];
+            child.mass_ = masses_[resident];
+            child.massCenter_ = residentPosition * masses_[resident];
+            child.particle_ = (int)resident;
+        }
+
+        const BarnesHutCell& parent = cells_[cellIndex];
+        cellIndex = (unsigned)(parent.firstChild_ + (position.x_ >= parent.center_.x_ ? 1 : 0) +
+            (position.y_ >= parent.center_.y_ ? 2 : 0) + (position.z_ >= parent.center_.z_ ? 4 : 0));
+    }
+}
+
+int NBodySystem::Subdivide(unsigned cellIndex)
+{
+    int firstChild = (int)cells_.Size();
+    DoubleVector3 center = cells_[cellIndex].center_;
+    double quarterSize = cells_[cellIndex].halfSize_ * 0.5;
+
+    for (unsigned i = 0; i < 8; ++i)
+    {
+        BarnesHutCell child;
+        child.center_ = center + DoubleVector3(i & 1 ? quarterSize : -quarterSize, i & 2 ? quarterSize : -quarterSize,
+            i & 4 ? quarterSize : -quarterSize);
+        child.halfSize_ = quarterSize;
+        child.mass_ = 0.0;
+        child.firstChild_ = -1;
+        child.particle_ = -1;
+        cells_.Push(child);
+    }
+
+    BarnesHutCell& cell = cells_[cellIndex];
+    cell.firstChild_ = firstChild;
+    cell.particle_ = -1;
+    return firstChild;
+}
+
+void NBodySystem::ApplyResults(float interpolation)
+{
+    if (!billboardSet_)
+        return;
+
+    unsigned numParticles = positions_.Size();
+    unsigned numBillboards = billboardSet_->GetNumBillboards();
+    if (numBillboards != numParticles)
+    {
+        billboardSet_->SetNumBillboards(numParticles);
+        for (unsigned i = numBillboards; i < numParticles; ++i)
+        {
+            Billboard* billboard = billboardSet_->GetBillboard(i);
+            billboard->size_ = billboardSize_;
+            billboard->enabled_ = true;
+        }
+    }
+
+    // Subtract the origin in double precision, before the position is narrowed to single precision
+    Scene* scene = GetScene();
+    FloatingOrigin* floatingOrigin = scene ? scene->GetComponent<FloatingOrigin>() : 0;
+    DoubleVector3 origin = floatingOrigin ? floatingOrigin->GetOrigin() : DoubleVector3::ZERO;
+    const DoubleVector3* positions = positions_.Buffer();
+    const DoubleVector3* previousPositions = previousPositions_.Buffer();
+
+    // Replicated chunks each interpolate over the interval between their own states
+    for (unsigned start = 0; start < numParticles; start += PARTICLES_PER_STATE_CHUNK)
+    {
+        float factor = replicated_ ? GetChunkInterpolation(start / PARTICLES_PER_STATE_CHUNK) : interpolation;
+        unsigned end = Min(start + PARTICLES_PER_STATE_CHUNK, numParticles);
+        for (unsigned i = start; i < end; ++i)
+        {
+            DoubleVector3 position = previousPositions[i] + (positions[i] - previousPositions[i]) * factor;
+            billboardSet_->GetBillboard(i)->position_ = (position - origin).ToVector3();
+        }
+    }
+
+    billboardSet_->Commit();
+    billboardsDirty_ = false;
+    lastInterpolation_ = interpolation;
+}
+
+void NBodySystem::ResetStateChunks()
+{
+    stateChunks_.Resize(replicated_ ? GetNumChunks() : 0);
+    for (unsigned i = 0; i < stateChunks_.Size(); ++i)
+    {
+        NBodyStateChunk& state = stateChunks_[i];
+        state.tick_ = 0;
+        state.elapsed_ = 0.0f;
+        state.duration_ = 0.0f;
+        state.valid_ = false;
+    }
+}
+
+float NBodySystem::GetChunkInterpolation(unsigned chunk) const
+{
+    if (chunk >= stateChunks_.Size())
+        return 1.0f;
+    const NBodyStateChunk& state = stateChunks_[chunk];
+    return state.elapsed_ < state.duration_ ? state.elapsed_ / state.duration_ : 1.0f;
+}
+
+void NBodySystem::OnSceneSet(Scene* scene)
+{
+    if (scene)
+    {
+        SubscribeToEvent(E_SIMULATIONTICK, URHO3D_HANDLER(NBodySystem, HandleSimulationTick));
+        SubscribeToEvent(scene, E_SCENEPOSTUPDATE, URHO3D_HANDLER(NBodySystem, HandleScenePostUpdate));
+        SubscribeToEvent(E_SIMULATIONSEEK, URHO3D_HANDLER(NBodySystem, HandleSimulationSeek));
+        SubscribeToEvent(E_FLOATINGORIGINSHIFT, URHO3D_HANDLER(NBodySystem, HandleFloatingOriginShift));
+    }
+    else
+    {
+        UnsubscribeFromEvent(E_SIMULATIONTICK);
+        UnsubscribeFromEvent(E_SCENEPOSTUPDATE);
+        UnsubscribeFromEvent(E_SIMULATIONSEEK);
+        UnsubscribeFromEvent(E_FLOATINGORIGINSHIFT);
+    }
+}
+
+void NBodySystem::HandleSimulationTick(StringHash eventType, VariantMap& eventData)
+{
+    using namespace SimulationTick;
+
+    if (positions_.Empty())
+    {
+        time_ = eventData[P_TIME].GetDouble();
+        return;
+    }
+
+    previousPositions_ = positions_;
+    Advance(eventData[P_TIME].GetDouble());
+}
+
+void NBodySystem::HandleScenePostUpdate(StringHash eventType, VariantMap& eventData)
+{
+    if (replicated_)
+    {
+        using namespace ScenePostUpdate;
+
+        // Billboards move while any chunk is still on its way to the positions read last
+        float timeStep = eventData[P_TIMESTEP].GetFloat();
+        bool moving = billboardsDirty_;
+        for (unsigned i = 0; i < stateChunks_.Size(); ++i)
+        {
+            NBodyStateChunk& state = stateChunks_[i];
+            if (state.elapsed_ < state.duration_)
+            {
+                state.elapsed_ += timeStep;
+                moving = true;
+            }
+        }
+        if (moving)
+            ApplyResults(lastInterpolation_);
+        return;
+    }
+
+    SimulationClock* clock = GetSubsystem<SimulationClock>();
+    float interpolation = clock ? clock->GetInterpolation() : 1.0f;
+    if (billboardsDirty_ || interpolation != lastInterpolation_)
+        ApplyResults(interpolation);
+}
+
+void NBodySystem::HandleSimulationSeek(StringHash eventType, VariantMap& eventData)
+{
+    using namespace SimulationSeek;
+
+    // Integrating across an arbitrary jump would take unbounded time; the particles carry on from the new date instead
+    time_ = eventData[P_TIME].GetDouble();
+    previousPositions_ = positions_;
+    accelerationsDirty_ = true;
+    billboardsDirty_ = true;
+}
+
+void NBodySystem::HandleFloatingOriginShift(StringHash eventType, VariantMap& eventData)
+{
+    using namespace FloatingOriginShift;
+
+    if (eventData[P_COMPONENT].GetPtr() == GetScene()->GetComponent<FloatingOrigin>())
+        ApplyResults(lastInterpolation_);
+}
@@ -0,0 +1,250 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <Urho3D/Scene/Component.h>
+
+#include "DoubleVector3.h"
+
+namespace Urho3D
+{
+
+class BillboardSet;
+class Deserializer;
+class Serializer;
+struct WorkItem;
+
+}
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+/// Cell of the Barnes-Hut octree.
+struct BarnesHutCell
+{
+    /// Geometric center.
+    DoubleVector3 center_;
+    /// Half of the cell edge length.
+    double halfSize_;
+    /// Center of mass. Holds the mass-weighted position sum while the tree is built.
+    DoubleVector3 massCenter_;
+    /// Total gravitational parameter of the particles inside.
+    double mass_;
+    /// Index of the first of the eight children, or -1 for a leaf.
+    int firstChild_;
+    /// Particle stored in a leaf, or -1.
+    int particle_;
+};
+
+/// Number of particles whose replicated positions share a message, small enough for one datagram.
+static const unsigned PARTICLES_PER_STATE_CHUNK = 128;
+
+/// Interpolation of a chunk of replicated particles towards the positions read last.
+struct NBodyStateChunk
+{
+    /// Tick of the positions read last.
+    unsigned tick_;
+    /// Real time since they were read.
+    float elapsed_;
+    /// Real time to reach them: that of the ticks since the chunk's previous positions.
+    float duration_;
+    /// Whether positions were read since replication started.
+    bool valid_;
+};
+
+/// Body attracting the particles without being affected by them: the Sun or a planet on its analytic orbit.
+struct NBodyAttractor
+{
+    /// Gravitational parameter (G * mass) in world units cubed per second squared.
+    double gravitationalParameter_;
+    /// Index of the orbit in the scene's OrbitSystem, or M_MAX_UNSIGNED for a body fixed at the world origin.
+    unsigned orbit_;
+};
+
+/// Scene-level component integrating free particles (asteroids, comets, debris) under gravity with a kick-drift-kick
+/// leapfrog on the SimulationClock ticks, using a Barnes-Hut octree for the mutual forces and the WorkQueue for the
+/// passes. A replicated system integrates nothing and interpolates the positions read from an authoritative instance.
+class NBodySystem : public Component
+{
+    URHO3D_OBJECT(NBodySystem, Component);
+
+public:
+    /// Construct.
+    NBodySystem(Context* context);
+    /// Destruct.
+    virtual ~NBodySystem();
+    /// Register object factory.
+    static void RegisterObject(Context* context);
+
+    /// Add a particle in world coordinates, velocity in world units per second and gravitational parameter in world
+    /// units cubed per second squared. Zero makes a test particle, which feels but does not exert gravity. Return the
+    /// particle index.
+    unsigned AddParticle(const DoubleVector3& position, const DoubleVector3& velocity, double gravitationalParameter = 0.0);
+    /// Add an attractor. Without an orbit index it stays fixed at the world origin.
+    void AddAttractor(double gravitationalParameter, unsigned orbit = M_MAX_UNSIGNED);
+    /// Remove all particles.
+    void RemoveAllParticles();
+    /// Remove all attractors.
+    void RemoveAllAttractors();
+    /// Set billboard set displaying the particles. Billboard i follows particle i.
+    void SetBillboardSet(BillboardSet* billboardSet, const Vector2& size);
+    /// Set maximum integration step in simulated seconds.
+    void SetMaxStep(double step);
+    /// Set maximum number of steps per frame. Beyond it the steps get longer rather than the frame slower.
+    void SetMaxStepsPerFrame(unsigned count);
+    /// Set Barnes-Hut opening angle. Cells seen under a smaller angle are approximated by their center of mass.
+    void SetOpeningAngle(float angle);
+    /// Set softening length in world units, avoiding singular forces in close encounters.
+    void SetSoftening(double softening);
+    /// Set minimum number of particles per work item. Smaller workloads are processed on the main thread.
+    void SetMinParticlesPerWorkItem(unsigned count);
+    /// Set simulation time in seconds since J2000 without moving the particles.
+    void SetTime(double time) { time_ = time; }
+    /// Integrate one leapfrog step. The step may be negative.
+    void Step(double step);
+    /// Integrate up to a simulation time in sub-steps.
+    void Advance(double time);
+    /// Set replicated. Integration resumes from the latest positions read when replication ends.
+    void SetReplicated(bool enable);
+    /// Write particle positions and velocities at the last tick for a replica. Both are narrowed to single precision.
+    void WriteState(Serializer& dest) const;
+    /// Read state written by WriteState(). Particles are recreated as test particles if their count differs.
+    void ReadState(Deserializer& source);
+    /// Write the positions of a chunk of particles at the last tick, quantized to 21 bits per coordinate within the
+    /// bounds of the chunk.
+    void WriteChunk(Serializer& dest, unsigned chunk) const;
+    /// Read positions written by WriteChunk() at a tick of the source on a replicated system. Return false if the
+    /// particle count differs, so that the positions have to wait for a state with velocities.
+    bool ReadChunk(Deserializer& source, unsigned tick, float tickLength);
+
+    /// Return number of particles.
+    unsigned GetNumParticles() const { return positions_.Size(); }
+    /// Return number of position chunks written by WriteChunk().
+    unsigned GetNumChunks() const;
+    /// Return number of attractors.
+    unsigned GetNumAttractors() const { return attractors_.Size(); }
+    /// Return attractor.
+    const NBodyAttractor& GetAttractor(unsigned index) const { return attractors_[index]; }
+    /// Return particle position in world coordinates.
+    const DoubleVector3& GetPosition(unsigned index) const { return positions_[index]; }
+    /// Return particle velocity in world units per second.
+    const DoubleVector3& GetVelocity(unsigned index) const { return velocities_[index]; }
+    /// Return simulation time in seconds since J2000.
+    double GetTime() const { return time_; }
+    /// Return maximum integration step.
+    double GetMaxStep() const { return maxStep_; }
+    /// Return maximum number of steps per frame.
+    unsigned GetMaxStepsPerFrame() const { return maxStepsPerFrame_; }
+    /// Return Barnes-Hut opening angle.
+    float GetOpeningAngle() const { return openingAngle_; }
+    /// Return softening length.
+    double GetSoftening() const { return softening_; }
+    /// Return number of cells in the last built octree.
+    unsigned GetNumCells() const { return cells_.Size(); }
+    /// Return whether replicated.
+    bool IsReplicated() const { return replicated_; }
+
+    /// Apply the first half kick and the drift to a particle range. Called from worker threads.
+    void KickDrift(unsigned start, unsigned end);
+    /// Compute accelerations and apply the second half kick to a particle range. Called from worker threads.
+    void ComputeForces(unsigned start, unsigned end);
+
+protected:
+    /// Handle scene being assigned.
+    virtual void OnSceneSet(Scene* scene);
+
+private:
+    /// Handle simulation clock tick event.
+    void HandleSimulationTick(StringHash eventType, VariantMap& eventData);
+    /// Handle scene post-update event.
+    void HandleScenePostUpdate(StringHash eventType, VariantMap& eventData);
+    /// Handle simulation clock seek event.
+    void HandleSimulationSeek(StringHash eventType, VariantMap& eventData);
+    /// Handle floating origin shift event.
+    void HandleFloatingOriginShift(StringHash eventType, VariantMap& eventData);
+    /// Run a pass over all particles, split into work items if worth it, and wait for it.
+    void RunPass(void (*workFunction)(const WorkItem*, unsigned));
+    /// Evaluate attractor positions at the current time.
+    void UpdateAttractors();
+    /// Build the Barnes-Hut octree over the massive particles.
+    void BuildTree();
+    /// Insert a particle into the octree.
+    void InsertParticle(unsigned index);
+    /// Create the eight children of a cell and return the index of the first.
+    int Subdivide(unsigned cell);
+    /// Write particle positions interpolated between the last two ticks to the billboards.
+    void ApplyResults(float interpolation);
+    /// Restart the interpolation of every replicated chunk.
+    void ResetStateChunks();
+    /// Return interpolation factor of a replicated chunk, in [0, 1].
+    float GetChunkInterpolation(unsigned chunk) const;
+
+    /// Particle positions in world coordinates.
+    PODVector<DoubleVector3> positions_;
+    /// Particle positions at the previous tick, for render interpolation.
+    PODVector<DoubleVector3> previousPositions_;
+    /// Particle velocities.
+    PODVector<DoubleVector3> velocities_;
+    /// Particle accelerations at the current positions.
+    PODVector<DoubleVector3> accelerations_;
+    /// Particle gravitational parameters.
+    PODVector<double> masses_;
+    /// Attractors.
+    PODVector<NBodyAttractor> attractors_;
+    /// Attractor positions at the current time.
+    PODVector<DoubleVector3> attractorPositions_;
+    /// Barnes-Hut octree cells, root first.
+    PODVector<BarnesHutCell> cells_;
+    /// Interpolation of the replicated chunks.
+    PODVector<NBodyStateChunk> stateChunks_;
+    /// Billboard set displaying the particles.
+    WeakPtr<BillboardSet> billboardSet_;
+    /// Billboard size.
+    Vector2 billboardSize_;
+
+    /// Simulation time in seconds since J2000.
+    double time_;
+    /// Step being integrated, read by the workers.
+    double step_;
+    /// Maximum integration step.
+    double maxStep_;
+    /// Softening length.
+    double softening_;
+    /// Barnes-Hut opening angle.
+    float openingAngle_;
+    /// Maximum number of steps per frame.
+    unsigned maxStepsPerFrame_;
+    /// Minimum number of particles per work item.
+    unsigned minParticlesPerWorkItem_;
+    /// Number of particles with nonzero mass.
+    unsigned numMassive_;
+    /// Accelerations are stale and must be computed before the next kick.
+    bool accelerationsDirty_;
+    /// Particles moved since the billboards were last written.
+    bool billboardsDirty_;
+    /// Interpolation factor the billboards were last written with.
+    float lastInterpolation_;
+    /// Replicated flag.
+    bool replicated_;
+};
@@ -0,0 +1,421 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/Scene/Scene.h>
+#include <Urho3D/Scene/SceneEvents.h>
+
+#include "FloatingOrigin.h"
+#include "KeplerSolver.h"
+#include "OrbitSystem.h"
+#include "SimulationClock.h"
+#include "WorkRange.h"
+
+#include <Urho3D/DebugNew.h>
+
+/// Default minimum number of bodies per work item.
+static const unsigned DEFAULT_MIN_BODIES_PER_WORKITEM = 4096;
+
+static inline float WrapDegrees(double angle)
+{
+    angle = fmod(angle, 360.0);
+    return (float)(angle < 0.0 ? angle + 360.0 : angle);
+}
+
+static void EvaluateSpinsWork(const WorkItem* item, unsigned threadIndex)
+{
+    OrbitSystem* system = reinterpret_cast<OrbitSystem*>(item->aux_);
+    system->EvaluateSpins((unsigned)(size_t)item->start_, (unsigned)(size_t)item->end_);
+}
+
+static void EvaluateOrbitsWork(const WorkItem* item, unsigned threadIndex)
+{
+    OrbitSystem* system = reinterpret_cast<OrbitSystem*>(item->aux_);
+    system->EvaluateOrbits((unsigned)(size_t)item->start_, (unsigned)(size_t)item->end_);
+}
+
+OrbitSystem::OrbitSystem(Context* context) :
+    Component(context),
+    time_(0.0),
+    evaluationTime_(0.0),
+    minBodiesPerWorkItem_(DEFAULT_MIN_BODIES_PER_WORKITEM),
+    evaluating_(false)
+{
+    // Pick the Kepler solver path now, on the main thread, rather than racing for it from the workers
+    GetBestKeplerSolverPath();
+}
+
+OrbitSystem::~OrbitSystem()
+{
+    // Workers may still be reading the body arrays
+    if (evaluating_)
+        GetSubsystem<WorkQueue>()->Complete(M_MAX_UNSIGNED);
+}
+
+void OrbitSystem::RegisterObject(Context* context)
+{
+    context->RegisterFactory<OrbitSystem>();
+}
+
+unsigned OrbitSystem::AddSpin(Node* node, const Vector3& angularSpeed)
+{
+    EndEvaluate();
+
+    unsigned spin = PushSpin(node, angularSpeed);
+    HashMap<Node*, unsigned>::ConstIterator i = unlinkedOrbits_.Find(node);
+    if (i != unlinkedOrbits_.End() && orbitNodes_[i->second_] == node)
+        LinkSpin(i->second_, spin);
+    return spin;
+}
+
+unsigned OrbitSystem::AddOrbit(Node* node, const OrbitalElements& elements, unsigned parentOrbit)
+{
+    return AddOrbit(node, MakeOrbitBasis(elements), parentOrbit);
+}
+
+unsigned OrbitSystem::AddOrbit(Node* node, const OrbitBasis& basis, unsigned parentOrbit)
+{
+    EndEvaluate();
+
+    unsigned orbit = PushOrbit(node, basis, parentOrbit);
+    HashMap<Node*, unsigned>::ConstIterator i = unlinkedSpins_.Find(node);
+    if (i != unlinkedSpins_.End() && spinNodes_[i->second_] == node)
+        LinkSpin(orbit, i->second_);
+    return orbit;
+}
+
+unsigned OrbitSystem::AddBody(Node* node, const OrbitalElements& elements, const Vector3& angularSpeed,
+    unsigned parentOrbit)
+{
+    return AddBody(node, MakeOrbitBasis(elements), angularSpeed, parentOrbit);
+}
+
+unsigned OrbitSystem::AddBody(Node* node, const OrbitBasis& basis, const Vector3& angularSpeed, unsigned parentOrbit)
+{
+    EndEvaluate();
+
+    unsigned orbit = PushOrbit(node, basis, parentOrbit);
+    LinkSpin(orbit, PushSpin(node, angularSpeed));
+    return orbit;
+}
+
+unsigned OrbitSystem::PushSpin(Node* node, const Vector3& angularSpeed)
+{
+    spinNodes_.Push(WeakPtr<Node>(node));
+    baseRotations_.Push(node ? node->GetRotation() : Quaternion::IDENTITY);
+    angularSpeeds_.Push(angularSpeed);
+    spinLinked_.Push(false);
+    unsigned spin = spinNodes_.Size() - 1;
+    // Overwriting also drops the entry of a destroyed node whose address was reused
+    if (node)
+        unlinkedSpins_[node] = spin;
+    return spin;
+}
+
+unsigned OrbitSystem::PushOrbit(Node* node, const OrbitBasis& basis, unsigned parentOrbit)
+{
+    unsigned orbit = orbitNodes_.Size();
+    if (parentOrbit >= orbit)
+        parentOrbit = M_MAX_UNSIGNED;
+
+    orbitNodes_.Push(WeakPtr<Node>(node));
+    orbits_.Push(basis);
+    orbitParents_.Push(parentOrbit);
+    orbitSpins_.Push(M_MAX_UNSIGNED);
+    if (node)
+        unlinkedOrbits_[node] = orbit;
+    eccentricities_.Push((float)basis.eccentricity_);
+    worldSpace_.Push(node && node->GetParent() && node->GetParent() == GetScene());
+    positions_.Push(GetOrbitPosition(orbits_.Back(), time_));
+    absolutePositions_.Resize(orbit);
+    absolutePositions_.Push(parentOrbit != M_MAX_UNSIGNED ? absolutePositions_[parentOrbit] + positions_.Back() :
+        positions_.Back());
+
+    // Only this node moves, so that adding many bodies stays linear
+    if (node)
+    {
+        const DoubleVector3& position = absolutePositions_.Back();
+        node->SetPosition((worldSpace_.Back() ? position - GetOrigin() : position).ToVector3());
+    }
+    return orbit;
+}
+
+void OrbitSystem::LinkSpin(unsigned orbit, unsigned spin)
+{
+    orbitSpins_[orbit] = spin;
+    spinLinked_[spin] = true;
+
+    HashMap<Node*, unsigned>::Iterator i = unlinkedOrbits_.Find(orbitNodes_[orbit].Get());
+    if (i != unlinkedOrbits_.End() && i->second_ == orbit)
+        unlinkedOrbits_.Erase(i);
+    i = unlinkedSpins_.Find(spinNodes_[spin].Get());
+    if (i != unlinkedSpins_.End() && i->second_ == spin)
+        unlinkedSpins_.Erase(i);
+}
+
+void OrbitSystem::SetAngularSpeed(unsigned index, const Vector3& angularSpeed)
+{
+    EndEvaluate();
+
+    if (index < angularSpeeds_.Size())
+        angularSpeeds_[index] = angularSpeed;
+}
+
+void OrbitSystem::SetElements(unsigned index, const OrbitalElements& elements)
+{
+    EndEvaluate();
+
+    if (index < orbits_.Size())
+    {
+        orbits_[index] = MakeOrbitBasis(elements);
+        eccentricities_[index] = (float)elements.eccentricity_;
+    }
+}
+
+void OrbitSystem::Clear()
+{
+    EndEvaluate();
+
+    spinNodes_.Clear();
+    baseRotations_.Clear();
+    angularSpeeds_.Clear();
+    spinLinked_.Clear();
+    orbitNodes_.Clear();
+    orbits_.Clear();
+    orbitParents_.Clear();
+    orbitSpins_.Clear();
+    eccentricities_.Clear();
+    worldSpace_.Clear();
+    unlinkedSpins_.Clear();
+    unlinkedOrbits_.Clear();
+    rotations_.Clear();
+    positions_.Clear();
+    absolutePositions_.Clear();
+}
+
+void OrbitSystem::SetTime(double time)
+{
+    time_ = time;
+    Evaluate();
+}
+
+void OrbitSystem::SetMinBodiesPerWorkItem(unsigned count)
+{
+    minBodiesPerWorkItem_ = Max(count, 1U);
+}
+
+void OrbitSystem::Evaluate()
+{
+    BeginEvaluate();
+    EndEvaluate();
+}
+
+void OrbitSystem::BeginEvaluate()
+{
+    // A previous evaluation must land before the buffers are reused
+    if (evaluating_)
+        EndEvaluate();
+
+    unsigned numSpins = spinNodes_.Size();
+    unsigned numOrbits = orbitNodes_.Size();
+    rotations_.Resize(numSpins);
+    positions_.Resize(numOrbits);
+    meanAnomalies_.Resize(numOrbits);
+    batchMeanAnomalies_.Resize(numOrbits);
+    batchEccentricAnomalies_.Resize(numOrbits);
+
+    evaluationTime_ = time_;
+    evaluating_ = true;
+    QueueEvaluation(EvaluateSpinsWork, numSpins);
+    QueueEvaluation(EvaluateOrbitsWork, numOrbits);
+}
+
+void OrbitSystem::EndEvaluate()
+{
+    if (!evaluating_)
+        return;
+
+    GetSubsystem<WorkQueue>()->Complete(M_MAX_UNSIGNED);
+    evaluating_ = false;
+    ApplyResults();
+}
+
+void OrbitSystem::QueueEvaluation(void (*workFunction)(const WorkItem*, unsigned), unsigned count)
+{
+    if (!count || QueueRangeWork(GetSubsystem<WorkQueue>(), workFunction, this, count, minBodiesPerWorkItem_))
+        return;
+
+    if (workFunction == EvaluateSpinsWork)
+        EvaluateSpins(0, count);
+    else
+        EvaluateOrbits(0, count);
+}
+
+void OrbitSystem::EvaluateSpins(unsigned start, unsigned end)
+{
+    double time = evaluationTime_;
+    const Quaternion* baseRotations = baseRotations_.Buffer();
+    const Vector3* angularSpeeds = angularSpeeds_.Buffer();
+    Quaternion* rotations = rotations_.Buffer();
+
+    for (unsigned i = start; i < end; ++i)
+    {
+        const Vector3& speed = angularSpeeds[i];
+        rotations[i] = baseRotations[i] * Quaternion(WrapDegrees(speed.x_ * time), WrapDegrees(speed.y_ * time),
+            WrapDegrees(speed.z_ * time));
+    }
+}
+
+void OrbitSystem::EvaluateOrbits(unsigned start, unsigned end)
+{
+    double time = evaluationTime_;
+    const OrbitBasis* orbits = orbits_.Buffer();
+    double* meanAnomalies = meanAnomalies_.Buffer();
+    float* batchMeanAnomalies = batchMeanAnomalies_.Buffer();
+    float* batchEccentricAnomalies = batchEccentricAnomalies_.Buffer();
+    DoubleVector3* positions = positions_.Buffer();
+
+    for (unsigned i = start; i < end; ++i)
+    {
+        meanAnomalies[i] = GetMeanAnomaly(orbits[i], time);
+        batchMeanAnomalies[i] = (float)meanAnomalies[i];
+    }
+
+    SolveKeplerBatch(batchMeanAnomalies + start, eccentricities_.Buffer() + start, batchEccentricAnomalies + start, 0, 0,
+        end - start);
+
+    for (unsigned i = start; i < end; ++i)
+    {
+        const OrbitBasis& orbit = orbits[i];
+        double eccentricAnomaly = RefineKepler(meanAnomalies[i], orbit.eccentricity_, batchEccentricAnomalies[i]);
+        positions[i] = GetOrbitPositionAtAnomaly(orbit, eccentricAnomaly);
+    }
+}
+
+void OrbitSystem::ApplyResults()
+{
+    unsigned numSpins = Min(spinNodes_.Size(), rotations_.Size());
+    WeakPtr<Node>* spinNodes = spinNodes_.Buffer();
+    const Quaternion* rotations = rotations_.Buffer();
+    const bool* spinLinked = spinLinked_.Buffer();
+
+    for (unsigned i = 0; i < numSpins; ++i)
+    {
+        Node* node = spinNodes[i].Get();
+        if (node && !spinLinked[i])
+            node->SetRotation(rotations[i]);
+    }
+
+    // Parents come first, so one pass accumulates the whole satellite chain
+    unsigned numOrbits = Min(orbitNodes_.Size(), positions_.Size());
+    absolutePositions_.Resize(numOrbits);
+    const DoubleVector3* positions = positions_.Buffer();
+    const unsigned* orbitParents = orbitParents_.Buffer();
+    DoubleVector3* absolutePositions = absolutePositions_.Buffer();
+
+    for (unsigned i = 0; i < numOrbits; ++i)
+    {
+        unsigned parent = orbitParents[i];
+        absolutePositions[i] = parent != M_MAX_UNSIGNED ? absolutePositions[parent] + positions[i] : positions[i];
+    }
+
+    WeakPtr<Node>* orbitNodes = orbitNodes_.Buffer();
+    const unsigned* orbitSpins = orbitSpins_.Buffer();
+    const bool* worldSpace = worldSpace_.Buffer();
+    // Subtract the origin in double precision, before the position is narrowed to single precision
+    DoubleVector3 origin = GetOrigin();
+
+    for (unsigned i = 0; i < numOrbits; ++i)
+    {
+        Node* node = orbitNodes[i].Get();
+        if (!node)
+            continue;
+
+        Vector3 position = (worldSpace[i] ? absolutePositions[i] - origin : absolutePositions[i]).ToVector3();
+        unsigned spin = orbitSpins[i];
+        // One transform update, and one dirty walk, for bodies that both move and spin
+        if (spin < numSpins)
+            node->SetTransform(position, rotations[spin]);
+        else
+            node->SetPosition(position);
+    }
+}
+
+DoubleVector3 OrbitSystem::GetOrigin() const
+{
+    Scene* scene = GetScene();
+    FloatingOrigin* floatingOrigin = scene ? scene->GetComponent<FloatingOrigin>() : 0;
+    return floatingOrigin ? floatingOrigin->GetOrigin() : DoubleVector3::ZERO;
+}
+
+void OrbitSystem::OnSceneSet(Scene* scene)
+{
+    if (scene)
+    {
+        SubscribeToEvent(scene, E_SCENEUPDATE, URHO3D_HANDLER(OrbitSystem, HandleSceneUpdate));
+        SubscribeToEvent(scene, E_SCENEPOSTUPDATE, URHO3D_HANDLER(OrbitSystem, HandleScenePostUpdate));
+        SubscribeToEvent(E_SIMULATIONSEEK, URHO3D_HANDLER(OrbitSystem, HandleSimulationSeek));
+        SubscribeToEvent(E_FLOATINGORIGINSHIFT, URHO3D_HANDLER(OrbitSystem, HandleFloatingOriginShift));
+    }
+    else
+    {
+        EndEvaluate();
+        UnsubscribeFromEvent(E_SCENEUPDATE);
+        UnsubscribeFromEvent(E_SCENEPOSTUPDATE);
+        UnsubscribeFromEvent(E_SIMULATIONSEEK);
+        UnsubscribeFromEvent(E_FLOATINGORIGINSHIFT);
+    }
+}
+
+void OrbitSystem::HandleSceneUpdate(StringHash eventType, VariantMap& eventData)
+{
+    // Follow the global clock; without one the bodies stay at the last time set. Orbits are closed-form, so evaluating
+    // at the interpolated render time is exact rather than an approximation between ticks
+    SimulationClock* clock = GetSubsystem<SimulationClock>();
+    if (clock)
+        time_ = clock->GetRenderTime();
+
+    BeginEvaluate();
+}
+
+void OrbitSystem::HandleScenePostUpdate(StringHash eventType, VariantMap& eventData)
+{
+    EndEvaluate();
+}
+
+void OrbitSystem::HandleSimulationSeek(StringHash eventType, VariantMap& eventData)
+{
+    using namespace SimulationSeek;
+
+    // Re-evaluate in place so the scene shows the new date on this very frame
+    SetTime(eventData[P_TIME].GetDouble());
+}
+
+void OrbitSystem::HandleFloatingOriginShift(StringHash eventType, VariantMap& eventData)
+{
+    using namespace FloatingOriginShift;
+
+    // Only the origin of our own scene matters. The positions are still buffered, so just convert them again
+    if (eventData[P_COMPONENT].GetPtr() == GetScene()->GetComponent<FloatingOrigin>() && !evaluating_)
+        ApplyResults();
+}
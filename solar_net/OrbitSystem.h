@@ -0,0 +1,189 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <Urho3D/Scene/Component.h>
+
+#include "Ephemeris.h"
+
+namespace Urho3D
+{
+
+struct WorkItem;
+
+}
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+/// Scene-level component that moves every orbiting and spinning body of the scene in one pass, from parallel arrays
+/// evaluated in closed form at the SimulationClock time. Evaluation runs in chunks on the WorkQueue during the scene
+/// update; the results are written back to the nodes, one SetTransform() each, at scene post-update.
+class OrbitSystem : public Component
+{
+    URHO3D_OBJECT(OrbitSystem, Component);
+
+public:
+    /// Construct.
+    OrbitSystem(Context* context);
+    /// Destruct.
+    virtual ~OrbitSystem();
+    /// Register object factory.
+    static void RegisterObject(Context* context);
+
+    /// Add a body rotating about its Euler axes, speed in degrees per simulated second. The node's current rotation is
+    /// kept as the base orientation, reached at J2000. Return the spin index.
+    unsigned AddSpin(Node* node, const Vector3& angularSpeed);
+    /// Add a body moving along a Keplerian orbit around its parent node, or around the body of a previously added
+    /// parent orbit. Return the orbit index.
+    unsigned AddOrbit(Node* node, const OrbitalElements& elements, unsigned parentOrbit = M_MAX_UNSIGNED);
+    /// Add a body moving along an orbit given by its precomputed evaluation basis. Return the orbit index.
+    unsigned AddOrbit(Node* node, const OrbitBasis& basis, unsigned parentOrbit = M_MAX_UNSIGNED);
+    /// Add a body that both orbits and spins, in one step. Return the orbit index.
+    unsigned AddBody(Node* node, const OrbitalElements& elements, const Vector3& angularSpeed,
+        unsigned parentOrbit = M_MAX_UNSIGNED);
+    /// Add a body that both orbits and spins, from a precomputed orbit evaluation basis. Return the orbit index.
+    unsigned AddBody(Node* node, const OrbitBasis& basis, const Vector3& angularSpeed,
+        unsigned parentOrbit = M_MAX_UNSIGNED);
+    /// Set angular speed of a spin.
+    void SetAngularSpeed(unsigned index, const Vector3& angularSpeed);
+    /// Set orbital elements of an orbit.
+    void SetElements(unsigned index, const OrbitalElements& elements);
+    /// Remove all bodies.
+    void Clear();
+    /// Set simulation time in seconds since J2000 and move all bodies there immediately.
+    void SetTime(double time);
+    /// Move all bodies to their state at the current simulation time. Blocks until done.
+    void Evaluate();
+    /// Start evaluating all bodies at the current simulation time on the worker threads.
+    void BeginEvaluate();
+    /// Wait for the evaluation started by BeginEvaluate() and write the results to the scene nodes.
+    void EndEvaluate();
+    /// Set minimum number of bodies per work item. Smaller workloads are evaluated on the main thread.
+    void SetMinBodiesPerWorkItem(unsigned count);
+
+    /// Return number of spins.
+    unsigned GetNumSpins() const { return spinNodes_.Size(); }
+    /// Return number of orbits.
+    unsigned GetNumOrbits() const { return orbitNodes_.Size(); }
+    /// Return scene node of a spin.
+    Node* GetSpinNode(unsigned index) const { return spinNodes_[index]; }
+    /// Return rotation of a spin at J2000.
+    const Quaternion& GetBaseRotation(unsigned index) const { return baseRotations_[index]; }
+    /// Return angular speed of a spin.
+    const Vector3& GetAngularSpeed(unsigned index) const { return angularSpeeds_[index]; }
+    /// Return whether a spin is applied together with the orbit of its node.
+    bool IsSpinLinked(unsigned index) const { return spinLinked_[index]; }
+    /// Return scene node of an orbit.
+    Node* GetOrbitNode(unsigned index) const { return orbitNodes_[index]; }
+    /// Return parent orbit of an orbit, or M_MAX_UNSIGNED if it orbits its parent node.
+    unsigned GetParentOrbit(unsigned index) const { return orbitParents_[index]; }
+    /// Return spin of the same node as an orbit, or M_MAX_UNSIGNED if the node does not spin.
+    unsigned GetOrbitSpin(unsigned index) const { return orbitSpins_[index]; }
+    /// Return evaluation basis of an orbit.
+    const OrbitBasis& GetOrbit(unsigned index) const { return orbits_[index]; }
+    /// Return last evaluated position of an orbit relative to its parent node, parent orbits included, in world units.
+    const DoubleVector3& GetPosition(unsigned index) const { return absolutePositions_[index]; }
+    /// Return simulation time of the last evaluation in seconds since J2000.
+    double GetTime() const { return time_; }
+    /// Return minimum number of bodies per work item.
+    unsigned GetMinBodiesPerWorkItem() const { return minBodiesPerWorkItem_; }
+
+    /// Evaluate spins in an index range into the rotation buffer. Called from worker threads.
+    void EvaluateSpins(unsigned start, unsigned end);
+    /// Evaluate orbits in an index range into the position buffer. Called from worker threads.
+    void EvaluateOrbits(unsigned start, unsigned end);
+
+protected:
+    /// Handle scene being assigned.
+    virtual void OnSceneSet(Scene* scene);
+
+private:
+    /// Handle scene update event.
+    void HandleSceneUpdate(StringHash eventType, VariantMap& eventData);
+    /// Handle scene post-update event.
+    void HandleScenePostUpdate(StringHash eventType, VariantMap& eventData);
+    /// Handle simulation clock seek event.
+    void HandleSimulationSeek(StringHash eventType, VariantMap& eventData);
+    /// Handle floating origin shift event.
+    void HandleFloatingOriginShift(StringHash eventType, VariantMap& eventData);
+    /// Queue work items for a body range, or evaluate it directly if it is too small to be worth splitting.
+    void QueueEvaluation(void (*workFunction)(const WorkItem*, unsigned), unsigned count);
+    /// Write evaluated rotations and positions to the scene nodes.
+    void ApplyResults();
+    /// Append a spin without looking for an orbit of the same node.
+    unsigned PushSpin(Node* node, const Vector3& angularSpeed);
+    /// Append an orbit without looking for a spin of the same node, and move the node to its current position.
+    unsigned PushOrbit(Node* node, const OrbitBasis& basis, unsigned parentOrbit);
+    /// Pair the orbit and spin of a node so that both are applied at once.
+    void LinkSpin(unsigned orbit, unsigned spin);
+    /// Return the floating origin of the scene, or zero without one.
+    DoubleVector3 GetOrigin() const;
+
+    /// Spinning body scene nodes.
+    Vector<WeakPtr<Node> > spinNodes_;
+    /// Spinning body rotations at J2000.
+    PODVector<Quaternion> baseRotations_;
+    /// Spinning body angular speeds in degrees per simulated second.
+    PODVector<Vector3> angularSpeeds_;
+    /// Per-spin flag for spins applied together with their node's orbit.
+    PODVector<bool> spinLinked_;
+    /// Orbiting body scene nodes.
+    Vector<WeakPtr<Node> > orbitNodes_;
+    /// Orbit evaluation bases.
+    PODVector<OrbitBasis> orbits_;
+    /// Parent orbit indices, always lower than the orbit's own.
+    PODVector<unsigned> orbitParents_;
+    /// Spin of the same node per orbit, or M_MAX_UNSIGNED.
+    PODVector<unsigned> orbitSpins_;
+    /// Orbit eccentricities, contiguous for the batch Kepler solver.
+    PODVector<float> eccentricities_;
+    /// Per-frame mean anomalies in double precision.
+    PODVector<double> meanAnomalies_;
+    /// Per-frame mean anomalies handed to the batch Kepler solver.
+    PODVector<float> batchMeanAnomalies_;
+    /// Per-frame eccentric anomalies returned by the batch Kepler solver.
+    PODVector<float> batchEccentricAnomalies_;
+    /// Evaluated spin rotations, written by the workers.
+    PODVector<Quaternion> rotations_;
+    /// Evaluated orbit positions relative to the parent, written by the workers.
+    PODVector<DoubleVector3> positions_;
+    /// Orbit positions with the parent orbits added, in double precision.
+    PODVector<DoubleVector3> absolutePositions_;
+    /// Per-orbit flag for nodes directly under the scene root, whose positions are in world coordinates.
+    PODVector<bool> worldSpace_;
+    /// Latest spin not yet paired with an orbit per node, so that pairing a new orbit costs one lookup.
+    HashMap<Node*, unsigned> unlinkedSpins_;
+    /// Latest orbit not yet paired with a spin per node, so that pairing a new spin costs one lookup.
+    HashMap<Node*, unsigned> unlinkedOrbits_;
+
+    /// Simulation time in seconds since J2000.
+    double time_;
+    /// Simulation time being evaluated by the workers.
+    double evaluationTime_;
+    /// Minimum number of bodies per work item.
+    unsigned minBodiesPerWorkItem_;
+    /// Evaluation in progress flag.
+    bool evaluating_;
+};
@@ -0,0 +1,337 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Graphics/Geometry.h>
+#include <Urho3D/Graphics/Material.h>
+#include <Urho3D/Graphics/VertexBuffer.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "FloatingOrigin.h"
+#include "OrbitTrails.h"
+#include "SimulationClock.h"
+
+#include <string.h>
+
+#include <Urho3D/DebugNew.h>
+
+/// Line segments per orbit path.
+static const unsigned ORBIT_PATH_SEGMENTS = 256;
+/// Default segments per trail.
+static const unsigned DEFAULT_TRAIL_LENGTH = 512;
+/// Default simulation time between trail samples: one day.
+static const double DEFAULT_SAMPLE_INTERVAL = SECONDS_PER_DAY;
+/// Floats per vertex: position and packed color.
+static const unsigned FLOATS_PER_VERTEX = 4;
+/// Floats per line segment.
+static const unsigned FLOATS_PER_SEGMENT = FLOATS_PER_VERTEX * 2;
+
+OrbitTrails::OrbitTrails(Context* context) :
+    Drawable(context, DRAWABLE_GEOMETRY),
+    geometry_(new Geometry(context)),
+    vertexBuffer_(new VertexBuffer(context_)),
+    trailLength_(DEFAULT_TRAIL_LENGTH),
+    head_(0),
+    sampleInterval_(DEFAULT_SAMPLE_INTERVAL),
+    lastSampleTime_(0.0),
+    dirtyStart_(0),
+    dirtyEnd_(0),
+    rebuildNeeded_(false)
+{
+    geometry_->SetVertexBuffer(0, vertexBuffer_, MASK_POSITION | MASK_COLOR);
+
+    batches_.Resize(1);
+    batches_[0].geometry_ = geometry_;
+}
+
+OrbitTrails::~OrbitTrails()
+{
+}
+
+void OrbitTrails::RegisterObject(Context* context)
+{
+    context->RegisterFactory<OrbitTrails>();
+}
+
+void OrbitTrails::UpdateBatches(const FrameInfo& frame)
+{
+    distance_ = frame.camera_->GetDistance(GetWorldBoundingBox().Center());
+
+    batches_[0].distance_ = distance_;
+    batches_[0].worldTransform_ = &node_->GetWorldTransform();
+}
+
+void OrbitTrails::UpdateGeometry(const FrameInfo& frame)
+{
+    if (vertexBuffer_->IsDataLost())
+    {
+        vertexBuffer_->ClearDataLost();
+        MarkDirty(0, vertexBuffer_->GetVertexCount() / 2);
+    }
+
+    if (dirtyEnd_ > dirtyStart_)
+    {
+        vertexBuffer_->SetDataRange(&vertexData_[dirtyStart_ * FLOATS_PER_SEGMENT], dirtyStart_ * 2,
+            (dirtyEnd_ - dirtyStart_) * 2);
+        dirtyStart_ = dirtyEnd_ = 0;
+    }
+}
+
+UpdateGeometryType OrbitTrails::GetUpdateGeometryType()
+{
+    return dirtyEnd_ > dirtyStart_ || vertexBuffer_->IsDataLost() ? UPDATE_MAIN_THREAD : UPDATE_NONE;
+}
+
+unsigned OrbitTrails::AddTrail(Node* node, const Color& color)
+{
+    trailNodes_.Push(WeakPtr<Node>(node));
+    trailColors_.Push(color.ToUInt());
+    // The slot-major layout depends on the trail count, so all trails restart
+    ResetTrails();
+    return trailNodes_.Size() - 1;
+}
+
+unsigned OrbitTrails::AddOrbitPath(const OrbitBasis& orbit, const Color& color)
+{
+    paths_.Push(orbit);
+    pathColors_.Push(color.ToUInt());
+    rebuildNeeded_ = true;
+    return paths_.Size() - 1;
+}
+
+void OrbitTrails::RemoveAll()
+{
+    trailNodes_.Clear();
+    trailColors_.Clear();
+    samples_.Clear();
+    paths_.Clear();
+    pathColors_.Clear();
+    rebuildNeeded_ = true;
+}
+
+void OrbitTrails::SetMaterial(Material* material)
+{
+    batches_[0].material_ = material;
+}
+
+void OrbitTrails::SetTrailLength(unsigned segments)
+{
+    trailLength_ = Max(segments, 2U);
+    ResetTrails();
+}
+
+void OrbitTrails::SetSampleInterval(double interval)
+{
+    sampleInterval_ = Max(interval, 0.0);
+}
+
+void OrbitTrails::ResetTrails()
+{
+    unsigned numTrails = trailNodes_.Size();
+    samples_.Resize(numTrails * trailLength_);
+    head_ = 0;
+
+    // Every slot starts at the current position, making degenerate segments until the trail grows
+    for (unsigned i = 0; i < numTrails; ++i)
+    {
+        DoubleVector3 position = GetTrailPosition(i);
+        for (unsigned j = 0; j < trailLength_; ++j)
+            samples_[j * numTrails + i] = position;
+    }
+
+    SimulationClock* clock = GetSubsystem<SimulationClock>();
+    lastSampleTime_ = clock ? clock->GetRenderTime() : 0.0;
+    rebuildNeeded_ = true;
+}
+
+Material* OrbitTrails::GetMaterial() const
+{
+    return batches_[0].material_;
+}
+
+void OrbitTrails::OnSceneSet(Scene* scene)
+{
+    Drawable::OnSceneSet(scene);
+
+    if (scene)
+    {
+        SubscribeToEvent(E_POSTUPDATE, URHO3D_HANDLER(OrbitTrails, HandlePostUpdate));
+        SubscribeToEvent(E_SIMULATIONSEEK, URHO3D_HANDLER(OrbitTrails, HandleSimulationSeek));
+        SubscribeToEvent(E_FLOATINGORIGINSHIFT, URHO3D_HANDLER(OrbitTrails, HandleFloatingOriginShift));
+    }
+    else
+    {
+        UnsubscribeFromEvent(E_POSTUPDATE);
+        UnsubscribeFromEvent(E_SIMULATIONSEEK);
+        UnsubscribeFromEvent(E_FLOATINGORIGINSHIFT);
+    }
+}
+
+void OrbitTrails::OnWorldBoundingBoxUpdate()
+{
+    worldBoundingBox_ = boundingBox_.Transformed(node_->GetWorldTransform());
+}
+
+void OrbitTrails::HandlePostUpdate(StringHash eventType, VariantMap& eventData)
+{
+    SimulationClock* clock = GetSubsystem<SimulationClock>();
+    double time = clock ? clock->GetRenderTime() : lastSampleTime_;
+
+    if (!trailNodes_.Empty() && !rebuildNeeded_ && Abs(time - lastSampleTime_) >= sampleInterval_)
+    {
+        AppendSamples();
+        lastSampleTime_ = time;
+    }
+
+    if (rebuildNeeded_)
+        RebuildVertices();
+}
+
+void OrbitTrails::HandleSimulationSeek(StringHash eventType, VariantMap& eventData)
+{
+    // The bodies are only at their new positions once the scene has updated; restart the trails from there
+    samples_.Clear();
+    rebuildNeeded_ = true;
+}
+
+void OrbitTrails::HandleFloatingOriginShift(StringHash eventType, VariantMap& eventData)
+{
+    using namespace FloatingOriginShift;
+
+    // Vertices are in render space and must be rewritten before this frame renders
+    if (eventData[P_COMPONENT].GetPtr() == GetScene()->GetComponent<FloatingOrigin>())
+        RebuildVertices();
+}
+
+DoubleVector3 OrbitTrails::GetTrailPosition(unsigned index) const
+{
+    Node* node = trailNodes_[index].Get();
+    if (!node)
+        return DoubleVector3::ZERO;
+
+    FloatingOrigin* floatingOrigin = GetScene() ? GetScene()->GetComponent<FloatingOrigin>() : 0;
+    Vector3 position = node->GetWorldPosition();
+    return floatingOrigin ? floatingOrigin->ToWorld(position) : DoubleVector3(position);
+}
+
+void OrbitTrails::AppendSamples()
+{
+    unsigned numTrails = trailNodes_.Size();
+    unsigned previousHead = head_;
+    head_ = (head_ + 1) % trailLength_;
+
+    unsigned firstSegment = paths_.Size() * ORBIT_PATH_SEGMENTS + head_ * numTrails;
+    for (unsigned i = 0; i < numTrails; ++i)
+    {
+        DoubleVector3 position = GetTrailPosition(i);
+        samples_[head_ * numTrails + i] = position;
+        WriteSegment(firstSegment + i, samples_[previousHead * numTrails + i], position, trailColors_[i]);
+    }
+
+    // The new segments of all trails are adjacent
+    MarkDirty(firstSegment, numTrails);
+    OnMarkedDirty(node_);
+}
+
+void OrbitTrails::RebuildVertices()
+{
+    unsigned numTrails = trailNodes_.Size();
+    if (samples_.Size() != numTrails * trailLength_)
+        ResetTrails();
+    rebuildNeeded_ = false;
+
+    unsigned numPaths = paths_.Size();
+    unsigned numSegments = numPaths * ORBIT_PATH_SEGMENTS + numTrails * trailLength_;
+    if (vertexBuffer_->GetVertexCount() != numSegments * 2)
+    {
+        vertexBuffer_->SetSize(numSegments * 2, MASK_POSITION | MASK_COLOR, true);
+        vertexData_.Resize(numSegments * FLOATS_PER_SEGMENT);
+        geometry_->SetDrawRange(LINE_LIST, 0, 0, 0, numSegments * 2);
+    }
+
+    boundingBox_.Clear();
+
+    unsigned segment = 0;
+    for (unsigned i = 0; i < numPaths; ++i)
+    {
+        const OrbitBasis& orbit = paths_[i];
+        DoubleVector3 start = GetOrbitPositionAtAnomaly(orbit, 0.0);
+        for (unsigned j = 1; j <= ORBIT_PATH_SEGMENTS; ++j)
+        {
+            DoubleVector3 end = GetOrbitPositionAtAnomaly(orbit, 2.0 * DOUBLE_PI * j / ORBIT_PATH_SEGMENTS);
+            WriteSegment(segment++, start, end, pathColors_[i]);
+            start = end;
+        }
+    }
+
+    // The oldest slot lost its start point to the ring; it is drawn degenerate until overwritten
+    unsigned oldest = (head_ + 1) % trailLength_;
+    for (unsigned i = 0; i < trailLength_; ++i)
+    {
+        unsigned previous = i == oldest ? i : (i + trailLength_ - 1) % trailLength_;
+        for (unsigned j = 0; j < numTrails; ++j)
+            WriteSegment(segment++, samples_[previous * numTrails + j], samples_[i * numTrails + j], trailColors_[j]);
+    }
+
+    MarkDirty(0, numSegments);
+    OnMarkedDirty(node_);
+}
+
+void OrbitTrails::WriteSegment(unsigned segment, const DoubleVector3& start, const DoubleVector3& end, unsigned color)
+{
+    FloatingOrigin* floatingOrigin = GetScene() ? GetScene()->GetComponent<FloatingOrigin>() : 0;
+    DoubleVector3 origin = floatingOrigin ? floatingOrigin->GetOrigin() : DoubleVector3::ZERO;
+    Vector3 renderStart = (start - origin).ToVector3();
+    Vector3 renderEnd = (end - origin).ToVector3();
+
+    float* dest = &vertexData_[segment * FLOATS_PER_SEGMENT];
+    dest[0] = renderStart.x_;
+    dest[1] = renderStart.y_;
+    dest[2] = renderStart.z_;
+    memcpy(&dest[3], &color, sizeof color);
+    dest[4] = renderEnd.x_;
+    dest[5] = renderEnd.y_;
+    dest[6] = renderEnd.z_;
+    memcpy(&dest[7], &color, sizeof color);
+
+    boundingBox_.Merge(renderStart);
+    boundingBox_.Merge(renderEnd);
+}
+
+void OrbitTrails::MarkDirty(unsigned firstSegment, unsigned numSegments)
+{
+    if (!numSegments)
+        return;
+
+    if (dirtyEnd_ > dirtyStart_)
+    {
+        dirtyStart_ = Min(dirtyStart_, firstSegment);
+        dirtyEnd_ = Max(dirtyEnd_, firstSegment + numSegments);
+    }
+    else
+    {
+        dirtyStart_ = firstSegment;
+        dirtyEnd_ = firstSegment + numSegments;
+    }
+}
@@ -0,0 +1,147 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <Urho3D/Graphics/Drawable.h>
+
+#include "DoubleVector3.h"
+#include "Ephemeris.h"
+
+namespace Urho3D
+{
+
+class Geometry;
+class VertexBuffer;
+
+}
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+/// Drawable showing the orbit paths and the recent trails of many bodies as lines, in a single batch.
+/// Everything lives in one preallocated dynamic vertex buffer drawn as a line list: first the orbit paths, static ellipses
+/// around the world origin, then the trails. Trails are ring buffers of segments sampled at a fixed simulation time
+/// interval. All trails share the ring head and are laid out slot-major (slot 0 of every trail, then slot 1...), so
+/// appending a sample to every trail touches one contiguous range, uploaded with a single SetDataRange() call. The whole
+/// buffer is only rewritten when the floating origin moves, the simulation seeks or the GPU data is lost.
+class OrbitTrails : public Drawable
+{
+    URHO3D_OBJECT(OrbitTrails, Drawable);
+
+public:
+    /// Construct.
+    OrbitTrails(Context* context);
+    /// Destruct.
+    virtual ~OrbitTrails();
+    /// Register object factory.
+    static void RegisterObject(Context* context);
+
+    /// Calculate distance and prepare batches for rendering.
+    virtual void UpdateBatches(const FrameInfo& frame);
+    /// Upload pending vertex data.
+    virtual void UpdateGeometry(const FrameInfo& frame);
+    /// Return whether a geometry update is necessary, and if it can happen in a worker thread.
+    virtual UpdateGeometryType GetUpdateGeometryType();
+
+    /// Add a trail following a node. Return the trail index.
+    unsigned AddTrail(Node* node, const Color& color);
+    /// Add the path of an orbit around the world origin. Return the path index.
+    unsigned AddOrbitPath(const OrbitBasis& orbit, const Color& color);
+    /// Remove all trails and paths.
+    void RemoveAll();
+    /// Set material. It should use vertex colors.
+    void SetMaterial(Material* material);
+    /// Set number of segments kept per trail.
+    void SetTrailLength(unsigned segments);
+    /// Set simulation time between trail samples, in seconds.
+    void SetSampleInterval(double interval);
+    /// Restart all trails from the current body positions.
+    void ResetTrails();
+
+    /// Return number of trails.
+    unsigned GetNumTrails() const { return trailNodes_.Size(); }
+    /// Return number of orbit paths.
+    unsigned GetNumOrbitPaths() const { return paths_.Size(); }
+    /// Return number of segments kept per trail.
+    unsigned GetTrailLength() const { return trailLength_; }
+    /// Return simulation time between trail samples.
+    double GetSampleInterval() const { return sampleInterval_; }
+    /// Return material.
+    Material* GetMaterial() const;
+
+protected:
+    /// Handle scene being assigned.
+    virtual void OnSceneSet(Scene* scene);
+    /// Recalculate the world-space bounding box.
+    virtual void OnWorldBoundingBoxUpdate();
+
+private:
+    /// Handle logic post-update event.
+    void HandlePostUpdate(StringHash eventType, VariantMap& eventData);
+    /// Handle simulation clock seek event.
+    void HandleSimulationSeek(StringHash eventType, VariantMap& eventData);
+    /// Handle floating origin shift event.
+    void HandleFloatingOriginShift(StringHash eventType, VariantMap& eventData);
+    /// Return current world position of a trail's node.
+    DoubleVector3 GetTrailPosition(unsigned index) const;
+    /// Append one sample to every trail.
+    void AppendSamples();
+    /// Resize the vertex buffer and rewrite all vertices.
+    void RebuildVertices();
+    /// Write one line segment to the vertex data in render space.
+    void WriteSegment(unsigned segment, const DoubleVector3& start, const DoubleVector3& end, unsigned color);
+    /// Add a range of segments to the pending upload.
+    void MarkDirty(unsigned firstSegment, unsigned numSegments);
+
+    /// Geometry.
+    SharedPtr<Geometry> geometry_;
+    /// Vertex buffer.
+    SharedPtr<VertexBuffer> vertexBuffer_;
+    /// CPU copy of the vertex data, as floats: position then packed color.
+    PODVector<float> vertexData_;
+    /// Trail nodes.
+    Vector<WeakPtr<Node> > trailNodes_;
+    /// Trail colors.
+    PODVector<unsigned> trailColors_;
+    /// Trail samples in world coordinates, slot-major.
+    PODVector<DoubleVector3> samples_;
+    /// Orbit paths.
+    PODVector<OrbitBasis> paths_;
+    /// Orbit path colors.
+    PODVector<unsigned> pathColors_;
+    /// Segments per trail.
+    unsigned trailLength_;
+    /// Ring slot written by the last sample.
+    unsigned head_;
+    /// Simulation time between samples.
+    double sampleInterval_;
+    /// Simulation time of the last sample.
+    double lastSampleTime_;
+    /// First segment of the pending upload.
+    unsigned dirtyStart_;
+    /// One past the last segment of the pending upload.
+    unsigned dirtyEnd_;
+    /// Vertex buffer needs resizing and a full rewrite.
+    bool rebuildNeeded_;
+};
@@ -0,0 +1,108 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+#include <Urho3D/Graphics/Material.h>
+#include <Urho3D/Graphics/Model.h>
+#include <Urho3D/Resource/ResourceCache.h>
+
+#include "ResourceTable.h"
+#include "TextureStreamer.h"
+
+#include <Urho3D/DebugNew.h>
+
+ResourceTable::ResourceTable(Context* context) :
+    Object(context)
+{
+}
+
+ResourceTable::~ResourceTable()
+{
+}
+
+unsigned ResourceTable::InternModel(const char* name)
+{
+    return Intern(models_, modelNames_, modelHandles_, Model::GetTypeStatic(), "Models/", name);
+}
+
+unsigned ResourceTable::InternMaterial(const char* name)
+{
+    return Intern(materials_, materialNames_, materialHandles_, Material::GetTypeStatic(), "Materials/", name);
+}
+
+void ResourceTable::Clear()
+{
+    models_.Clear();
+    materials_.Clear();
+    modelNames_.Clear();
+    materialNames_.Clear();
+    modelHandles_.Clear();
+    materialHandles_.Clear();
+}
+
+Model* ResourceTable::GetModel(unsigned handle) const
+{
+    return handle < models_.Size() ? static_cast<Model*>(models_[handle].Get()) : 0;
+}
+
+Material* ResourceTable::GetMaterial(unsigned handle) const
+{
+    return handle < materials_.Size() ? static_cast<Material*>(materials_[handle].Get()) : 0;
+}
+
+const String& ResourceTable::GetModelName(unsigned handle) const
+{
+    return handle < modelNames_.Size() ? modelNames_[handle] : String::EMPTY;
+}
+
+const String& ResourceTable::GetMaterialName(unsigned handle) const
+{
+    return handle < materialNames_.Size() ? materialNames_[handle] : String::EMPTY;
+}
+
+unsigned ResourceTable::Intern(Vector<SharedPtr<Resource> >& resources, Vector<String>& names,
+    HashMap<StringHash, unsigned>& handles, StringHash type, const char* directory, const char* name)
+{
+    // A name may come with its directory, which is stripped so that both forms share a handle. The name is hashed
+    // without it; the directory is only prepended on the first, resolving, call
+    size_t directoryLength = strlen(directory);
+    if (!strncmp(name, directory, directoryLength))
+        name += directoryLength;
+    StringHash nameHash(name);
+    HashMap<StringHash, unsigned>::ConstIterator i = handles.Find(nameHash);
+    if (i != handles.End())
+        return i->second_;
+
+    // Materials go through the texture streamer when there is one, so they do not wait for their textures
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    TextureStreamer* streamer = GetSubsystem<TextureStreamer>();
+    String fullName = String(directory) + name;
+    unsigned handle = resources.Size();
+    if (streamer && type == Material::GetTypeStatic())
+        resources.Push(SharedPtr<Resource>(streamer->GetMaterial(fullName)));
+    else
+        resources.Push(SharedPtr<Resource>(cache->GetResource(type, fullName)));
+    names.Push(fullName);
+    handles[nameHash] = handle;
+    return handle;
+}
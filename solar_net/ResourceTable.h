@@ -0,0 +1,97 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+
+namespace Urho3D
+{
+
+class Material;
+class Model;
+class Resource;
+
+}
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+/// Name-interned table of the models and materials used by scene objects.
+/// A name is resolved through the resource cache once, the first time it is interned, and gets a small integer handle.
+/// Later interning of the same name costs one hash of the short name as given (without its directory) and a lookup in
+/// a small map, with no string formatting and no cache access; objects created from handles skip even that. A name
+/// that fails to load keeps its handle with a null resource, so it is not retried and logged for every object.
+class ResourceTable : public Object
+{
+    URHO3D_OBJECT(ResourceTable, Object);
+
+public:
+    /// Construct.
+    ResourceTable(Context* context);
+    /// Destruct.
+    virtual ~ResourceTable();
+
+    /// Return handle of a model given its name relative to the Models directory, or starting with it, loading it on
+    /// first use.
+    unsigned InternModel(const char* name);
+    /// Return handle of a material given its name relative to the Materials directory, or starting with it, loading
+    /// it on first use.
+    unsigned InternMaterial(const char* name);
+    /// Release all resources. Previous handles become invalid.
+    void Clear();
+
+    /// Return model by handle, or null if the handle is invalid or the model failed to load.
+    Model* GetModel(unsigned handle) const;
+    /// Return material by handle, or null if the handle is invalid or the material failed to load.
+    Material* GetMaterial(unsigned handle) const;
+    /// Return model name by handle, with its directory, even if the model failed to load. Empty if the handle is
+    /// invalid.
+    const String& GetModelName(unsigned handle) const;
+    /// Return material name by handle, with its directory, even if the material failed to load. Empty if the handle
+    /// is invalid.
+    const String& GetMaterialName(unsigned handle) const;
+    /// Return number of interned models.
+    unsigned GetNumModels() const { return models_.Size(); }
+    /// Return number of interned materials.
+    unsigned GetNumMaterials() const { return materials_.Size(); }
+
+private:
+    /// Intern a name in one of the tables.
+    unsigned Intern(Vector<SharedPtr<Resource> >& resources, Vector<String>& names,
+        HashMap<StringHash, unsigned>& handles, StringHash type, const char* directory, const char* name);
+
+    /// Models by handle.
+    Vector<SharedPtr<Resource> > models_;
+    /// Materials by handle.
+    Vector<SharedPtr<Resource> > materials_;
+    /// Model names by handle.
+    Vector<String> modelNames_;
+    /// Material names by handle.
+    Vector<String> materialNames_;
+    /// Model handles by name hash.
+    HashMap<StringHash, unsigned> modelHandles_;
+    /// Material handles by name hash.
+    HashMap<StringHash, unsigned> materialHandles_;
+};
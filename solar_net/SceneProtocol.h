@@ -0,0 +1,76 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+// Binary scene command protocol, shared by the scene server and its clients, so it depends on no engine header.
+//
+// A message of ID MSG_SCENE starts with the protocol version byte, followed by any number of commands up to its end.
+// A command is the opcode byte, then the fields of the opcode in this order, without padding:
+//     SCENE_CREATE_OBJECT           name, position, scale, rotation, model, material
+//     SCENE_CREATE_OBJECT_AT_POINT  name, point name, scale, rotation, model, material
+//     SCENE_CREATE_POINT            name, position
+//     SCENE_MOVE_OBJECT_TO_POINT    name, point name
+// Names are null-terminated and have no length limit. Positions and scales are three little-endian 32-bit floats,
+// rotations three such floats of Euler angles in degrees, as in the text commands. Models and materials are
+// resource names, with or without their Models/ or Materials/ directory; the sender picks the material shown.
+// The server reads every field in place from the received buffer. Messages of another version are dropped, and so is
+// the rest of a message after a command that cannot be decoded.
+//
+// Text commands (MSG_GAME) are batched the same way: one command per line, as many lines as fit the budget.
+//
+// The authoritative instance sends render nodes its simulation state after each frame in which its clock ticked or
+// seeked. Each MSG_STATE message is one unreliable datagram: the state version byte, the 32-bit tick, the clock state
+// written by SimulationClock, then, if there are particles, one chunk of their positions written by NBodySystem.
+// Chunks take turns within a budget of messages per tick. Orbits and spins are not sent, as render nodes evaluate
+// them at the replicated time. A MSG_FULL_STATE message goes reliably to a render node when it connects, and to all
+// of them when the particles change: the state version byte, the number of orbits, which must match the render
+// node's catalog, then the particle positions and velocities written by NBodySystem. To a connecting render node, the
+// content created by commands follows, replacing whatever it held: the points (name, position), the objects as they
+// are now (name, position, scale, rotation as a quaternion, model, material) and the belts (body count as a VLE, inner
+// and outer radius as doubles, eccentricity and inclination as floats, 32-bit seed), each list after its VLE count.
+// Commands creating belts are passed on with every argument and the seed written out. Render nodes skip states older
+// than those applied.
+
+/// Message ID of binary scene commands.
+const int MSG_SCENE = 33;
+/// Binary scene command layout version. Bump on any change of the opcodes or their fields.
+const unsigned char SCENE_PROTOCOL_VERSION = 2;
+/// Message ID of simulation states, sent to render nodes.
+const int MSG_STATE = 34;
+/// Message ID of simulation states with the particle velocities, sent reliably to render nodes.
+const int MSG_FULL_STATE = 35;
+/// Simulation state layout version. Bump on any change of the fields written by the systems.
+const unsigned char STATE_PROTOCOL_VERSION = 3;
+/// Size budget of a message of batched commands, in bytes: about what one datagram carries, so that a batch is not
+/// split across datagrams. A single longer command is still sent, alone.
+const unsigned COMMAND_BATCH_SIZE = 1200;
+
+/// Binary scene command opcodes.
+enum SceneOpcode
+{
+    SCENE_CREATE_OBJECT = 1,
+    SCENE_CREATE_OBJECT_AT_POINT,
+    SCENE_CREATE_POINT,
+    SCENE_MOVE_OBJECT_TO_POINT
+};
@@ -0,0 +1,448 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Graphics/Material.h>
+#include <Urho3D/Graphics/Model.h>
+#include <Urho3D/Graphics/StaticModel.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "MappedFile.h"
+#include "NBodySystem.h"
+#include "OrbitSystem.h"
+#include "SceneSnapshot.h"
+#include "TextureStreamer.h"
+
+#include <cstring>
+
+#include <Urho3D/DebugNew.h>
+
+/// Snapshot file identifier.
+static const char* SNAPSHOT_ID = "SSNP";
+/// Snapshot format version. Bump whenever a record layout changes.
+static const unsigned SNAPSHOT_VERSION = 1;
+
+/// Return offset of a string in a deduplicated string table, appending it if new.
+static unsigned AddString(PODVector<char>& strings, HashMap<String, unsigned>& offsets, const String& str)
+{
+    HashMap<String, unsigned>::ConstIterator i = offsets.Find(str);
+    if (i != offsets.End())
+        return i->second_;
+
+    unsigned offset = strings.Size();
+    strings.Resize(offset + str.Length() + 1);
+    memcpy(&strings[offset], str.CString(), str.Length() + 1);
+    offsets[str] = offset;
+    return offset;
+}
+
+/// Return index of a resource name, appending it if new.
+static unsigned AddResource(PODVector<unsigned>& resources, PODVector<char>& strings,
+    HashMap<String, unsigned>& offsets, HashMap<String, unsigned>& indices, const String& name)
+{
+    HashMap<String, unsigned>::ConstIterator i = indices.Find(name);
+    if (i != indices.End())
+        return i->second_;
+
+    unsigned index = resources.Size();
+    resources.Push(AddString(strings, offsets, name));
+    indices[name] = index;
+    return index;
+}
+
+SceneSnapshot::SceneSnapshot(Context* context) :
+    Object(context),
+    header_(0),
+    orbits_(0),
+    attractors_(0),
+    nodes_(0),
+    spins_(0),
+    models_(0),
+    resources_(0),
+    strings_(0),
+    sourceTime_(0),
+    loadTime_(0),
+    instantiateTime_(0)
+{
+}
+
+SceneSnapshot::~SceneSnapshot()
+{
+}
+
+bool SceneSnapshot::Save(Scene* scene, const String& fileName)
+{
+    if (!scene)
+    {
+        URHO3D_LOGERROR("Null scene for snapshot");
+        return false;
+    }
+
+    PODVector<SnapshotNode> nodes;
+    PODVector<SnapshotModel> models;
+    PODVector<SnapshotOrbit> orbits;
+    PODVector<SnapshotSpin> spins;
+    PODVector<SnapshotAttractor> attractors;
+    PODVector<unsigned> resources;
+    PODVector<char> strings;
+    HashMap<String, unsigned> stringOffsets;
+    HashMap<String, unsigned> resourceIndices;
+    HashMap<Node*, unsigned> nodeIndices;
+
+    // Breadth first, so that instantiation can create every node under an already created parent
+    PODVector<Node*> sceneNodes;
+    const Vector<SharedPtr<Node> >& rootChildren = scene->GetChildren();
+    for (unsigned i = 0; i < rootChildren.Size(); ++i)
+        sceneNodes.Push(rootChildren[i]);
+    PODVector<StaticModel*> staticModels;
+
+    for (unsigned i = 0; i < sceneNodes.Size(); ++i)
+    {
+        Node* node = sceneNodes[i];
+        nodeIndices[node] = i;
+
+        const Vector<SharedPtr<Node> >& children = node->GetChildren();
+        for (unsigned j = 0; j < children.Size(); ++j)
+            sceneNodes.Push(children[j]);
+
+        SnapshotNode record;
+        record.parent_ = node->GetParent() == scene ? M_MAX_UNSIGNED : nodeIndices[node->GetParent()];
+        record.name_ = AddString(strings, stringOffsets, node->GetName());
+        const Vector3& position = node->GetPosition();
+        const Quaternion& rotation = node->GetRotation();
+        const Vector3& scale = node->GetScale();
+        record.position_[0] = position.x_;
+        record.position_[1] = position.y_;
+        record.position_[2] = position.z_;
+        record.rotation_[0] = rotation.w_;
+        record.rotation_[1] = rotation.x_;
+        record.rotation_[2] = rotation.y_;
+        record.rotation_[3] = rotation.z_;
+        record.scale_[0] = scale.x_;
+        record.scale_[1] = scale.y_;
+        record.scale_[2] = scale.z_;
+        nodes.Push(record);
+
+        node->GetComponents<StaticModel>(staticModels);
+        for (unsigned j = 0; j < staticModels.Size(); ++j)
+        {
+            StaticModel* staticModel = staticModels[j];
+            if (!staticModel->GetModel())
+                continue;
+
+            SnapshotModel modelRecord;
+            modelRecord.node_ = i;
+            modelRecord.model_ = AddResource(resources, strings, stringOffsets, resourceIndices,
+                staticModel->GetModel()->GetName());
+            Material* material = staticModel->GetMaterial(0);
+            modelRecord.material_ = material ? AddResource(resources, strings, stringOffsets, resourceIndices,
+                material->GetName()) : M_MAX_UNSIGNED;
+            models.Push(modelRecord);
+        }
+    }
+
+    OrbitSystem* orbitSystem = scene->GetComponent<OrbitSystem>();
+    if (orbitSystem)
+    {
+        // Spinning nodes are saved in their J2000 orientation, which becomes their base rotation again on load
+        for (unsigned i = 0; i < orbitSystem->GetNumSpins(); ++i)
+        {
+            HashMap<Node*, unsigned>::ConstIterator node = nodeIndices.Find(orbitSystem->GetSpinNode(i));
+            if (node == nodeIndices.End())
+                continue;
+
+            const Quaternion& rotation = orbitSystem->GetBaseRotation(i);
+            SnapshotNode& record = nodes[node->second_];
+            record.rotation_[0] = rotation.w_;
+            record.rotation_[1] = rotation.x_;
+            record.rotation_[2] = rotation.y_;
+            record.rotation_[3] = rotation.z_;
+
+            if (!orbitSystem->IsSpinLinked(i))
+            {
+                const Vector3& angularSpeed = orbitSystem->GetAngularSpeed(i);
+                SnapshotSpin spin;
+                spin.node_ = node->second_;
+                spin.angularSpeed_[0] = angularSpeed.x_;
+                spin.angularSpeed_[1] = angularSpeed.y_;
+                spin.angularSpeed_[2] = angularSpeed.z_;
+                spins.Push(spin);
+            }
+        }
+
+        // Orbits keep their indices, which parent orbits and attractors refer to
+        for (unsigned i = 0; i < orbitSystem->GetNumOrbits(); ++i)
+        {
+            HashMap<Node*, unsigned>::ConstIterator node = nodeIndices.Find(orbitSystem->GetOrbitNode(i));
+            unsigned spin = orbitSystem->GetOrbitSpin(i);
+            Vector3 angularSpeed = spin != M_MAX_UNSIGNED ? orbitSystem->GetAngularSpeed(spin) : Vector3::ZERO;
+
+            SnapshotOrbit orbit;
+            orbit.basis_ = orbitSystem->GetOrbit(i);
+            orbit.node_ = node != nodeIndices.End() ? node->second_ : M_MAX_UNSIGNED;
+            orbit.parentOrbit_ = orbitSystem->GetParentOrbit(i);
+            orbit.angularSpeed_[0] = angularSpeed.x_;
+            orbit.angularSpeed_[1] = angularSpeed.y_;
+            orbit.angularSpeed_[2] = angularSpeed.z_;
+            orbit.spinning_ = spin != M_MAX_UNSIGNED ? 1 : 0;
+            orbits.Push(orbit);
+        }
+    }
+
+    NBodySystem* nbodySystem = scene->GetComponent<NBodySystem>();
+    if (nbodySystem)
+    {
+        for (unsigned i = 0; i < nbodySystem->GetNumAttractors(); ++i)
+        {
+            SnapshotAttractor attractor;
+            attractor.gravitationalParameter_ = nbodySystem->GetAttractor(i).gravitationalParameter_;
+            attractor.orbit_ = nbodySystem->GetAttractor(i).orbit_;
+            attractor.padding_ = 0;
+            attractors.Push(attractor);
+        }
+    }
+
+    SnapshotHeader header;
+    memcpy(header.id_, SNAPSHOT_ID, sizeof header.id_);
+    header.version_ = SNAPSHOT_VERSION;
+    header.sourceTime_ = sourceTime_;
+    header.numOrbits_ = orbits.Size();
+    header.numAttractors_ = attractors.Size();
+    header.numNodes_ = nodes.Size();
+    header.numSpins_ = spins.Size();
+    header.numModels_ = models.Size();
+    header.numResources_ = resources.Size();
+    header.stringsSize_ = strings.Size();
+
+    File file(context_);
+    if (!file.Open(fileName, FILE_WRITE))
+        return false;
+
+    file.Write(&header, sizeof header);
+    file.Write(orbits.Buffer(), orbits.Size() * sizeof(SnapshotOrbit));
+    file.Write(attractors.Buffer(), attractors.Size() * sizeof(SnapshotAttractor));
+    file.Write(nodes.Buffer(), nodes.Size() * sizeof(SnapshotNode));
+    file.Write(spins.Buffer(), spins.Size() * sizeof(SnapshotSpin));
+    file.Write(models.Buffer(), models.Size() * sizeof(SnapshotModel));
+    file.Write(resources.Buffer(), resources.Size() * sizeof(unsigned));
+    file.Write(strings.Buffer(), strings.Size());
+
+    URHO3D_LOGINFOF("Saved snapshot of %u nodes to %s", nodes.Size(), fileName.CString());
+    return true;
+}
+
+bool SceneSnapshot::Load(const String& fileName)
+{
+    Close();
+
+    HiresTimer timer;
+
+    SharedPtr<MappedFile> file(new MappedFile());
+    if (!file->Open(fileName))
+        return false;
+
+    const unsigned char* data = file->GetData();
+    unsigned size = file->GetSize();
+    const SnapshotHeader* header = (const SnapshotHeader*)data;
+    if (size < sizeof(SnapshotHeader) || memcmp(header->id_, SNAPSHOT_ID, sizeof header->id_) ||
+        header->version_ != SNAPSHOT_VERSION)
+    {
+        URHO3D_LOGERROR(fileName + " is not a valid snapshot");
+        return false;
+    }
+
+    unsigned long long expectedSize = sizeof(SnapshotHeader) +
+        (unsigned long long)header->numOrbits_ * sizeof(SnapshotOrbit) +
+        (unsigned long long)header->numAttractors_ * sizeof(SnapshotAttractor) +
+        (unsigned long long)header->numNodes_ * sizeof(SnapshotNode) +
+        (unsigned long long)header->numSpins_ * sizeof(SnapshotSpin) +
+        (unsigned long long)header->numModels_ * sizeof(SnapshotModel) +
+        (unsigned long long)header->numResources_ * sizeof(unsigned) + header->stringsSize_;
+    if (expectedSize != size || (header->stringsSize_ && data[size - 1]))
+    {
+        URHO3D_LOGERROR("Snapshot " + fileName + " is truncated or corrupt");
+        return false;
+    }
+
+    const unsigned char* position = data + sizeof(SnapshotHeader);
+    const SnapshotOrbit* orbits = (const SnapshotOrbit*)position;
+    position += header->numOrbits_ * sizeof(SnapshotOrbit);
+    const SnapshotAttractor* attractors = (const SnapshotAttractor*)position;
+    position += header->numAttractors_ * sizeof(SnapshotAttractor);
+    const SnapshotNode* nodes = (const SnapshotNode*)position;
+    position += header->numNodes_ * sizeof(SnapshotNode);
+    const SnapshotSpin* spins = (const SnapshotSpin*)position;
+    position += header->numSpins_ * sizeof(SnapshotSpin);
+    const SnapshotModel* models = (const SnapshotModel*)position;
+    position += header->numModels_ * sizeof(SnapshotModel);
+    const unsigned* resources = (const unsigned*)position;
+    position += header->numResources_ * sizeof(unsigned);
+
+    // Every index is checked here once, so that instantiation can trust the records
+    bool valid = true;
+    for (unsigned i = 0; i < header->numNodes_ && valid; ++i)
+        valid = (nodes[i].parent_ == M_MAX_UNSIGNED || nodes[i].parent_ < i) && nodes[i].name_ < header->stringsSize_;
+    for (unsigned i = 0; i < header->numModels_ && valid; ++i)
+    {
+        valid = models[i].node_ < header->numNodes_ && models[i].model_ < header->numResources_ &&
+            (models[i].material_ == M_MAX_UNSIGNED || models[i].material_ < header->numResources_);
+    }
+    for (unsigned i = 0; i < header->numOrbits_ && valid; ++i)
+    {
+        valid = (orbits[i].node_ == M_MAX_UNSIGNED || orbits[i].node_ < header->numNodes_) &&
+            (orbits[i].parentOrbit_ == M_MAX_UNSIGNED || orbits[i].parentOrbit_ < i);
+    }
+    for (unsigned i = 0; i < header->numSpins_ && valid; ++i)
+        valid = spins[i].node_ < header->numNodes_;
+    for (unsigned i = 0; i < header->numAttractors_ && valid; ++i)
+        valid = attractors[i].orbit_ == M_MAX_UNSIGNED || attractors[i].orbit_ < header->numOrbits_;
+    for (unsigned i = 0; i < header->numResources_ && valid; ++i)
+        valid = resources[i] < header->stringsSize_;
+    if (!valid)
+    {
+        URHO3D_LOGERROR("Snapshot " + fileName + " has invalid references");
+        return false;
+    }
+
+    file_ = file;
+    header_ = header;
+    orbits_ = orbits;
+    attractors_ = attractors;
+    nodes_ = nodes;
+    spins_ = spins;
+    models_ = models;
+    resources_ = resources;
+    strings_ = (const char*)position;
+    sourceTime_ = header->sourceTime_;
+
+    loadTime_ = timer.GetUSec(false);
+    return true;
+}
+
+bool SceneSnapshot::Instantiate(Scene* scene)
+{
+    if (!header_)
+    {
+        URHO3D_LOGERROR("No snapshot loaded");
+        return false;
+    }
+
+    OrbitSystem* orbitSystem = scene ? scene->GetComponent<OrbitSystem>() : 0;
+    if (!orbitSystem)
+    {
+        URHO3D_LOGERROR("Snapshot instantiation requires an OrbitSystem in the scene");
+        return false;
+    }
+
+    HiresTimer timer;
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    TextureStreamer* streamer = GetSubsystem<TextureStreamer>();
+
+    PODVector<Node*> nodes(header_->numNodes_);
+    for (unsigned i = 0; i < header_->numNodes_; ++i)
+    {
+        const SnapshotNode& record = nodes_[i];
+        Node* parent = record.parent_ != M_MAX_UNSIGNED ? nodes[record.parent_] : scene;
+        Node* node = parent->CreateChild(String(strings_ + record.name_));
+        node->SetTransform(Vector3(record.position_), Quaternion(record.rotation_[0], record.rotation_[1],
+            record.rotation_[2], record.rotation_[3]), Vector3(record.scale_));
+        nodes[i] = node;
+    }
+
+    // Resources are resolved on first use, so each distinct name costs one cache lookup
+    PODVector<Model*> models(header_->numResources_);
+    PODVector<Material*> materials(header_->numResources_);
+    for (unsigned i = 0; i < header_->numResources_; ++i)
+    {
+        models[i] = 0;
+        materials[i] = 0;
+    }
+
+    for (unsigned i = 0; i < header_->numModels_; ++i)
+    {
+        const SnapshotModel& record = models_[i];
+        if (!models[record.model_])
+            models[record.model_] = cache->GetResource<Model>(String(strings_ + resources_[record.model_]));
+        StaticModel* staticModel = nodes[record.node_]->CreateComponent<StaticModel>();
+        staticModel->SetModel(models[record.model_]);
+
+        if (record.material_ != M_MAX_UNSIGNED)
+        {
+            if (!materials[record.material_])
+            {
+                String materialName(strings_ + resources_[record.material_]);
+                materials[record.material_] = streamer ? streamer->GetMaterial(materialName) :
+                    cache->GetResource<Material>(materialName);
+            }
+            staticModel->SetMaterial(materials[record.material_]);
+        }
+    }
+
+    // Orbits go first so that their spins are linked directly; nodes are already in their base orientation
+    unsigned firstOrbit = orbitSystem->GetNumOrbits();
+    for (unsigned i = 0; i < header_->numOrbits_; ++i)
+    {
+        const SnapshotOrbit& record = orbits_[i];
+        Node* node = record.node_ != M_MAX_UNSIGNED ? nodes[record.node_] : 0;
+        unsigned parentOrbit = record.parentOrbit_ != M_MAX_UNSIGNED ? firstOrbit + record.parentOrbit_ :
+            M_MAX_UNSIGNED;
+        if (record.spinning_)
+            orbitSystem->AddBody(node, record.basis_, Vector3(record.angularSpeed_), parentOrbit);
+        else
+            orbitSystem->AddOrbit(node, record.basis_, parentOrbit);
+    }
+    for (unsigned i = 0; i < header_->numSpins_; ++i)
+        orbitSystem->AddSpin(nodes[spins_[i].node_], Vector3(spins_[i].angularSpeed_));
+
+    NBodySystem* nbodySystem = scene->GetComponent<NBodySystem>();
+    if (nbodySystem)
+    {
+        for (unsigned i = 0; i < header_->numAttractors_; ++i)
+        {
+            const SnapshotAttractor& record = attractors_[i];
+            nbodySystem->AddAttractor(record.gravitationalParameter_,
+                record.orbit_ != M_MAX_UNSIGNED ? firstOrbit + record.orbit_ : M_MAX_UNSIGNED);
+        }
+    }
+
+    instantiateTime_ = timer.GetUSec(false);
+    URHO3D_LOGINFOF("Instantiated snapshot of %u nodes in %d us", header_->numNodes_, (int)instantiateTime_);
+    return true;
+}
+
+void SceneSnapshot::Close()
+{
+    file_.Reset();
+    header_ = 0;
+    orbits_ = 0;
+    attractors_ = 0;
+    nodes_ = 0;
+    spins_ = 0;
+    models_ = 0;
+    resources_ = 0;
+    strings_ = 0;
+}
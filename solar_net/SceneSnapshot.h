@@ -0,0 +1,189 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+
+#include "Ephemeris.h"
+
+namespace Urho3D
+{
+
+class Scene;
+
+}
+
+class MappedFile;
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+/// Snapshot file header. The record arrays follow in declaration order of the counts, then the resource name offsets
+/// and the string table. Orbit and attractor records come first so that their doubles stay 8-byte aligned.
+struct SnapshotHeader
+{
+    /// File identifier.
+    char id_[4];
+    /// Format version.
+    unsigned version_;
+    /// Modification time of the source the snapshot was built from, to detect stale snapshots.
+    unsigned sourceTime_;
+    /// Number of orbits.
+    unsigned numOrbits_;
+    /// Number of attractors.
+    unsigned numAttractors_;
+    /// Number of nodes.
+    unsigned numNodes_;
+    /// Number of spins not carried by an orbit.
+    unsigned numSpins_;
+    /// Number of static models.
+    unsigned numModels_;
+    /// Number of resource names.
+    unsigned numResources_;
+    /// Size of the string table in bytes.
+    unsigned stringsSize_;
+};
+
+/// Snapshot orbit, with the spin of its node if any.
+struct SnapshotOrbit
+{
+    /// Evaluation basis, used as is.
+    OrbitBasis basis_;
+    /// Node index, or M_MAX_UNSIGNED.
+    unsigned node_;
+    /// Parent orbit index, or M_MAX_UNSIGNED.
+    unsigned parentOrbit_;
+    /// Angular speed of the node's spin in degrees per second.
+    float angularSpeed_[3];
+    /// Nonzero if the node spins.
+    unsigned spinning_;
+};
+
+/// Snapshot N-body attractor.
+struct SnapshotAttractor
+{
+    /// Gravitational parameter in world units cubed per second squared.
+    double gravitationalParameter_;
+    /// Orbit index, or M_MAX_UNSIGNED.
+    unsigned orbit_;
+    /// Padding to 8 bytes.
+    unsigned padding_;
+};
+
+/// Snapshot node. Nodes are stored breadth first, so a parent always precedes its children.
+struct SnapshotNode
+{
+    /// Parent node index, or M_MAX_UNSIGNED for a child of the scene.
+    unsigned parent_;
+    /// Name offset in the string table.
+    unsigned name_;
+    /// Position.
+    float position_[3];
+    /// Rotation as w, x, y, z. For spinning nodes this is the rotation at J2000.
+    float rotation_[4];
+    /// Scale.
+    float scale_[3];
+};
+
+/// Snapshot spin of a node without an orbit.
+struct SnapshotSpin
+{
+    /// Node index.
+    unsigned node_;
+    /// Angular speed in degrees per second.
+    float angularSpeed_[3];
+};
+
+/// Snapshot static model component.
+struct SnapshotModel
+{
+    /// Node index.
+    unsigned node_;
+    /// Model resource name index.
+    unsigned model_;
+    /// Material resource name index, or M_MAX_UNSIGNED.
+    unsigned material_;
+};
+
+/// Binary snapshot of the scene content: the node hierarchy with its transforms, the static models with their resource
+/// names, the OrbitSystem bodies and the NBodySystem attractors. The file is memory-mapped and its fixed-size records
+/// are instantiated in place after a single validation pass, with no parsing, and each distinct resource is looked up
+/// once. Scene-level components and other component types are left to the code that creates the scene.
+class SceneSnapshot : public Object
+{
+    URHO3D_OBJECT(SceneSnapshot, Object);
+
+public:
+    /// Construct.
+    SceneSnapshot(Context* context);
+    /// Destruct.
+    virtual ~SceneSnapshot();
+
+    /// Write the content of a scene to a snapshot file. Return true if successful.
+    bool Save(Scene* scene, const String& fileName);
+    /// Map and validate a snapshot file. Return true if successful.
+    bool Load(const String& fileName);
+    /// Create the content of the loaded snapshot in a scene, which must have an OrbitSystem. Return true if successful.
+    bool Instantiate(Scene* scene);
+    /// Unmap the loaded snapshot.
+    void Close();
+
+    /// Set source modification time written by Save().
+    void SetSourceTime(unsigned time) { sourceTime_ = time; }
+
+    /// Return source modification time of the loaded snapshot, or the one set for saving.
+    unsigned GetSourceTime() const { return sourceTime_; }
+    /// Return number of nodes of the loaded snapshot.
+    unsigned GetNumNodes() const { return header_ ? header_->numNodes_ : 0; }
+    /// Return duration of the last load in microseconds.
+    long long GetLoadTime() const { return loadTime_; }
+    /// Return duration of the last instantiation in microseconds.
+    long long GetInstantiateTime() const { return instantiateTime_; }
+
+private:
+    /// Mapped snapshot file.
+    SharedPtr<MappedFile> file_;
+    /// Header of the loaded snapshot.
+    const SnapshotHeader* header_;
+    /// Orbit records.
+    const SnapshotOrbit* orbits_;
+    /// Attractor records.
+    const SnapshotAttractor* attractors_;
+    /// Node records.
+    const SnapshotNode* nodes_;
+    /// Spin records.
+    const SnapshotSpin* spins_;
+    /// Static model records.
+    const SnapshotModel* models_;
+    /// Resource name offsets.
+    const unsigned* resources_;
+    /// String table.
+    const char* strings_;
+    /// Source modification time.
+    unsigned sourceTime_;
+    /// Duration of the last load.
+    long long loadTime_;
+    /// Duration of the last instantiation.
+    long long instantiateTime_;
+};
@@ -0,0 +1,365 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/IO/Deserializer.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/IO/Serializer.h>
+
+#include "Ephemeris.h"
+#include "SimulationClock.h"
+
+#include <math.h>
+#include <time.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include <Urho3D/DebugNew.h>
+
+/// Default simulated seconds per real second: one day per second.
+static const double DEFAULT_SIMULATION_RATE = SECONDS_PER_DAY;
+/// Julian date of the J2000 epoch (2000-01-01 12:00).
+static const double J2000_JULIAN_DATE = 2451545.0;
+/// Unix time of the J2000 epoch.
+static const double J2000_UNIX_TIME = 946728000.0;
+/// Default tick length in real seconds.
+static const float DEFAULT_TICK_LENGTH = 1.0f / 60.0f;
+/// Maximum ticks run in one frame. Ticks due beyond are caught up over the following frames.
+static const unsigned MAX_TICKS_PER_FRAME = 8;
+/// Real seconds the ticks may fall behind before the time missed is dropped, such as after a stall or a scene load.
+static const double MAX_TICK_LAG = 2.0;
+
+/// Return monotonic real time in microseconds. Unlike the engine timers it does not follow system clock changes.
+static long long GetMonotonicUSec()
+{
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return counter.QuadPart / frequency.QuadPart * 1000000LL +
+        counter.QuadPart % frequency.QuadPart * 1000000LL / frequency.QuadPart;
+#else
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000LL + now.tv_nsec / 1000;
+#endif
+}
+
+/// Return number of days in a month of the proleptic Gregorian calendar.
+static int GetDaysInMonth(int year, int month)
+{
+    static const int DAYS_IN_MONTH[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    bool leapYear = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    return month == 2 && leapYear ? 29 : DAYS_IN_MONTH[month - 1];
+}
+
+SimulationClock::SimulationClock(Context* context) :
+    Object(context),
+    time_(0.0),
+    previousTime_(0.0),
+    anchorTime_(0.0),
+    rate_(DEFAULT_SIMULATION_RATE),
+    baseRealTime_(-1),
+    tickLength_(DEFAULT_TICK_LENGTH),
+    interpolation_(0.0f),
+    tick_(0),
+    anchorTick_(0),
+    baseTick_(0),
+    numSeeks_(0),
+    stateTicks_(1),
+    paused_(false),
+    replicated_(false),
+    stateRead_(false)
+{
+    SubscribeToEvent(E_BEGINFRAME, URHO3D_HANDLER(SimulationClock, HandleBeginFrame));
+}
+
+SimulationClock::~SimulationClock()
+{
+}
+
+void SimulationClock::SetTime(double time)
+{
+    if (!isfinite(time))
+    {
+        URHO3D_LOGERROR("Invalid simulation time ignored");
+        return;
+    }
+
+    time_ = time;
+    previousTime_ = time;
+    SetAnchor();
+    ++numSeeks_;
+    SendSeek();
+}
+
+bool SimulationClock::SeekDate(int year, int month, int day, int hour, int minute, double second)
+{
+    // UTC is taken without leap seconds, as TimeToDate() returns it
+    if (month < 1 || month > 12 || day < 1 || day > GetDaysInMonth(year, month) || hour < 0 || hour > 23 ||
+        minute < 0 || minute > 59 || !isfinite(second) || second < 0.0 || second >= 60.0)
+    {
+        URHO3D_LOGERRORF("Invalid simulation date %04d-%02d-%02d %02d:%02d:%06.3f", year, month, day, hour, minute, second);
+        return false;
+    }
+
+    SetTime(DateToTime(year, month, day, hour, minute, second));
+    return true;
+}
+
+void SimulationClock::SeekNow()
+{
+    SetTime((double)time(0) - J2000_UNIX_TIME);
+}
+
+void SimulationClock::SetRate(double rate)
+{
+    // Clamp() would pass NaN through and leave every orbit at NaN until the next seek
+    if (!isfinite(rate))
+    {
+        URHO3D_LOGERROR("Invalid simulation rate ignored");
+        return;
+    }
+
+    // Takes effect from the next tick on
+    SetAnchor();
+    rate_ = Clamp(rate, -MAX_SIMULATION_RATE, MAX_SIMULATION_RATE);
+}
+
+void SimulationClock::Reverse()
+{
+    SetRate(-rate_);
+}
+
+void SimulationClock::SetPaused(bool paused)
+{
+    if (paused == paused_)
+        return;
+
+    SetAnchor();
+    paused_ = paused;
+    ResetTickBase();
+}
+
+void SimulationClock::SetTickLength(float tickLength)
+{
+    SetAnchor();
+    tickLength_ = Max(tickLength, M_EPSILON);
+    ResetTickBase();
+}
+
+void SimulationClock::Advance()
+{
+    if (paused_)
+    {
+        previousTime_ = time_;
+        interpolation_ = 0.0f;
+        return;
+    }
+
+    // Start counting at the first frame, not when the subsystem was created before the scene was loaded
+    if (baseRealTime_ < 0)
+        ResetTickBase();
+
+    long long now = GetMonotonicUSec();
+    if (GetRealTimeSinceBase(now) - (double)(tick_ - baseTick_) * tickLength_ > MAX_TICK_LAG)
+    {
+        URHO3D_LOGWARNING("Simulation ticks fell too far behind real time, dropping the time missed");
+        ResetTickBase();
+    }
+
+    // Count the ticks due from real time rather than from the engine's time step, which is smoothed and clamped.
+    // A pause or tick length change from a tick handler moves the base and ends the loop
+    unsigned numTicks = 0;
+    while (!paused_ && numTicks < MAX_TICKS_PER_FRAME &&
+        GetRealTimeSinceBase(now) >= (double)(tick_ - baseTick_ + 1) * tickLength_)
+    {
+        Tick();
+        ++numTicks;
+    }
+
+    if (!paused_)
+        interpolation_ = (float)Clamp(GetRealTimeSinceBase(now) / tickLength_ - (double)(tick_ - baseTick_), 0.0, 1.0);
+}
+
+void SimulationClock::SetReplicated(bool enable)
+{
+    if (enable == replicated_)
+        return;
+
+    // Either way, carry on from the time shown now: local ticks resume from the last replicated state
+    replicated_ = enable;
+    stateRead_ = false;
+    time_ = GetRenderTime();
+    previousTime_ = time_;
+    interpolation_ = 0.0f;
+    SetAnchor();
+    ResetTickBase();
+}
+
+void SimulationClock::WriteState(Serializer& dest) const
+{
+    dest.WriteDouble(time_);
+    dest.WriteDouble(rate_);
+    dest.WriteFloat(tickLength_);
+    dest.WriteBool(paused_);
+    dest.WriteVLE(numSeeks_);
+}
+
+void SimulationClock::ReadState(Deserializer& source, unsigned tick)
+{
+    double time = source.ReadDouble();
+    double rate = source.ReadDouble();
+    float tickLength = source.ReadFloat();
+    bool paused = source.ReadBool();
+    unsigned numSeeks = source.ReadVLE();
+
+    // States may arrive out of order, and a seek while paused comes without a new tick. The particles of one tick
+    // may span several states, each repeating the clock
+    if (stateRead_ && (int)(numSeeks - numSeeks_) <= 0 && (numSeeks != numSeeks_ || (int)(tick - tick_) <= 0))
+        return;
+
+    // Show the source's tick times one state late, moving from the time shown now towards the new one
+    bool seek = !stateRead_ || numSeeks != numSeeks_;
+    stateTicks_ = seek ? 1 : Clamp(tick - tick_, 1U, MAX_TICKS_PER_FRAME);
+    previousTime_ = seek ? time : GetRenderTime();
+    time_ = time;
+    tick_ = tick;
+    rate_ = rate;
+    tickLength_ = Max(tickLength, M_EPSILON);
+    paused_ = paused;
+    numSeeks_ = numSeeks;
+    stateRead_ = true;
+    interpolation_ = 0.0f;
+    SetAnchor();
+    ResetTickBase();
+
+    if (seek)
+        SendSeek();
+}
+
+void SimulationClock::SetAnchor()
+{
+    anchorTime_ = time_;
+    anchorTick_ = tick_;
+}
+
+void SimulationClock::ResetTickBase()
+{
+    baseRealTime_ = GetMonotonicUSec();
+    baseTick_ = tick_;
+}
+
+double SimulationClock::GetRealTimeSinceBase(long long now) const
+{
+    return (double)(now - baseRealTime_) * 1e-6;
+}
+
+void SimulationClock::Tick()
+{
+    ++tick_;
+    previousTime_ = time_;
+    // Multiply out from the anchor rather than summing steps, so no rounding error builds up
+    time_ = anchorTime_ + (double)(tick_ - anchorTick_) * ((double)tickLength_ * rate_);
+
+    using namespace SimulationTick;
+
+    VariantMap& eventData = GetEventDataMap();
+    eventData[P_TICK] = tick_;
+    eventData[P_TIME] = time_;
+    eventData[P_TIMESTEP] = time_ - previousTime_;
+    SendEvent(E_SIMULATIONTICK, eventData);
+}
+
+void SimulationClock::SendSeek()
+{
+    using namespace SimulationSeek;
+
+    VariantMap& eventData = GetEventDataMap();
+    eventData[P_TIME] = time_;
+    SendEvent(E_SIMULATIONSEEK, eventData);
+}
+
+CalendarDate SimulationClock::GetDate() const
+{
+    return TimeToDate(time_);
+}
+
+double SimulationClock::DateToTime(int year, int month, int day, int hour, int minute, double second)
+{
+    // Meeus, Astronomical Algorithms, chapter 7. UTC is used as the time scale; the ~1 minute offset to TT is below
+    // what the scene can show
+    if (month <= 2)
+    {
+        year -= 1;
+        month += 12;
+    }
+
+    int century = (int)floor(year / 100.0);
+    int gregorian = 2 - century + (int)floor(century / 4.0);
+    double julianDay = floor(365.25 * (year + 4716)) + floor(30.6001 * (month + 1)) + day + gregorian - 1524.5;
+
+    return (julianDay - J2000_JULIAN_DATE) * SECONDS_PER_DAY + hour * 3600.0 + minute * 60.0 + second;
+}
+
+CalendarDate SimulationClock::TimeToDate(double time)
+{
+    double julianDate = time / SECONDS_PER_DAY + J2000_JULIAN_DATE + 0.5;
+    double z = floor(julianDate);
+    double dayFraction = julianDate - z;
+
+    double alpha = floor((z - 1867216.25) / 36524.25);
+    double a = z + 1.0 + alpha - floor(alpha / 4.0);
+    double b = a + 1524.0;
+    double c = floor((b - 122.1) / 365.25);
+    double d = floor(365.25 * c);
+    double e = floor((b - d) / 30.6001);
+
+    CalendarDate date;
+    date.day_ = (int)(b - d - floor(30.6001 * e));
+    date.month_ = (int)(e < 14.0 ? e - 1.0 : e - 13.0);
+    date.year_ = (int)(date.month_ > 2 ? c - 4716.0 : c - 4715.0);
+
+    double seconds = dayFraction * SECONDS_PER_DAY;
+    date.hour_ = Min((int)(seconds / 3600.0), 23);
+    seconds -= date.hour_ * 3600.0;
+    date.minute_ = Min((int)(seconds / 60.0), 59);
+    date.second_ = seconds - date.minute_ * 60.0;
+
+    return date;
+}
+
+void SimulationClock::HandleBeginFrame(StringHash eventType, VariantMap& eventData)
+{
+    using namespace BeginFrame;
+
+    if (!replicated_)
+        Advance();
+    else if (stateRead_)
+    {
+        // A replica reaches the last state read after as long as the source took for its ticks, then waits there
+        interpolation_ = (float)Min(GetRealTimeSinceBase(GetMonotonicUSec()) / ((double)tickLength_ * stateTicks_),
+            1.0);
+    }
+}
@@ -0,0 +1,188 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+
+namespace Urho3D
+{
+
+class Deserializer;
+class Serializer;
+
+}
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+/// Simulation time jumped to a new value. Listeners should re-evaluate their state at the new time.
+URHO3D_EVENT(E_SIMULATIONSEEK, SimulationSeek)
+{
+    URHO3D_PARAM(P_TIME, Time);                 // double, seconds since J2000
+}
+
+/// Simulation advanced by one fixed tick. Stateful simulations should step here rather than on the frame time step.
+URHO3D_EVENT(E_SIMULATIONTICK, SimulationTick)
+{
+    URHO3D_PARAM(P_TICK, Tick);                 // unsigned, ticks since the clock was created
+    URHO3D_PARAM(P_TIME, Time);                 // double, seconds since J2000
+    URHO3D_PARAM(P_TIMESTEP, TimeStep);         // double, simulated seconds since the previous tick
+}
+
+/// Largest allowed simulation rate magnitude, in simulated seconds per real second.
+static const double MAX_SIMULATION_RATE = 1e7;
+
+/// Calendar date and time of day (UTC, proleptic Gregorian calendar).
+struct CalendarDate
+{
+    /// Year.
+    int year_;
+    /// Month, 1-12.
+    int month_;
+    /// Day of month, 1-31.
+    int day_;
+    /// Hour, 0-23.
+    int hour_;
+    /// Minute, 0-59.
+    int minute_;
+    /// Second, [0, 60).
+    double second_;
+};
+
+/// Global simulation clock subsystem. Simulation time is counted in seconds since the J2000 epoch and advances at a
+/// signed rate (negative plays backwards) independent of any scene component, so that warping time never touches the
+/// bodies themselves: they read the clock when they evaluate.
+/// Time advances on a fixed real-time tick, not on the variable frame time step. Ticks are counted from a monotonic
+/// wall clock, slow frames catching up over the next ones, so the tick count only follows real time. The time at a
+/// tick is computed from the tick count since the last seek or rate change rather than accumulated, so it only
+/// depends on the seek and rate commands and the ticks they landed on: instances running at different frame rates
+/// produce bit-identical states. Rendering uses GetRenderTime(), interpolated between the last two ticks.
+/// A replicated clock does not advance by itself: it shows the time of the last state read from an authoritative
+/// instance, and resumes ticking from there when replication ends.
+class SimulationClock : public Object
+{
+    URHO3D_OBJECT(SimulationClock, Object);
+
+public:
+    /// Construct.
+    SimulationClock(Context* context);
+    /// Destruct.
+    virtual ~SimulationClock();
+
+    /// Set simulation time in seconds since J2000. Sends E_SIMULATIONSEEK. A NaN or infinite time is ignored.
+    void SetTime(double time);
+    /// Seek to a calendar date (UTC), second in [0, 60). Sends E_SIMULATIONSEEK. Return false if the date is invalid,
+    /// such as a day past the end of its month.
+    bool SeekDate(int year, int month, int day, int hour = 0, int minute = 0, double second = 0.0);
+    /// Seek to the current system date and time.
+    void SeekNow();
+    /// Set simulated seconds per real second, clamped to +/-MAX_SIMULATION_RATE. Negative rates play backwards. A NaN
+    /// or infinite rate is ignored.
+    void SetRate(double rate);
+    /// Reverse playback direction.
+    void Reverse();
+    /// Set paused.
+    void SetPaused(bool paused);
+    /// Set tick length in real seconds.
+    void SetTickLength(float tickLength);
+    /// Run the ticks due by now on the monotonic wall clock, at most a few per call. Called at the start of each frame.
+    void Advance();
+    /// Set replicated. A replicated clock only moves through ReadState().
+    void SetReplicated(bool enable);
+    /// Write time of the last tick, rate, tick length, pause and seek count for a replica.
+    void WriteState(Serializer& dest) const;
+    /// Read state written by WriteState() at a tick of the source on a replicated clock, which then interpolates from
+    /// the time shown towards it over the ticks in between. States older than the last one read are skipped. Sends
+    /// E_SIMULATIONSEEK on the first state and whenever the source has seeked since.
+    void ReadState(Deserializer& source, unsigned tick);
+
+    /// Return simulation time at the last tick in seconds since J2000.
+    double GetTime() const { return time_; }
+    /// Return simulation time to display, interpolated between the last two ticks.
+    double GetRenderTime() const { return previousTime_ + (time_ - previousTime_) * interpolation_; }
+    /// Return interpolation factor of the render time between the last two ticks, in [0, 1].
+    float GetInterpolation() const { return interpolation_; }
+    /// Return number of ticks run.
+    unsigned GetTick() const { return tick_; }
+    /// Return tick length in real seconds.
+    float GetTickLength() const { return tickLength_; }
+    /// Return simulated seconds per real second.
+    double GetRate() const { return rate_; }
+    /// Return whether paused.
+    bool IsPaused() const { return paused_; }
+    /// Return whether replicated.
+    bool IsReplicated() const { return replicated_; }
+    /// Return current simulation date (UTC).
+    CalendarDate GetDate() const;
+
+    /// Convert a calendar date (UTC) to seconds since J2000.
+    static double DateToTime(int year, int month, int day, int hour, int minute, double second);
+    /// Convert seconds since J2000 to a calendar date (UTC).
+    static CalendarDate TimeToDate(double time);
+
+private:
+    /// Handle frame begin event.
+    void HandleBeginFrame(StringHash eventType, VariantMap& eventData);
+    /// Restart counting ticks from the current time.
+    void SetAnchor();
+    /// Restart counting due ticks from the current tick and real time.
+    void ResetTickBase();
+    /// Return real seconds from the tick base to a monotonic time in microseconds.
+    double GetRealTimeSinceBase(long long now) const;
+    /// Run one tick.
+    void Tick();
+    /// Send the seek event for the current time.
+    void SendSeek();
+
+    /// Simulation time at the last tick in seconds since J2000.
+    double time_;
+    /// Simulation time at the tick before.
+    double previousTime_;
+    /// Simulation time at the anchor tick.
+    double anchorTime_;
+    /// Simulated seconds per real second.
+    double rate_;
+    /// Monotonic real time in microseconds of the tick base, or of the last state read on a replica.
+    long long baseRealTime_;
+    /// Tick length in real seconds.
+    float tickLength_;
+    /// Render time interpolation factor.
+    float interpolation_;
+    /// Ticks run.
+    unsigned tick_;
+    /// Tick of the last seek or rate change.
+    unsigned anchorTick_;
+    /// Tick run at the tick base, from which due ticks are counted.
+    unsigned baseTick_;
+    /// Number of seeks, so that a replica can tell a jump from a tick.
+    unsigned numSeeks_;
+    /// Ticks between the last two states read by a replica.
+    unsigned stateTicks_;
+    /// Paused flag.
+    bool paused_;
+    /// Replicated flag.
+    bool replicated_;
+    /// Whether a state was read since the clock became replicated.
+    bool stateRead_;
+};
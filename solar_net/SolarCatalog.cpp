@@ -0,0 +1,236 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Graphics/Material.h>
+#include <Urho3D/Graphics/Model.h>
+#include <Urho3D/Graphics/StaticModel.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Resource/XMLFile.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "OrbitSystem.h"
+#include "SolarCatalog.h"
+#include "TextureStreamer.h"
+
+#include <Urho3D/DebugNew.h>
+
+/// Catalog gravitational parameters are in km^3/s^2, world units are thousands of km.
+static const double GRAVITATIONAL_PARAMETER_SCALE = 1.0e-9;
+
+SolarCatalog::SolarCatalog(Context* context) :
+    Object(context),
+    loadTime_(0),
+    instantiateTime_(0)
+{
+}
+
+SolarCatalog::~SolarCatalog()
+{
+}
+
+bool SolarCatalog::Load(XMLFile* file)
+{
+    if (!file)
+    {
+        URHO3D_LOGERROR("Null catalog file");
+        return false;
+    }
+
+    return LoadXML(file->GetRoot());
+}
+
+bool SolarCatalog::LoadXML(const XMLElement& source)
+{
+    if (source.GetName() != "catalog")
+    {
+        URHO3D_LOGERROR("Catalog root element is not a catalog");
+        return false;
+    }
+
+    HiresTimer timer;
+
+    bodies_.Clear();
+    models_.Clear();
+    nodes_.Clear();
+    orbits_.Clear();
+
+    for (XMLElement bodyElem = source.GetChild("body"); bodyElem; bodyElem = bodyElem.GetNext("body"))
+        LoadBody(bodyElem, M_MAX_UNSIGNED);
+
+    loadTime_ = timer.GetUSec(false);
+    URHO3D_LOGINFOF("Loaded %u catalog bodies in %d us", bodies_.Size(), (int)loadTime_);
+    return true;
+}
+
+void SolarCatalog::LoadBody(const XMLElement& source, unsigned parent)
+{
+    // Bodies are appended before their satellites so that instantiation always finds the parent already created
+    unsigned index = bodies_.Size();
+    bodies_.Resize(index + 1);
+    CatalogBody& body = bodies_[index];
+
+    body.name_ = source.GetAttribute("name");
+    body.parent_ = parent;
+    body.scale_ = source.HasAttribute("scale") ? source.GetFloat("scale") : 1.0f;
+    body.tilt_ = source.GetFloat("tilt");
+    body.rotationPeriod_ = ToDouble(source.GetAttribute("rotationPeriod"));
+    body.gravitationalParameter_ = ToDouble(source.GetAttribute("gravitationalParameter")) *
+        GRAVITATIONAL_PARAMETER_SCALE;
+
+    XMLElement orbitElem = source.GetChild("orbit");
+    body.hasOrbit_ = orbitElem.NotNull();
+    if (body.hasOrbit_)
+    {
+        body.elements_ = OrbitalElements(
+            ToDouble(orbitElem.GetAttribute("semiMajorAxis")) * UNITS_PER_AU,
+            ToDouble(orbitElem.GetAttribute("eccentricity")),
+            ToDouble(orbitElem.GetAttribute("inclination")),
+            ToDouble(orbitElem.GetAttribute("ascendingNode")),
+            ToDouble(orbitElem.GetAttribute("argumentOfPeriapsis")),
+            ToDouble(orbitElem.GetAttribute("meanAnomaly")),
+            ToDouble(orbitElem.GetAttribute("period")));
+    }
+
+    body.firstModel_ = models_.Size();
+    for (XMLElement modelElem = source.GetChild("model"); modelElem; modelElem = modelElem.GetNext("model"))
+    {
+        CatalogModel model;
+        model.model_ = modelElem.GetAttribute("file");
+        model.material_ = modelElem.GetAttribute("material");
+        model.scale_ = Vector3::ONE;
+        models_.Push(model);
+    }
+    for (XMLElement attachElem = source.GetChild("attachment"); attachElem;
+         attachElem = attachElem.GetNext("attachment"))
+    {
+        CatalogModel model;
+        model.name_ = attachElem.GetAttribute("name");
+        model.model_ = attachElem.GetAttribute("model");
+        model.material_ = attachElem.GetAttribute("material");
+        model.scale_ = attachElem.HasAttribute("scale") ? attachElem.GetVector3("scale") : Vector3::ONE;
+        models_.Push(model);
+    }
+    body.numModels_ = models_.Size() - body.firstModel_;
+
+    // The reference may have been invalidated by the satellites growing the array, so it is not used past this point
+    for (XMLElement childElem = source.GetChild("body"); childElem; childElem = childElem.GetNext("body"))
+        LoadBody(childElem, index);
+}
+
+void SolarCatalog::Instantiate(Scene* scene, Node* worldRoot)
+{
+    if (!scene || !worldRoot)
+    {
+        URHO3D_LOGERROR("Null scene or world root for catalog instantiation");
+        return;
+    }
+
+    OrbitSystem* orbitSystem = scene->GetComponent<OrbitSystem>();
+    if (!orbitSystem)
+    {
+        URHO3D_LOGERROR("Catalog instantiation requires an OrbitSystem in the scene");
+        return;
+    }
+
+    HiresTimer timer;
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    TextureStreamer* streamer = GetSubsystem<TextureStreamer>();
+
+    // Most bodies share the same mesh and many share materials, so every distinct resource is looked up only once
+    HashMap<String, SharedPtr<Model> > models;
+    HashMap<String, SharedPtr<Material> > materials;
+    for (unsigned i = 0; i < models_.Size(); ++i)
+    {
+        const CatalogModel& entry = models_[i];
+        if (!models.Contains(entry.model_))
+            models[entry.model_] = cache->GetResource<Model>(entry.model_);
+        if (!entry.material_.Empty() && !materials.Contains(entry.material_))
+        {
+            materials[entry.material_] = streamer ? streamer->GetMaterial(entry.material_) :
+                cache->GetResource<Material>(entry.material_);
+        }
+    }
+
+    nodes_.Resize(bodies_.Size());
+    orbits_.Resize(bodies_.Size());
+
+    for (unsigned i = 0; i < bodies_.Size(); ++i)
+    {
+        const CatalogBody& body = bodies_[i];
+
+        // Orbiting bodies are direct children of the scene so that their positions stay in double precision until the
+        // floating origin is subtracted; the others are placed in world coordinates below the world root
+        Node* node = body.hasOrbit_ ? scene->CreateChild(body.name_) : worldRoot->CreateChild(body.name_);
+        node->SetRotation(Quaternion(0.0f, 0.0f, body.tilt_));
+        node->SetScale(body.scale_);
+        nodes_[i] = node;
+
+        Vector3 angularSpeed(0.0f, body.rotationPeriod_ > 0.0 ? GetRotationSpeed(body.rotationPeriod_) : 0.0f, 0.0f);
+        if (body.hasOrbit_)
+        {
+            unsigned parentOrbit = body.parent_ != M_MAX_UNSIGNED ? orbits_[body.parent_] : M_MAX_UNSIGNED;
+            if (body.rotationPeriod_ > 0.0)
+                orbits_[i] = orbitSystem->AddBody(node, body.elements_, angularSpeed, parentOrbit);
+            else
+                orbits_[i] = orbitSystem->AddOrbit(node, body.elements_, parentOrbit);
+        }
+        else
+        {
+            orbits_[i] = M_MAX_UNSIGNED;
+            if (body.rotationPeriod_ > 0.0)
+                orbitSystem->AddSpin(node, angularSpeed);
+        }
+
+        for (unsigned j = body.firstModel_; j < body.firstModel_ + body.numModels_; ++j)
+        {
+            const CatalogModel& entry = models_[j];
+            Node* modelNode = node;
+            if (!entry.name_.Empty())
+            {
+                modelNode = node->CreateChild(entry.name_);
+                modelNode->SetScale(entry.scale_);
+            }
+            StaticModel* object = modelNode->CreateComponent<StaticModel>();
+            object->SetModel(models[entry.model_]);
+            if (!entry.material_.Empty())
+                object->SetMaterial(materials[entry.material_]);
+        }
+    }
+
+    instantiateTime_ = timer.GetUSec(false);
+    URHO3D_LOGINFOF("Instantiated %u catalog bodies in %d us", bodies_.Size(), (int)instantiateTime_);
+}
+
+unsigned SolarCatalog::FindBody(const String& name) const
+{
+    for (unsigned i = 0; i < bodies_.Size(); ++i)
+    {
+        if (bodies_[i].name_ == name)
+            return i;
+    }
+
+    return M_MAX_UNSIGNED;
+}
@@ -0,0 +1,132 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Scene/Node.h>
+
+#include "Ephemeris.h"
+
+namespace Urho3D
+{
+
+class Scene;
+class XMLElement;
+class XMLFile;
+
+}
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+/// Model shown by a catalog body, either on the body node itself or on an attached child node.
+struct CatalogModel
+{
+    /// Attached child node name, empty for a model on the body node.
+    String name_;
+    /// Model resource name.
+    String model_;
+    /// Material resource name.
+    String material_;
+    /// Attached child node scale, relative to the body.
+    Vector3 scale_;
+};
+
+/// Body read from a catalog. Bodies are stored parents first.
+struct CatalogBody
+{
+    /// Node name.
+    String name_;
+    /// Parent body index, or M_MAX_UNSIGNED for a root body.
+    unsigned parent_;
+    /// Orbital elements, semi-major axis in scene units.
+    OrbitalElements elements_;
+    /// Body moves on an orbit. Without one it stays at the world origin.
+    bool hasOrbit_;
+    /// Uniform node scale.
+    float scale_;
+    /// Axial tilt in degrees about the Z axis.
+    float tilt_;
+    /// Sidereal rotation period in hours, zero for no spin.
+    double rotationPeriod_;
+    /// Gravitational parameter in world units cubed per second squared, zero if the body does not attract particles.
+    double gravitationalParameter_;
+    /// First model index.
+    unsigned firstModel_;
+    /// Number of models.
+    unsigned numModels_;
+};
+
+/// Solar system catalog: bodies, their hierarchy, orbits and assets read from an XML file and instantiated into a
+/// scene. Parsing only fills flat arrays; instantiation then resolves every distinct resource once and creates all
+/// nodes in a single pass, orbits and spins going to the scene's OrbitSystem. Both steps are timed.
+class SolarCatalog : public Object
+{
+    URHO3D_OBJECT(SolarCatalog, Object);
+
+public:
+    /// Construct.
+    SolarCatalog(Context* context);
+    /// Destruct.
+    virtual ~SolarCatalog();
+
+    /// Read bodies from a catalog file. Return true if successful.
+    bool Load(XMLFile* file);
+    /// Read bodies from a catalog root element. Return true if successful.
+    bool LoadXML(const XMLElement& source);
+    /// Create the body nodes. Orbiting bodies become children of the scene, fixed ones children of the world root.
+    void Instantiate(Scene* scene, Node* worldRoot);
+
+    /// Return number of bodies.
+    unsigned GetNumBodies() const { return bodies_.Size(); }
+    /// Return body.
+    const CatalogBody& GetBody(unsigned index) const { return bodies_[index]; }
+    /// Return index of a body by name, or M_MAX_UNSIGNED if not found.
+    unsigned FindBody(const String& name) const;
+    /// Return node of an instantiated body.
+    Node* GetNode(unsigned index) const { return index < nodes_.Size() ? nodes_[index].Get() : (Node*)0; }
+    /// Return OrbitSystem orbit index of an instantiated body, or M_MAX_UNSIGNED if it does not orbit.
+    unsigned GetOrbit(unsigned index) const { return index < orbits_.Size() ? orbits_[index] : M_MAX_UNSIGNED; }
+    /// Return duration of the last load in microseconds.
+    long long GetLoadTime() const { return loadTime_; }
+    /// Return duration of the last instantiation in microseconds.
+    long long GetInstantiateTime() const { return instantiateTime_; }
+
+private:
+    /// Read a body element and its satellites.
+    void LoadBody(const XMLElement& source, unsigned parent);
+
+    /// Bodies.
+    Vector<CatalogBody> bodies_;
+    /// Models of all bodies.
+    Vector<CatalogModel> models_;
+    /// Instantiated body nodes.
+    Vector<WeakPtr<Node> > nodes_;
+    /// Orbit indices of the instantiated bodies.
+    PODVector<unsigned> orbits_;
+    /// Duration of the last load.
+    long long loadTime_;
+    /// Duration of the last instantiation.
+    long long instantiateTime_;
+};
@@ -0,0 +1,293 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/Thread.h>
+#include <Urho3D/Graphics/Camera.h>
+#include <Urho3D/Graphics/Geometry.h>
+#include <Urho3D/Graphics/Material.h>
+#include <Urho3D/Graphics/VertexBuffer.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Scene/Node.h>
+
+#include "StarField.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <Urho3D/DebugNew.h>
+
+/// Star catalog file identifier.
+static const char* STAR_CATALOG_ID = "STAR";
+/// Default distance of the stars from the camera.
+static const float DEFAULT_RADIUS = 1000.0f;
+/// Default limiting magnitude at zoom 1, the naked eye limit under a dark sky.
+static const float DEFAULT_MAGNITUDE_LIMIT = 6.5f;
+/// Magnitude shown at full brightness.
+static const float BRIGHTEST_MAGNITUDE = -1.5f;
+/// Magnitude shown at the dimmest brightness.
+static const float FAINTEST_MAGNITUDE = 10.0f;
+/// Brightness of the faintest stars.
+static const float FAINTEST_BRIGHTNESS = 0.15f;
+/// Number of records read by the loader at a time.
+static const unsigned LOAD_BLOCK_SIZE = 4096;
+/// Floats per vertex: position and packed color.
+static const unsigned FLOATS_PER_VERTEX = 4;
+
+/// Number of B-V color index samples.
+static const unsigned NUM_COLOR_SAMPLES = 6;
+/// B-V color index samples, from hot blue to cool red stars.
+static const float COLOR_INDICES[NUM_COLOR_SAMPLES] = { -0.4f, 0.0f, 0.4f, 0.8f, 1.4f, 2.0f };
+/// Star colors at the color index samples.
+static const Color STAR_COLORS[NUM_COLOR_SAMPLES] = {
+    Color(0.61f, 0.71f, 1.0f),
+    Color(0.80f, 0.85f, 1.0f),
+    Color(1.0f, 0.97f, 0.93f),
+    Color(1.0f, 0.89f, 0.74f),
+    Color(1.0f, 0.74f, 0.50f),
+    Color(1.0f, 0.60f, 0.35f)
+};
+
+static Color GetStarColor(float colorIndex, float magnitude)
+{
+    unsigned i = 1;
+    while (i < NUM_COLOR_SAMPLES - 1 && colorIndex > COLOR_INDICES[i])
+        ++i;
+    float t = Clamp((colorIndex - COLOR_INDICES[i - 1]) / (COLOR_INDICES[i] - COLOR_INDICES[i - 1]), 0.0f, 1.0f);
+
+    float brightness = Lerp(1.0f, FAINTEST_BRIGHTNESS,
+        Clamp((magnitude - BRIGHTEST_MAGNITUDE) / (FAINTEST_MAGNITUDE - BRIGHTEST_MAGNITUDE), 0.0f, 1.0f));
+    return STAR_COLORS[i - 1].Lerp(STAR_COLORS[i], t) * brightness;
+}
+
+/// Background thread reading a star catalog in blocks.
+class StarFieldLoader : public Thread, public RefCounted
+{
+public:
+    /// Construct.
+    StarFieldLoader(StarField* owner, File* file, unsigned numStars) :
+        owner_(owner),
+        file_(file),
+        numStars_(numStars)
+    {
+    }
+
+    /// Read and convert the records until done or stopped.
+    virtual void ThreadFunction()
+    {
+        PODVector<StarCatalogRecord> records(LOAD_BLOCK_SIZE);
+        unsigned numLoaded = 0;
+        while (shouldRun_ && numLoaded < numStars_)
+        {
+            unsigned count = Min(numStars_ - numLoaded, LOAD_BLOCK_SIZE);
+            if (file_->Read(&records[0], count * sizeof(StarCatalogRecord)) != count * sizeof(StarCatalogRecord))
+            {
+                URHO3D_LOGERROR("Star catalog " + file_->GetName() + " is truncated");
+                break;
+            }
+
+            owner_->ConvertStars(&records[0], numLoaded, count);
+            numLoaded += count;
+            owner_->SetNumLoadedStars(numLoaded);
+        }
+
+        file_->Close();
+    }
+
+private:
+    /// Star field being filled.
+    StarField* owner_;
+    /// Catalog file, positioned at the first record.
+    SharedPtr<File> file_;
+    /// Number of stars to read.
+    unsigned numStars_;
+};
+
+StarField::StarField(Context* context) :
+    Drawable(context, DRAWABLE_GEOMETRY),
+    geometry_(new Geometry(context)),
+    vertexBuffer_(new VertexBuffer(context_)),
+    numLoaded_(0),
+    numUploaded_(0),
+    numVisible_(0),
+    drawCount_(0),
+    radius_(DEFAULT_RADIUS),
+    magnitudeLimit_(DEFAULT_MAGNITUDE_LIMIT)
+{
+    geometry_->SetVertexBuffer(0, vertexBuffer_, MASK_POSITION | MASK_COLOR);
+
+    batches_.Resize(1);
+    batches_[0].geometry_ = geometry_;
+    batches_[0].worldTransform_ = &transform_;
+}
+
+StarField::~StarField()
+{
+    StopLoading();
+}
+
+void StarField::RegisterObject(Context* context)
+{
+    context->RegisterFactory<StarField>();
+}
+
+void StarField::UpdateBatches(const FrameInfo& frame)
+{
+    // The stars are at infinity: they move with the camera and only its orientation shows them differently. The
+    // vertices are unit directions, scaled out to the star distance here
+    transform_ = Matrix3x4(frame.camera_->GetNode()->GetWorldPosition(), Quaternion::IDENTITY, radius_);
+    distance_ = radius_;
+    batches_[0].distance_ = distance_;
+
+    // Zooming by a factor k shows the sky like a telescope k times wider would, which reaches 5 log10 k magnitudes
+    // deeper. The catalog is sorted, so the visible stars are a prefix of it
+    float limit = magnitudeLimit_ + 5.0f * log10f(Max(frame.camera_->GetZoom(), 1.0f));
+    unsigned numLoaded = GetNumLoadedStars();
+    const float* magnitudes = magnitudes_.Buffer();
+    numVisible_ = (unsigned)(std::upper_bound(magnitudes, magnitudes + numLoaded, limit) - magnitudes);
+}
+
+void StarField::UpdateGeometry(const FrameInfo& frame)
+{
+    if (vertexBuffer_->IsDataLost())
+    {
+        vertexBuffer_->ClearDataLost();
+        numUploaded_ = 0;
+    }
+
+    unsigned numLoaded = GetNumLoadedStars();
+    if (numLoaded > numUploaded_)
+    {
+        vertexBuffer_->SetDataRange(&vertexData_[numUploaded_ * FLOATS_PER_VERTEX], numUploaded_,
+            numLoaded - numUploaded_);
+        numUploaded_ = numLoaded;
+    }
+
+    drawCount_ = Min(numVisible_, numUploaded_);
+    geometry_->SetDrawRange(POINT_LIST, 0, 0, 0, drawCount_);
+}
+
+UpdateGeometryType StarField::GetUpdateGeometryType()
+{
+    return GetNumLoadedStars() > numUploaded_ || Min(numVisible_, numUploaded_) != drawCount_ ||
+        vertexBuffer_->IsDataLost() ? UPDATE_MAIN_THREAD : UPDATE_NONE;
+}
+
+bool StarField::Load(const String& resourceName)
+{
+    StopLoading();
+
+    SharedPtr<File> file = GetSubsystem<ResourceCache>()->GetFile(resourceName);
+    if (!file)
+        return false;
+
+    StarCatalogHeader header;
+    if (file->Read(&header, sizeof header) != sizeof header || memcmp(header.id_, STAR_CATALOG_ID, sizeof header.id_) ||
+        file->GetSize() < sizeof header + (unsigned long long)header.numStars_ * sizeof(StarCatalogRecord))
+    {
+        URHO3D_LOGERROR(resourceName + " is not a valid star catalog");
+        return false;
+    }
+
+    // Everything is allocated up front, so the loader only fills memory that never moves
+    vertexData_.Resize(header.numStars_ * FLOATS_PER_VERTEX);
+    magnitudes_.Resize(header.numStars_);
+    vertexBuffer_->SetSize(header.numStars_, MASK_POSITION | MASK_COLOR, true);
+    geometry_->SetDrawRange(POINT_LIST, 0, 0, 0, 0);
+    numUploaded_ = 0;
+    numVisible_ = 0;
+    drawCount_ = 0;
+
+    loader_ = new StarFieldLoader(this, file, header.numStars_);
+    loader_->Run();
+    OnMarkedDirty(node_);
+    return true;
+}
+
+void StarField::SetMaterial(Material* material)
+{
+    batches_[0].material_ = material;
+}
+
+void StarField::SetRadius(float radius)
+{
+    radius_ = Max(radius, M_EPSILON);
+}
+
+void StarField::SetMagnitudeLimit(float magnitude)
+{
+    magnitudeLimit_ = magnitude;
+}
+
+Material* StarField::GetMaterial() const
+{
+    return batches_[0].material_;
+}
+
+unsigned StarField::GetNumLoadedStars() const
+{
+    MutexLock lock(loadMutex_);
+    return numLoaded_;
+}
+
+void StarField::ConvertStars(const StarCatalogRecord* records, unsigned start, unsigned count)
+{
+    for (unsigned i = 0; i < count; ++i)
+    {
+        const StarCatalogRecord& record = records[i];
+        unsigned color = GetStarColor(record.colorIndex_, record.magnitude_).ToUInt();
+
+        float* dest = &vertexData_[(start + i) * FLOATS_PER_VERTEX];
+        dest[0] = record.direction_[0];
+        dest[1] = record.direction_[1];
+        dest[2] = record.direction_[2];
+        memcpy(&dest[3], &color, sizeof color);
+        magnitudes_[start + i] = record.magnitude_;
+    }
+}
+
+void StarField::SetNumLoadedStars(unsigned count)
+{
+    MutexLock lock(loadMutex_);
+    numLoaded_ = count;
+}
+
+void StarField::OnWorldBoundingBoxUpdate()
+{
+    // The stars surround the camera wherever it is, so they are always potentially visible
+    worldBoundingBox_ = BoundingBox(-M_LARGE_VALUE, M_LARGE_VALUE);
+}
+
+void StarField::StopLoading()
+{
+    if (loader_)
+    {
+        loader_->Stop();
+        loader_.Reset();
+    }
+
+    MutexLock lock(loadMutex_);
+    numLoaded_ = 0;
+}
@@ -0,0 +1,148 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <Urho3D/Core/Mutex.h>
+#include <Urho3D/Graphics/Drawable.h>
+
+namespace Urho3D
+{
+
+class File;
+class Geometry;
+class VertexBuffer;
+
+}
+
+class StarFieldLoader;
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+/// Star catalog file header, followed by the star records sorted from brightest to faintest.
+struct StarCatalogHeader
+{
+    /// File identifier.
+    char id_[4];
+    /// Number of stars.
+    unsigned numStars_;
+};
+
+/// Star catalog record.
+struct StarCatalogRecord
+{
+    /// Unit direction in scene axes.
+    float direction_[3];
+    /// Apparent visual magnitude.
+    float magnitude_;
+    /// B-V color index.
+    float colorIndex_;
+};
+
+/// Drawable showing the stars of a binary catalog as a point cloud at a fixed distance around the camera.
+/// All stars live in one vertex buffer in catalog order, brightest first, so culling by magnitude is just a shorter
+/// draw range. The limiting magnitude grows with the camera zoom, revealing fainter stars as the view narrows. The
+/// catalog is read by a background thread in blocks; each frame the main thread uploads whatever arrived since, so the
+/// brightest stars show at once and startup never waits for the whole catalog.
+class StarField : public Drawable
+{
+    URHO3D_OBJECT(StarField, Drawable);
+
+public:
+    /// Construct.
+    StarField(Context* context);
+    /// Destruct. Stop loading.
+    virtual ~StarField();
+    /// Register object factory.
+    static void RegisterObject(Context* context);
+
+    /// Follow the camera and pick the stars above the limiting magnitude.
+    virtual void UpdateBatches(const FrameInfo& frame);
+    /// Upload newly loaded stars and apply the draw range.
+    virtual void UpdateGeometry(const FrameInfo& frame);
+    /// Return whether a geometry update is necessary, and if it can happen in a worker thread.
+    virtual UpdateGeometryType GetUpdateGeometryType();
+
+    /// Start streaming a star catalog resource. Return true if its header is valid.
+    bool Load(const String& resourceName);
+    /// Set material. It should use vertex colors.
+    void SetMaterial(Material* material);
+    /// Set distance of the stars from the camera. It must stay within the camera far clip.
+    void SetRadius(float radius);
+    /// Set limiting magnitude at zoom 1.
+    void SetMagnitudeLimit(float magnitude);
+
+    /// Return material.
+    Material* GetMaterial() const;
+    /// Return distance of the stars from the camera.
+    float GetRadius() const { return radius_; }
+    /// Return limiting magnitude at zoom 1.
+    float GetMagnitudeLimit() const { return magnitudeLimit_; }
+    /// Return number of stars in the catalog.
+    unsigned GetNumStars() const { return magnitudes_.Size(); }
+    /// Return number of stars loaded so far.
+    unsigned GetNumLoadedStars() const;
+    /// Return number of stars drawn in the last view.
+    unsigned GetNumVisibleStars() const { return numVisible_; }
+
+    /// Convert a block of records to vertices. Called from the loader thread.
+    void ConvertStars(const StarCatalogRecord* records, unsigned start, unsigned count);
+    /// Publish stars converted by the loader thread.
+    void SetNumLoadedStars(unsigned count);
+
+protected:
+    /// Recalculate the world-space bounding box.
+    virtual void OnWorldBoundingBoxUpdate();
+
+private:
+    /// Stop the loader thread.
+    void StopLoading();
+
+    /// Geometry.
+    SharedPtr<Geometry> geometry_;
+    /// Vertex buffer.
+    SharedPtr<VertexBuffer> vertexBuffer_;
+    /// Loader thread.
+    SharedPtr<StarFieldLoader> loader_;
+    /// Vertex data of the whole catalog, filled by the loader.
+    PODVector<float> vertexData_;
+    /// Star magnitudes in catalog order, filled by the loader.
+    PODVector<float> magnitudes_;
+    /// Guards the loaded star count.
+    mutable Mutex loadMutex_;
+    /// Number of stars converted by the loader.
+    unsigned numLoaded_;
+    /// Number of stars uploaded to the vertex buffer.
+    unsigned numUploaded_;
+    /// Number of stars to draw.
+    unsigned numVisible_;
+    /// Number of stars in the current draw range.
+    unsigned drawCount_;
+    /// World transform placing the stars around the camera.
+    Matrix3x4 transform_;
+    /// Distance of the stars from the camera.
+    float radius_;
+    /// Limiting magnitude at zoom 1.
+    float magnitudeLimit_;
+};
@@ -21,7 +21,10 @@
 //
 
 #include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Engine/DebugHud.h>
 #include <Urho3D/Engine/Engine.h>
+#include <Urho3D/Graphics/BillboardSet.h>
 #include <Urho3D/Graphics/Camera.h>
 #include <Urho3D/Graphics/Graphics.h>
 #include <Urho3D/Graphics/Material.h>
@@ -29,41 +32,148 @@
 #include <Urho3D/Graphics/Octree.h>
 #include <Urho3D/Graphics/Renderer.h>
 #include <Urho3D/Graphics/StaticModel.h>
+#include <Urho3D/Graphics/Zone.h>
 #include <Urho3D/Input/Input.h>
 #include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Resource/XMLFile.h>
 #include <Urho3D/Scene/Scene.h>
 #include <Urho3D/UI/Font.h>
 #include <Urho3D/UI/Text.h>
 #include <Urho3D/UI/UI.h>
 
+#include <Urho3D/IO/FileSystem.h>
 #include <Urho3D/IO/MemoryBuffer.h>
 #include <Urho3D/IO/Log.h>
+#include <Urho3D/IO/VectorBuffer.h>
 #include <Urho3D/Network/Connection.h>
 #include <Urho3D/Network/Network.h>
 #include <Urho3D/Network/NetworkEvents.h>
 
 #include "StaticScene.h"
-#include "Rotator.h"
+#include "AsteroidBelt.h"
+#include "AtlasBatch.h"
+#include "CommandParser.h"
+#include "BodyImpostors.h"
+#include "FloatingOrigin.h"
+#include "Icosphere.h"
+#include "NBodySystem.h"
+#include "OrbitSystem.h"
+#include "OrbitTrails.h"
+#include "ResourceTable.h"
+#include "SceneProtocol.h"
+#include "SceneSnapshot.h"
+#include "SimulationClock.h"
+#include "SolarCatalog.h"
+#include "StarField.h"
+#include "TextureStreamer.h"
 
 #include <Urho3D/DebugNew.h>
 
 const int MSG_GAME = 32;
 const unsigned short GAME_SERVER_PORT = 32000;
+/// Identity key set by the instances connecting to the authoritative one as render nodes.
+const char* RENDER_NODE_IDENTITY = "RenderNode";
+/// Delay between attempts of a render node to reach the authoritative instance, in milliseconds.
+const unsigned AUTHORITY_RECONNECT_INTERVAL = 2000;
+/// Most state messages sent per tick, each with one chunk of particle positions: about 1 MB/s per render node.
+const unsigned MAX_STATE_CHUNKS_PER_TICK = 16;
+/// Half size of the octree around the floating origin, in thousands of km.
+const float OCTREE_SIZE = 65536.0f;
+/// Camera far clip distance, in thousands of km. Covers the whole system out to Pluto's aphelion.
+const float CAMERA_FAR_CLIP = 1.0e7f;
+/// Camera vertical field of view, in degrees.
+const float CAMERA_FOV = 45.0f;
+/// Displayed size of debris field particles, in thousands of km.
+const float DEBRIS_SIZE = 200.0f;
+/// Color of the heliocentric orbit paths.
+const Color ORBIT_PATH_COLOR(0.2f, 0.3f, 0.5f);
+/// Color of the body trails.
+const Color TRAIL_COLOR(0.6f, 0.8f, 1.0f);
+/// Default number of bodies of the main asteroid belt, changed with the -asteroids argument.
+const unsigned ASTEROID_BELT_SIZE = 1000000;
+/// Default number of bodies of the Kuiper belt, changed with the -kuiper argument.
+const unsigned KUIPER_BELT_SIZE = 1000000;
+/// Random seed of the main asteroid belt.
+const unsigned ASTEROID_BELT_SEED = 1;
+/// Random seed of the Kuiper belt.
+const unsigned KUIPER_BELT_SEED = 2;
+/// Largest number of bodies of one belt, about 100 bytes each.
+const unsigned MAX_BELT_SIZE = 4000000;
+/// Largest number of debris field particles in the scene, each one a body of the per-tick gravity pass.
+const unsigned MAX_DEBRIS_PARTICLES = 100000;
+/// Largest number of planets of the startup catalog benchmark, each with a satellite.
+const unsigned MAX_BENCHMARK_PLANETS = 100000;
+/// Smallest displayed size of belt bodies, in thousands of km.
+const float BELT_BODY_MIN_SIZE = 2.0f;
+/// Largest displayed size of belt bodies, in thousands of km.
+const float BELT_BODY_MAX_SIZE = 10.0f;
+/// Generated sphere model shared by the bodies.
+const char* SPHERE_MODEL_NAME = "Models/Icosphere.mdl";
+/// Subdivisions of the finest sphere LOD level.
+const unsigned SPHERE_MAX_SUBDIVISIONS = 6;
+/// Solar system catalog resource.
+const char* CATALOG_NAME = "Catalogs/SolarSystem.xml";
+/// Star catalog resource, converted from the HYG database by tools/MakeStarCatalog.
+const char* STAR_CATALOG_NAME = "Catalogs/Stars.bin";
+/// Sprite sheet of the card face atlas, packed by tools/PackAtlas.
+const char* CARD_ATLAS_SHEET_NAME = "Textures/CardAtlasSheet.xml";
+/// Distance of the star sphere from the camera, as a fraction of the far clip.
+const float STAR_FIELD_DISTANCE = 0.9f;
+/// Default time budget for executing received commands per frame, in milliseconds.
+const float DEFAULT_COMMAND_BUDGET = 4.0f;
+/// Camera zoom change per mouse wheel step.
+const float CAMERA_ZOOM_STEP = 1.25f;
+/// Largest camera zoom.
+const float CAMERA_MAX_ZOOM = 1000.0f;
 
 URHO3D_DEFINE_APPLICATION_MAIN(StaticScene)
 
 StaticScene::StaticScene(Context* context) :
-    Sample(context)
+    Sample(context),
+    commandBudget_(DEFAULT_COMMAND_BUDGET),
+    queuedBytes_(0),
+    relayMessageID_(0),
+    nextStateChunk_(0),
+    stateParticles_(0),
+    statePending_(false),
+    asteroidBeltSize_(ASTEROID_BELT_SIZE),
+    kuiperBeltSize_(KUIPER_BELT_SIZE),
+    benchmarkPlanets_(0)
 {
 
 	//myPort=0;
     //myAngle=0;
-    context->RegisterFactory<Rotator>();
+    OrbitSystem::RegisterObject(context);
+    FloatingOrigin::RegisterObject(context);
+    NBodySystem::RegisterObject(context);
+    OrbitTrails::RegisterObject(context);
+    AsteroidBelt::RegisterObject(context);
+    StarField::RegisterObject(context);
+    BodyImpostors::RegisterObject(context);
+    AtlasBatch::RegisterObject(context);
+    context->RegisterSubsystem(new SimulationClock(context));
+    context->RegisterSubsystem(new TextureStreamer(context));
     const Vector<String>& arguments=GetArguments();
 
    sscanf(arguments[0].CString(),"%d",&myPort);
    sscanf(arguments[1].CString(),"%d",&myAngle);
 
+   // An optional third argument makes this instance a render node of the authoritative instance at that address
+   if (arguments.Size() > 2 && !arguments[2].StartsWith("-"))
+       authorityAddress_ = arguments[2];
+
+   // -asteroids and -kuiper set the number of bodies of each belt, zero leaving the belt out. -benchmark times the
+   // loading of a synthetic catalog of that many planets once the scene is up
+   for (unsigned i = 2; i + 1 < arguments.Size(); ++i)
+   {
+       if (arguments[i] == "-asteroids")
+           asteroidBeltSize_ = Min(ToUInt(arguments[++i]), MAX_BELT_SIZE);
+       else if (arguments[i] == "-kuiper")
+           kuiperBeltSize_ = Min(ToUInt(arguments[++i]), MAX_BELT_SIZE);
+       else if (arguments[i] == "-benchmark")
+           benchmarkPlanets_ = Min(ToUInt(arguments[++i]), MAX_BENCHMARK_PLANETS);
+   }
+
    printf("myPort=%d myAngle=%d\n",myPort, myAngle);
 
 }
@@ -76,6 +186,7 @@ void StaticScene::Start()
     SetLogoVisible(false);
 
     cache = GetSubsystem<ResourceCache>();
+    resources_ = new ResourceTable(context_);
 
     input = GetSubsystem<Input>();
     nbJoysticks=input->GetNumJoysticks();
@@ -97,6 +208,12 @@ void StaticScene::Start()
     // Create the scene content
     CreateScene();
 
+    // Start the simulation at the current date
+    GetSubsystem<SimulationClock>()->SeekNow();
+
+    if (benchmarkPlanets_)
+        BenchmarkCatalog(benchmarkPlanets_);
+
     // Create the UI content
     CreateInstructions();
 
@@ -114,225 +231,138 @@ void StaticScene::CreateScene()
     scene_ = new Scene(context_);
 
     // Create the Octree component to the scene. This is required before adding any drawable components, or else nothing will
-    // show up. The default octree volume will be from (-1000, -1000, -1000) to (1000, 1000, 1000) in world coordinates; it
-    // is also legal to place objects outside the volume but their visibility can then not be checked in a hierarchically
-    // optimizing manner
-    scene_->CreateComponent<Octree>();
-
-    Node* planeNode = scene_->CreateChild("Plane");
-    planeNode->SetScale(Vector3(70.0f, 7.0f, 70.0f));
-    /*StaticModel* planeObject = planeNode->CreateComponent<StaticModel>();
-    planeObject->SetModel(cache->GetResource<Model>("bin/Data/Models/Disk.mdl"));
-    planeObject->SetMaterial(cache->GetResource<Material>("bin/Data/Materials/GreenTransparent.xml"));
-*/
-    /*Création Soleil*/
-    sunPosNode = scene_->CreateChild("SunPos");
-    sunPosNode->SetPosition(Vector3(0.0f, 0.0f, 0.0f));
-    Node* earth_revol = sunPosNode->CreateChild("SunPosRot");
-    earth_revol->SetPosition(Vector3(0.0f, 0.0f, 0.0f));
-    Rotator* rotator_earth_revol = earth_revol->CreateComponent<Rotator>();
-    rotator_earth_revol->SetRotationSpeed(Vector3(0.0f, -10.0f, 0.0f));
-    Node* Sun=sunPosNode->CreateChild("Sun");
-    Sun->SetPosition(Vector3(0.0f, 0.0f, 0.0f));
-    Sun->SetScale(Vector3(40.0f, 40.0f, 40.0f));
-    StaticModel* sunObject = Sun->CreateComponent<StaticModel>();
-    sunObject->SetModel(cache->GetResource<Model>("bin/Data/Models/Sphere.mdl"));
-    sunObject->SetMaterial(cache->GetResource<Material>("bin/Data/Materials/sunmap.xml"));
+    // show up. The octree is in render space, which the floating origin keeps centered on the camera, so it only needs to
+    // cover the neighbourhood of the camera finely; far bodies fall in the root octant and are still culled
+    Octree* octree = scene_->CreateComponent<Octree>();
+    octree->SetSize(BoundingBox(-OCTREE_SIZE, OCTREE_SIZE), 10);
+
+    // The default zone fogs everything past a thousand units, which would hide the planets and the sky. This zone
+    // covers the render space and pushes the fog out to the far clip
+    Zone* zone = scene_->CreateComponent<Zone>();
+    zone->SetBoundingBox(BoundingBox(-CAMERA_FAR_CLIP, CAMERA_FAR_CLIP));
+    zone->SetFogColor(Color::BLACK);
+    zone->SetFogStart(CAMERA_FAR_CLIP);
+    zone->SetFogEnd(CAMERA_FAR_CLIP);
+
+    // All orbiting and spinning nodes are moved together by one scene-level orbit system
+    OrbitSystem* orbitSystem = scene_->CreateComponent<OrbitSystem>();
+
+    // World positions are in double precision, one unit being a thousand kilometres. What reaches the renderer is
+    // relative to a floating origin following the camera, so single precision is only ever used close to it
+    FloatingOrigin* floatingOrigin = scene_->CreateComponent<FloatingOrigin>();
+
+    // Free particles (debris fields, comets) are integrated under the gravity of the catalog bodies given a
+    // gravitational parameter. The system stays idle until particles are added with the NB command
+    NBodySystem* nbodySystem = scene_->CreateComponent<NBodySystem>();
+
+    // The bodies share a generated sphere with one LOD level per subdivision, registered before the catalog or the
+    // snapshot refer to it by name. The levels are picked by projected radius, so distant bodies cost a few triangles
+    SharedPtr<Model> sphereModel = CreateIcosphereModel(context_, SPHERE_MAX_SUBDIVISIONS,
+        (float)GetSubsystem<Graphics>()->GetHeight(), CAMERA_FOV);
+    sphereModel->SetName(SPHERE_MODEL_NAME);
+    cache->AddManualResource(sphereModel);
+
+    // The content comes from a binary snapshot of the catalog when one is up to date; it is memory-mapped and
+    // instantiated without parsing. Otherwise the catalog is loaded and a new snapshot written for the next start
+    FileSystem* fileSystem = GetSubsystem<FileSystem>();
+    unsigned catalogTime = fileSystem->GetLastModifiedTime(cache->GetResourceFileName(CATALOG_NAME));
+    String snapshotName = fileSystem->GetAppPreferencesDir("urho3d", "snapshots") + "SolarSystem.snap";
+    SharedPtr<SceneSnapshot> snapshot(new SceneSnapshot(context_));
+    if (fileSystem->FileExists(snapshotName) && snapshot->Load(snapshotName) &&
+        snapshot->GetSourceTime() == catalogTime && snapshot->Instantiate(scene_))
+    {
+        printf("Snapshot %s: load %lld us, instantiate %lld us\n", snapshotName.CString(), snapshot->GetLoadTime(),
+            snapshot->GetInstantiateTime());
+        worldNode = scene_->GetChild("World");
+    }
+    else
+    {
+        // Static content placed in world coordinates hangs below the world root, which the floating origin moves
+        worldNode = scene_->CreateChild("World");
+
+        Node* planeNode = scene_->CreateChild("Plane");
+        planeNode->SetScale(Vector3(70.0f, 7.0f, 70.0f));
+        /*StaticModel* planeObject = planeNode->CreateComponent<StaticModel>();
+        planeObject->SetModel(cache->GetResource<Model>("bin/Data/Models/Disk.mdl"));
+        planeObject->SetMaterial(cache->GetResource<Material>("bin/Data/Materials/GreenTransparent.xml"));
+        */
+        // The bodies, their hierarchy, orbits, spins and assets come from the catalog. Orbits use the J2000 elements
+        // of each body and are evaluated in closed form by the orbit system, so the planets are direct children of
+        // the scene and keep their heliocentric positions in double precision until the floating origin is subtracted
+        catalog_ = new SolarCatalog(context_);
+        if (catalog_->Load(cache->GetResource<XMLFile>(CATALOG_NAME)))
+        {
+            catalog_->Instantiate(scene_, worldNode);
+            for (unsigned i = 0; i < catalog_->GetNumBodies(); ++i)
+            {
+                if (catalog_->GetBody(i).gravitationalParameter_ > 0.0)
+                    nbodySystem->AddAttractor(catalog_->GetBody(i).gravitationalParameter_, catalog_->GetOrbit(i));
+            }
 
-    
-    /*Création Terre*/
-    earthPosNode = earth_revol->CreateChild("EarthPos");
-    earthPosNode->SetPosition(Vector3(50.0f, 0.0f, 0.0f));//distance Terre_Soleil
-    //earthPosNode->SetScale(Vector3(1.0f, 1.0f, 1.0f));
-    //Rotator* rotatorEarthPos = earthPosNode->CreateComponent<Rotator>();
-    //rotatorEarthPos->SetRotationSpeed(Vector3(0.0f, -10.0f, 0.0f));
-    Node* earthInclinedNode = earthPosNode->CreateChild("EarthInclined");
-    earthInclinedNode->SetPosition(Vector3(0.0f, 0.0f, 0.0f));
-    earthInclinedNode->SetRotation(Quaternion(0.0f, 0.0f, 23.0f)); //Inclinaison de 23° par rapport à l'écliptique
-
-    Node* cylinderInclinedNode = earthInclinedNode->CreateChild("cylinderInclined");//Axe de rotation
-    cylinderInclinedNode->SetPosition(Vector3(0.0f, 0.0f, 0.0f));
-    cylinderInclinedNode->SetScale(Vector3(0.50f, 12.0f, 0.50f));
-    StaticModel* cylinderInclinedObject = cylinderInclinedNode->CreateComponent<StaticModel>();
-    cylinderInclinedObject->SetModel(cache->GetResource<Model>("Models/Cylinder.mdl"));
-    cylinderInclinedObject->SetMaterial(cache->GetResource<Material>("Materials/cyl10.xml"));
-    Node* earthNode = earthInclinedNode->CreateChild("Earth");
-    //Node* earthNode = earthPosNode->CreateChild("Earth");
-    earthNode->SetScale(Vector3(10.0f, 10.0f, 10.0f));
-    StaticModel* earthObject = earthNode->CreateComponent<StaticModel>();
-    earthObject->SetModel(cache->GetResource<Model>("Models/Sphere.mdl"));
-    earthObject->SetMaterial(cache->GetResource<Material>("Materials/earthmap.xml"));
-    Rotator* earthnoderotator = earthNode->CreateComponent<Rotator>();
-    earthnoderotator->SetRotationSpeed(Vector3(0.0f, -100.0f, 0.0f));
-
-    Node* moon_revol = earthPosNode->CreateChild("EarthPosRot");
-    moon_revol->SetPosition(Vector3(0.0f, 0.0f, 0.0f));
-    moon_revol->SetRotation(Quaternion(0.0f, 0.0f, 5.16f));
-    Rotator* rotator_moon_revol = moon_revol->CreateComponent<Rotator>();
-    rotator_moon_revol->SetRotationSpeed(Vector3(0.0f, -10.0f, 0.0f));
-
-    Node* moonNode = moon_revol->CreateChild("Moon");
-    moonNode->SetPosition(Vector3(10.0f, 0.0f, 0.0f));
-    moonNode->SetScale(Vector3(5.0f, 5.0f, 5.0f));
-    moonNode->SetRotation(Quaternion(0.0f, 0.0f, 6.68f));
-    Rotator* moon_rot= moonNode->CreateComponent<Rotator>();
-    moon_rot->SetRotationSpeed(Vector3(0.0f, -10.0f, 0.0f));
-    /*
-    Node* moonrotNode=moonNode->CreateChild("Moonrot");
-    Rotator* rotatormoon = moonrotNode->CreateComponent<Rotator>();
-    rotatormoon->SetRotationSpeed(Vector3(0.0f, -30.0f, 0.0f));*/
-
-    StaticModel* moonObject = moonNode->CreateComponent<StaticModel>();
-    moonObject->SetModel(cache->GetResource<Model>("Models/Sphere.mdl"));
-    moonObject->SetMaterial(cache->GetResource<Material>("bin/Data/Materials/moonmap.xml"));
+            snapshot->Close();
+            snapshot->SetSourceTime(catalogTime);
+            snapshot->Save(scene_, snapshotName);
+        }
+    }
+    floatingOrigin->SetWorldRoot(worldNode);
 
-    
-    /*MERCURE*/
-    Node* mercure_revol= sunPosNode->CreateChild("revol_mercure"); //Révolution autour du soleil
-    Rotator* rotator_mercure_revol= mercure_revol->CreateComponent<Rotator>();
-    rotator_mercure_revol->SetRotationSpeed(Vector3(0.0f, -10.0f, 0.0f));
-
-    Node* MercureNode = mercure_revol->CreateChild("MercurePosNode");
-    MercureNode->SetPosition(Vector3(10.0f, 0.0f, 0.0f)); //Distance Soleil
-    MercureNode->SetScale(Vector3(5.0f, 5.0f, 5.0f)); //Taille
-    Rotator* mercure_rot= MercureNode->CreateComponent<Rotator>();
-    mercure_rot->SetRotationSpeed(Vector3(0.0f, -10.0f, 0.0f)); //Vitesse rotation
-    StaticModel* mercureObject = MercureNode->CreateComponent<StaticModel>();
-    mercureObject->SetModel(cache->GetResource<Model>("Models/Sphere.mdl"));
-    mercureObject->SetMaterial(cache->GetResource<Material>("bin/Data/Materials/mercurymap.xml"));
-
-
-    /*VENUS*/
-    Node* venus_revol= sunPosNode->CreateChild("revol_venus"); 
-    venus_revol->SetPosition(Vector3(0.0f, 0.0f, 0.0f));
-    venus_revol->SetRotation(Quaternion(0.0f, 0.0f, 3.39f));//inclinaison par rapport à l'axe de l'écliptique
-    Rotator* rotator_venus_revol= venus_revol->CreateComponent<Rotator>();
-    rotator_venus_revol->SetRotationSpeed(Vector3(0.0f, 10.0f, 0.0f));//Revolution autour du Soleil
-
-    Node* VenusNode=venus_revol->CreateChild("Venus_node");
-    VenusNode->SetPosition(Vector3(40.0f, 0.0f, 0.0f));
-    VenusNode->SetRotation(Quaternion(0.0f, 0.0f, 177.36f));
-    VenusNode->SetScale(Vector3(5.0f, 5.0f, 5.0f)); //Taille
-    Rotator* venus_rot= VenusNode->CreateComponent<Rotator>();
-    venus_rot->SetRotationSpeed(Vector3(0.0f, -10.0f, 0.0f)); //Vitesse rotation
-    StaticModel* venusObject = VenusNode->CreateComponent<StaticModel>();
-    venusObject->SetModel(cache->GetResource<Model>("Models/Sphere.mdl"));
-    venusObject->SetMaterial(cache->GetResource<Material>("bin/Data/Materials/venusmap.xml"));
-
-    /*MARS*/
-    Node* mars_revol= sunPosNode->CreateChild("revol_mars"); 
-    mars_revol->SetPosition(Vector3(0.0f, 0.0f, 0.0f));
-    mars_revol->SetRotation(Quaternion(0.0f, 0.0f, 1.85f));//inclinaison par rapport à l'axe de l'écliptique
-    Rotator* rotator_mars_revol= mars_revol->CreateComponent<Rotator>();
-    rotator_mars_revol->SetRotationSpeed(Vector3(0.0f, -10.0f, 0.0f));//Revolution autour du Soleil
-
-    Node* MarsNode=mars_revol->CreateChild("Mars_node");
-    MarsNode->SetPosition(Vector3(70.0f, 0.0f, 0.0f));
-    MarsNode->SetRotation(Quaternion(0.0f, 0.0f, 25.19f));
-    MarsNode->SetScale(Vector3(5.0f, 5.0f, 5.0f)); //Taille
-    Rotator* Mars_rot= MarsNode->CreateComponent<Rotator>();
-    Mars_rot->SetRotationSpeed(Vector3(0.0f, -100.0f, 0.0f)); //Vitesse rotation
-    StaticModel* MarsObject = MarsNode->CreateComponent<StaticModel>();
-    MarsObject->SetModel(cache->GetResource<Model>("Models/Sphere.mdl"));
-    MarsObject->SetMaterial(cache->GetResource<Material>("bin/Data/Materials/marsmap.xml"));
-
-
-    /*JUPITER*/
-    Node* jupiter_revol= sunPosNode->CreateChild("revol_jupiter"); 
-    jupiter_revol->SetPosition(Vector3(0.0f, 0.0f, 0.0f));
-    jupiter_revol->SetRotation(Quaternion(0.0f, 0.0f, 1.3f));//inclinaison par rapport à l'axe de l'écliptique
-    Rotator* rotator_jupiter_revol= jupiter_revol->CreateComponent<Rotator>();
-    rotator_jupiter_revol->SetRotationSpeed(Vector3(0.0f, -10.0f, 0.0f));//Revolution autour du Soleil
-
-    Node* JupiterNode=jupiter_revol->CreateChild("Jupiter_node");
-    JupiterNode->SetPosition(Vector3(100.0f, 0.0f, 0.0f));
-    JupiterNode->SetRotation(Quaternion(0.0f, 0.0f, 3.12f));
-    JupiterNode->SetScale(Vector3(20.0f, 20.0f, 20.0f)); //Taille
-    Rotator* Jupiter_rot= JupiterNode->CreateComponent<Rotator>();
-    Jupiter_rot->SetRotationSpeed(Vector3(0.0f, -10.0f, 0.0f)); //Vitesse rotation
-    StaticModel* JupiterObject = JupiterNode->CreateComponent<StaticModel>();
-    JupiterObject->SetModel(cache->GetResource<Model>("Models/Sphere.mdl"));
-    JupiterObject->SetMaterial(cache->GetResource<Material>("bin/Data/Materials/jupitermap.xml"));
-
-    /*SATURNE*/
-    Node* saturne_revol= sunPosNode->CreateChild("revol_saturne");  
-    saturne_revol->SetPosition(Vector3(0.0f, 0.0f, 0.0f));
-    saturne_revol->SetRotation(Quaternion(0.0f, 0.0f, 2.48f));//inclinaison par rapport à l'axe de l'écliptique
-    Rotator* rotator_saturne_revol= saturne_revol->CreateComponent<Rotator>();
-    rotator_saturne_revol->SetRotationSpeed(Vector3(0.0f, -10.0f, 0.0f));//Revolution autour du Soleil
-
-    Node* SaturneNode=saturne_revol->CreateChild("Saturne_node");
-    SaturneNode->SetPosition(Vector3(150.0f, 0.0f, 0.0f));
-    SaturneNode->SetRotation(Quaternion(0.0f, 0.0f, 26.73f));
-    SaturneNode->SetScale(Vector3(20.0f, 20.0f, 20.0f)); //Taille
-    Rotator* Saturne_rot= SaturneNode->CreateComponent<Rotator>();
-    Saturne_rot->SetRotationSpeed(Vector3(0.0f, -10.0f, 0.0f)); //Vitesse rotation
-    StaticModel* SaturneObject = SaturneNode->CreateComponent<StaticModel>();
-    SaturneObject->SetModel(cache->GetResource<Model>("Models/Sphere.mdl"));
-    StaticModel* SaturneAnneau = SaturneNode->CreateComponent<StaticModel>();
-    SaturneObject->SetMaterial(cache->GetResource<Material>("bin/Data/Materials/saturnmap.xml"));
-    SaturneAnneau->SetModel(cache->GetResource<Model>("Models/Disk.mdl"));
-    SaturneAnneau->SetMaterial(cache->GetResource<Material>("bin/Data/Materials/saturnringmap.xml"));
-
-
-    /*URANUS*/
-    Node* uranus_revol= sunPosNode->CreateChild("revol_uranus");  
-    uranus_revol->SetPosition(Vector3(0.0f, 0.0f, 0.0f));
-    uranus_revol->SetRotation(Quaternion(0.0f, 0.0f, 0.77f));//inclinaison par rapport à l'axe de l'écliptique
-    Rotator* rotator_uranus_revol= uranus_revol->CreateComponent<Rotator>();
-    rotator_uranus_revol->SetRotationSpeed(Vector3(0.0f, -10.0f, 0.0f));//Revolution autour du Soleil
-
-    Node* UranusNode=uranus_revol->CreateChild("Uranus_node");
-    UranusNode->SetPosition(Vector3(200.0f, 0.0f, 0.0f));  
-    UranusNode->SetRotation(Quaternion(0.0f, 0.0f, 97.77f));
-    UranusNode->SetScale(Vector3(20.0f, 20.0f, 20.0f)); //Taille
-    Rotator* Uranus_rot= UranusNode->CreateComponent<Rotator>();
-    Uranus_rot->SetRotationSpeed(Vector3(0.0f, -10.0f, 0.0f)); //Vitesse rotation
-    StaticModel* UranusObject = UranusNode->CreateComponent<StaticModel>();
-    UranusObject->SetModel(cache->GetResource<Model>("Models/Sphere.mdl"));
-    UranusObject->SetMaterial(cache->GetResource<Material>("bin/Data/Materials/uranusmap.xml"));
-
-
-    /*NEPTUNE*/
-    Node* neptune_revol= sunPosNode->CreateChild("revol_neptune");  
-    neptune_revol->SetPosition(Vector3(0.0f, 0.0f, 0.0f));
-    neptune_revol->SetRotation(Quaternion(0.0f, 0.0f, 1.76f));//inclinaison par rapport à l'axe de l'écliptique
-    Rotator* rotator_neptune_revol= neptune_revol->CreateComponent<Rotator>();
-    rotator_neptune_revol->SetRotationSpeed(Vector3(0.0f, -10.0f, 0.0f));//Revolution autour du Soleil
-
-    Node* NeptuneNode=neptune_revol->CreateChild("neptune_node");
-    NeptuneNode->SetPosition(Vector3(250.0f, 0.0f, 0.0f));
-    NeptuneNode->SetRotation(Quaternion(0.0f, 0.0f, 28.3f));
-    NeptuneNode->SetScale(Vector3(20.0f, 20.0f, 20.0f)); //Taille
-    Rotator* Neptune_rot= NeptuneNode->CreateComponent<Rotator>();
-    Neptune_rot->SetRotationSpeed(Vector3(0.0f, -10.0f, 0.0f)); //Vitesse rotation
-    StaticModel* NeptuneObject = NeptuneNode->CreateComponent<StaticModel>();
-    NeptuneObject->SetModel(cache->GetResource<Model>("Models/Sphere.mdl"));
-    NeptuneObject->SetMaterial(cache->GetResource<Material>("bin/Data/Materials/neptunemap.xml"));
-
-
-    /*PLUTON*/
-    Node* pluton_revol= sunPosNode->CreateChild("revol_pluton");  
-    pluton_revol->SetPosition(Vector3(0.0f, 0.0f, 0.0f));
-    pluton_revol->SetRotation(Quaternion(0.0f, 0.0f, 0.77f));//inclinaison par rapport à l'axe de l'écliptique
-    Rotator* rotator_pluton_revol= pluton_revol->CreateComponent<Rotator>();
-    rotator_pluton_revol->SetRotationSpeed(Vector3(0.0f, -10.0f, 0.0f));//Revolution autour du Soleil
-
-    Node* PlutonNode=pluton_revol->CreateChild("pluton_node");
-    PlutonNode->SetPosition(Vector3(300.0f, 0.0f, 0.0f));
-    PlutonNode->SetRotation(Quaternion(0.0f, 0.0f, 97.77f));
-    PlutonNode->SetScale(Vector3(20.0f, 20.0f, 20.0f)); //Taille
-    Rotator* Pluton_rot= PlutonNode->CreateComponent<Rotator>();
-    Pluton_rot->SetRotationSpeed(Vector3(0.0f, -10.0f, 0.0f)); //Vitesse rotation
-    StaticModel* PlutonObject = PlutonNode->CreateComponent<StaticModel>();
-    PlutonObject->SetModel(cache->GetResource<Model>("Models/Sphere.mdl"));
-    PlutonObject->SetMaterial(cache->GetResource<Material>("bin/Data/Materials/plutonmap.xml"));
-
-
-
-    /*StaticModel* SaturneAnneau = SaturneNode->CreateComponent<StaticModel>();
-    SaturneAnneau->SetModel(cache->GetResource<Model>("Models/Disk.mdl"));
-*/
+    // Objects textured from the card atlas are merged into a single batch below the world root. It is created after
+    // the snapshot was saved, as its content comes from the network
+    if (cache->Exists(CARD_ATLAS_SHEET_NAME))
+    {
+        objects_ = worldNode->CreateChild("Objects")->CreateComponent<AtlasBatch>();
+        objects_->SetSheet(cache->GetResource<XMLFile>(CARD_ATLAS_SHEET_NAME));
+    }
+    sunPosNode = scene_->GetChild("Sun", true);
+    earthPosNode = scene_->GetChild("Earth", true);
+
+    // Orbit paths of the planets and trails of every orbiting body, all drawn in a single batch
+    Node* trailsNode = scene_->CreateChild("Trails");
+    OrbitTrails* trails = trailsNode->CreateComponent<OrbitTrails>();
+    trails->SetMaterial(cache->GetResource<Material>("Materials/VColUnlit.xml"));
+    for (unsigned i = 0; i < orbitSystem->GetNumOrbits(); ++i)
+    {
+        // Paths are drawn around the Sun; satellites only leave a trail
+        if (orbitSystem->GetParentOrbit(i) == M_MAX_UNSIGNED)
+            trails->AddOrbitPath(orbitSystem->GetOrbit(i), ORBIT_PATH_COLOR);
+        trails->AddTrail(orbitSystem->GetOrbitNode(i), TRAIL_COLOR);
+    }
+
+    // The main asteroid belt and the Kuiper belt, each body on its own orbit but none of them a scene node
+    if (asteroidBeltSize_)
+        CreateBelt("AsteroidBelt", asteroidBeltSize_, 2.1, 3.3, 0.25f, 20.0f, ASTEROID_BELT_SEED);
+    if (kuiperBeltSize_)
+        CreateBelt("KuiperBelt", kuiperBeltSize_, 30.0, 50.0, 0.2f, 30.0f, KUIPER_BELT_SEED);
+
+    // The sky: catalog stars on a sphere following the camera, streamed in brightest first by a background thread
+    if (cache->Exists(STAR_CATALOG_NAME))
+    {
+        Node* starsNode = scene_->CreateChild("Stars");
+        StarField* stars = starsNode->CreateComponent<StarField>();
+        stars->SetMaterial(cache->GetResource<Material>("Materials/VColUnlit.xml"));
+        stars->SetRadius(CAMERA_FAR_CLIP * STAR_FIELD_DISTANCE);
+        stars->Load(STAR_CATALOG_NAME);
+    }
+
+    Node* debrisNode = scene_->CreateChild("Debris");
+    BillboardSet* debrisObject = debrisNode->CreateComponent<BillboardSet>();
+    debrisObject->SetMaterial(cache->GetResource<Material>("Materials/Particle.xml"));
+    nbodySystem->SetBillboardSet(debrisObject, Vector2(DEBRIS_SIZE, DEBRIS_SIZE));
+
+    // Bodies projecting to a few pixels are swapped for lit billboards, all drawn in one batch. The Sun is left out as
+    // it is lit from within
+    Node* impostorsNode = scene_->CreateChild("Impostors");
+    BillboardSet* impostorsObject = impostorsNode->CreateComponent<BillboardSet>();
+    impostorsObject->SetMaterial(cache->GetResource<Material>("Materials/Impostor.xml"));
+    BodyImpostors* impostors = scene_->CreateComponent<BodyImpostors>();
+    impostors->SetBillboardSet(impostorsObject);
+    PODVector<StaticModel*> bodyModels;
+    scene_->GetComponents<StaticModel>(bodyModels, true);
+    for (unsigned i = 0; i < bodyModels.Size(); ++i)
+    {
+        if (bodyModels[i]->GetModel() == sphereModel && bodyModels[i]->GetNode() != sunPosNode)
+            impostors->AddBody(bodyModels[i]);
+    }
 
     //moonObject->SetMaterial(cache->GetResource<Material>("Materials/earthmap.xml"));
     //Rotator* rotatorMoon = moonNode->CreateComponent<Rotator>();
@@ -344,14 +374,14 @@ void StaticScene::CreateScene()
     
 
 
-    Node* lightNodecentr = scene_->CreateChild();
+    Node* lightNodecentr = worldNode->CreateChild();
     lightNodecentr->SetPosition(Vector3(0.0f, 0.0f, 0.0f));
     //lightNode->SetDirection(Vector3(0.0f, 0.0f, 0.0f)); // The direction vector does not need to be normalized
     Light* lightcentre = lightNodecentr->CreateComponent<Light>();
     //light->SetLightType(LIGHT_DIRECTIONAL);
     lightcentre->SetBrightness(7.0);
 
-    Node* lightNodeleft = scene_->CreateChild();
+    Node* lightNodeleft = worldNode->CreateChild();
     lightNodeleft->SetPosition(Vector3(7.0f, 0.0f, 0.0f));
     //lightNode->SetDirection(Vector3(0.0f, 0.0f, 0.0f)); // The direction vector does not need to be normalized
     Light* lightleft = lightNodeleft->CreateComponent<Light>();
@@ -366,9 +396,13 @@ void StaticScene::CreateScene()
     //light->SetBrightness(3.0);
 
     // Create a scene node for the camera, which we will move around
-    // The camera will use default settings (1000 far clip distance, 45 degrees FOV, set aspect ratio automatically)
+    // The far clip reaches past Pluto; the camera position is in render space, relative to the floating origin
     cameraNode_ = scene_->CreateChild("Camera");
-    cameraNode_->CreateComponent<Camera>();
+    Camera* camera = cameraNode_->CreateComponent<Camera>();
+    camera->SetFarClip(CAMERA_FAR_CLIP);
+    camera->SetFov(CAMERA_FOV);
+    floatingOrigin->SetCameraNode(cameraNode_);
+    impostors->SetCamera(camera);
 
     // Set an initial position for the camera scene node above the plane
     cameraNode_->SetPosition(Vector3(0.0f, 15.0f, 0.0f));
@@ -413,6 +447,8 @@ void StaticScene::MoveCamera(float timeStep)
 
     // Movement speed as world units per second
     const float MOVE_SPEED = 20.0f;
+    // Movement speed multiplier while shift is held, to cross interplanetary distances
+    const float FAST_MOVE_MULTIPLIER = 1000.0f;
     // Mouse sensitivity as degrees per pixel
     const float MOUSE_SENSITIVITY = 0.1f;
 
@@ -423,17 +459,27 @@ void StaticScene::MoveCamera(float timeStep)
     //pitch_ = 60.0f;
 
     pitch_ = Clamp(pitch_, -90.0f, 90.0f);
+
+    // The mouse wheel zooms; fainter stars appear as the zoom grows
+    if (input->GetMouseMoveWheel())
+    {
+        Camera* camera = cameraNode_->GetComponent<Camera>();
+        float zoom = camera->GetZoom() * Pow(CAMERA_ZOOM_STEP, (float)input->GetMouseMoveWheel());
+        camera->SetZoom(Clamp(zoom, 1.0f, CAMERA_MAX_ZOOM));
+    }
+
+    float moveSpeed = input->GetKeyDown(KEY_SHIFT) ? MOVE_SPEED * FAST_MOVE_MULTIPLIER : MOVE_SPEED;
     
     // Read WASD keys and move the camera scene node to the corresponding direction if they are pressed
     // Use the Translate() function (default local space) to move relative to the node's orientation.
     if (input->GetKeyDown('W'))
-        cameraNode_->Translate(Vector3::FORWARD * MOVE_SPEED * timeStep);
+        cameraNode_->Translate(Vector3::FORWARD * moveSpeed * timeStep);
     if (input->GetKeyDown('S'))
-        cameraNode_->Translate(Vector3::BACK * MOVE_SPEED * timeStep);
+        cameraNode_->Translate(Vector3::BACK * moveSpeed * timeStep);
     if (input->GetKeyDown('A'))
-        cameraNode_->Translate(Vector3::LEFT * MOVE_SPEED * timeStep);
+        cameraNode_->Translate(Vector3::LEFT * moveSpeed * timeStep);
     if (input->GetKeyDown('D'))
-        cameraNode_->Translate(Vector3::RIGHT * MOVE_SPEED * timeStep);
+        cameraNode_->Translate(Vector3::RIGHT * moveSpeed * timeStep);
 
 /*
     //Vector3 cpos=cameraNode_->GetPosition();
@@ -630,15 +676,29 @@ void StaticScene::SubscribeToEvents()
     // Subscribe HandleUpdate() function for processing update events
     SubscribeToEvent(E_UPDATE, URHO3D_HANDLER(StaticScene, HandleUpdate));
 
-        // Start server
+        // The authoritative instance runs the server, simulates, and sends its state to the render nodes after each
+        // frame in which its clock ticked or seeked. A render node only connects to it, and gets both its commands
+        // and its state from there
 
-        Network* network = GetSubsystem<Network>();
-        network->StartServer(GAME_SERVER_PORT);
+        if (authorityAddress_.Empty())
+        {
+                Network* network = GetSubsystem<Network>();
+                network->StartServer(GAME_SERVER_PORT);
+                SubscribeToEvent(E_SIMULATIONTICK, URHO3D_HANDLER(StaticScene, HandleSimulationTick));
+                SubscribeToEvent(E_SIMULATIONSEEK, URHO3D_HANDLER(StaticScene, HandleSimulationTick));
+                SubscribeToEvent(E_POSTUPDATE, URHO3D_HANDLER(StaticScene, HandlePostUpdate));
+        }
+        else
+                ConnectToAuthority();
 
         // Subscribe to network events
 
         SubscribeToEvent(E_CLIENTCONNECTED, URHO3D_HANDLER(StaticScene, HandleClientConnected));
         SubscribeToEvent(E_CLIENTDISCONNECTED, URHO3D_HANDLER(StaticScene, HandleClientDisconnected));
+        SubscribeToEvent(E_CLIENTIDENTITY, URHO3D_HANDLER(StaticScene, HandleClientIdentity));
+        SubscribeToEvent(E_SERVERCONNECTED, URHO3D_HANDLER(StaticScene, HandleServerConnected));
+        SubscribeToEvent(E_SERVERDISCONNECTED, URHO3D_HANDLER(StaticScene, HandleServerDisconnected));
+        SubscribeToEvent(E_CONNECTFAILED, URHO3D_HANDLER(StaticScene, HandleServerDisconnected));
         SubscribeToEvent(E_NETWORKMESSAGE, URHO3D_HANDLER(StaticScene, HandleNetworkMessage));
 
 }
@@ -650,8 +710,42 @@ void StaticScene::HandleUpdate(StringHash eventType, VariantMap& eventData)
     // Take the frame time step, which is stored as a float
     float timeStep = eventData[P_TIMESTEP].GetFloat();
 
+    // A render node that lost the authoritative instance simulates on its own meanwhile, and tries again now and then
+    if (!authorityAddress_.Empty() && !GetSubsystem<Network>()->GetServerConnection() &&
+        reconnectTimer_.GetMSec(false) >= AUTHORITY_RECONNECT_INTERVAL)
+        ConnectToAuthority();
+
+    // Commands received since the last frame run first, so that the scene reflects them before it renders
+    ExecuteQueuedCommands();
+
     // Move the camera, scale movement with time step
     MoveCamera(timeStep);
+
+    ManageTimeKeys();
+}
+
+void StaticScene::ManageTimeKeys()
+{
+    // Do not react if the UI has a focused element (the console)
+    if (GetSubsystem<UI>()->GetFocusElement())
+        return;
+
+    // Time is under control of the authoritative instance while the clock is replicated
+    SimulationClock* clock = GetSubsystem<SimulationClock>();
+    if (clock->IsReplicated())
+        return;
+
+    // Keypad +/- warp time by a factor of 10, R reverses, P pauses and N goes back to the current date
+    if (input->GetKeyPress(KEY_KP_PLUS))
+        clock->SetRate(clock->GetRate() * 10.0);
+    if (input->GetKeyPress(KEY_KP_MINUS))
+        clock->SetRate(clock->GetRate() / 10.0);
+    if (input->GetKeyPress('R'))
+        clock->Reverse();
+    if (input->GetKeyPress('P'))
+        clock->SetPaused(!clock->IsPaused());
+    if (input->GetKeyPress('N'))
+        clock->SeekNow();
 }
 
 void StaticScene::HandleClientConnected(StringHash eventType, VariantMap& eventData)
@@ -661,7 +755,262 @@ void StaticScene::HandleClientConnected(StringHash eventType, VariantMap& eventD
 
 void StaticScene::HandleClientDisconnected(StringHash eventType, VariantMap& eventData)
 {
+        using namespace ClientDisconnected;
+
         printf("Client disconnected\n");
+        renderNodes_.Remove(WeakPtr<Connection>(static_cast<Connection*>(eventData[P_CONNECTION].GetPtr())));
+}
+
+void StaticScene::HandleClientIdentity(StringHash eventType, VariantMap& eventData)
+{
+        using namespace ClientIdentity;
+
+        Connection* connection = static_cast<Connection*>(eventData[P_CONNECTION].GetPtr());
+        const VariantMap& identity = connection->GetIdentity();
+        VariantMap::ConstIterator renderNode = identity.Find(RENDER_NODE_IDENTITY);
+        if (renderNode != identity.End() && renderNode->second_.GetBool())
+        {
+                printf("Render node connected, %u in all\n", renderNodes_.Size() + 1);
+                renderNodes_.Push(WeakPtr<Connection>(connection));
+                SendFullState(connection);
+        }
+}
+
+void StaticScene::HandleServerConnected(StringHash eventType, VariantMap& eventData)
+{
+        printf("Connected to the authoritative instance %s\n", authorityAddress_.CString());
+}
+
+void StaticScene::HandleServerDisconnected(StringHash eventType, VariantMap& eventData)
+{
+        // Simulate locally from the last state received until the authoritative instance is back
+        printf("No authoritative instance at %s, simulating locally\n", authorityAddress_.CString());
+        GetSubsystem<SimulationClock>()->SetReplicated(false);
+        scene_->GetComponent<NBodySystem>()->SetReplicated(false);
+        reconnectTimer_.Reset();
+}
+
+void StaticScene::HandleSimulationTick(StringHash eventType, VariantMap& eventData)
+{
+    // The systems may handle the tick after this instance, so the state is written once they all did
+    statePending_ = true;
+}
+
+void StaticScene::HandlePostUpdate(StringHash eventType, VariantMap& eventData)
+{
+    if (statePending_)
+        SendState();
+    statePending_ = false;
+}
+
+void StaticScene::ConnectToAuthority()
+{
+    VariantMap identity;
+    identity[RENDER_NODE_IDENTITY] = true;
+    GetSubsystem<Network>()->Connect(authorityAddress_, GAME_SERVER_PORT, 0, identity);
+    reconnectTimer_.Reset();
+}
+
+void StaticScene::SendState()
+{
+    if (renderNodes_.Empty())
+        return;
+
+    SimulationClock* clock = GetSubsystem<SimulationClock>();
+    NBodySystem* nbodySystem = scene_->GetComponent<NBodySystem>();
+    if (nbodySystem->GetNumParticles() != stateParticles_)
+        SendFullState(0);
+
+    // Every message is a datagram of its own carrying the clock, so that losing one loses no more than its chunk.
+    // Newer states replace lost ones, so none is resent. Beyond the budget, chunks wait for the next ticks
+    unsigned numChunks = nbodySystem->GetNumChunks();
+    unsigned numMessages = Clamp(numChunks, 1U, MAX_STATE_CHUNKS_PER_TICK);
+    for (unsigned i = 0; i < numMessages; ++i)
+    {
+        stateMessage_.Clear();
+        stateMessage_.WriteUByte(STATE_PROTOCOL_VERSION);
+        stateMessage_.WriteUInt(clock->GetTick());
+        clock->WriteState(stateMessage_);
+        if (numChunks)
+        {
+            if (nextStateChunk_ >= numChunks)
+                nextStateChunk_ = 0;
+            nbodySystem->WriteChunk(stateMessage_, nextStateChunk_++);
+        }
+
+        for (unsigned j = 0; j < renderNodes_.Size(); ++j)
+        {
+            if (renderNodes_[j])
+                renderNodes_[j]->SendMessage(MSG_STATE, false, false, stateMessage_);
+        }
+    }
+}
+
+void StaticScene::SendFullState(Connection* connection)
+{
+    // Velocities only matter once a render node simulates on its own, so they go with the particles themselves: to a
+    // render node as it connects, and to all of them when the particles change. The content created by commands
+    // only goes to a connecting render node, as the others get the commands themselves
+    NBodySystem* nbodySystem = scene_->GetComponent<NBodySystem>();
+    stateMessage_.Clear();
+    stateMessage_.WriteUByte(STATE_PROTOCOL_VERSION);
+    stateMessage_.WriteVLE(scene_->GetComponent<OrbitSystem>()->GetNumOrbits());
+    nbodySystem->WriteState(stateMessage_);
+
+    if (connection)
+    {
+        WriteSceneContent(stateMessage_);
+        connection->SendMessage(MSG_FULL_STATE, true, true, stateMessage_);
+    }
+    else
+    {
+        for (unsigned i = 0; i < renderNodes_.Size(); ++i)
+        {
+            if (renderNodes_[i])
+                renderNodes_[i]->SendMessage(MSG_FULL_STATE, true, true, stateMessage_);
+        }
+        stateParticles_ = nbodySystem->GetNumParticles();
+    }
+}
+
+void StaticScene::ApplyState(MemoryBuffer& msg)
+{
+    if (msg.ReadUByte() != STATE_PROTOCOL_VERSION)
+    {
+        URHO3D_LOGERROR("Simulation state of an unknown protocol version dropped");
+        return;
+    }
+
+    // Each system skips what is older than what it applied last
+    unsigned tick = msg.ReadUInt();
+    SimulationClock* clock = GetSubsystem<SimulationClock>();
+    NBodySystem* nbodySystem = scene_->GetComponent<NBodySystem>();
+    clock->SetReplicated(true);
+    nbodySystem->SetReplicated(true);
+    clock->ReadState(msg, tick);
+    if (!msg.IsEof())
+        nbodySystem->ReadChunk(msg, tick, clock->GetTickLength());
+}
+
+void StaticScene::ApplyFullState(MemoryBuffer& msg)
+{
+    if (msg.ReadUByte() != STATE_PROTOCOL_VERSION)
+    {
+        URHO3D_LOGERROR("Simulation state of an unknown protocol version dropped");
+        return;
+    }
+    if (msg.ReadVLE() != scene_->GetComponent<OrbitSystem>()->GetNumOrbits())
+    {
+        URHO3D_LOGERROR("Simulation state of another body catalog dropped");
+        return;
+    }
+
+    NBodySystem* nbodySystem = scene_->GetComponent<NBodySystem>();
+    GetSubsystem<SimulationClock>()->SetReplicated(true);
+    nbodySystem->SetReplicated(true);
+    nbodySystem->ReadState(msg);
+    if (!msg.IsEof())
+        ReadSceneContent(msg);
+}
+
+void StaticScene::WriteSceneContent(Serializer& dest) const
+{
+    // Objects are written where they are now, so the moves they went through need not be replayed
+    dest.WriteVLE((unsigned)pointMap.size());
+    for (std::map<std::string, Vector3*>::const_iterator i = pointMap.begin(); i != pointMap.end(); ++i)
+    {
+        dest.WriteString(i->first.c_str());
+        dest.WriteVector3(*i->second);
+    }
+
+    dest.WriteVLE((unsigned)nodeMap.size());
+    for (std::map<std::string, Node*>::const_iterator i = nodeMap.begin(); i != nodeMap.end(); ++i)
+    {
+        const ObjectResources& objectResources = objectResources_.find(i->first)->second;
+        dest.WriteString(i->first.c_str());
+        dest.WriteVector3(i->second->GetPosition());
+        dest.WriteVector3(i->second->GetScale());
+        dest.WriteQuaternion(i->second->GetRotation());
+        dest.WriteString(resources_->GetModelName(objectResources.model_));
+        dest.WriteString(resources_->GetMaterialName(objectResources.material_));
+    }
+
+    // Belts go as their arguments and seed, from which the render node generates the same bodies
+    dest.WriteVLE(commandBelts_.Size());
+    for (unsigned i = 0; i < commandBelts_.Size(); ++i)
+    {
+        const BeltArguments& arguments = commandBelts_[i];
+        dest.WriteVLE(arguments.count_);
+        dest.WriteDouble(arguments.innerRadius_);
+        dest.WriteDouble(arguments.outerRadius_);
+        dest.WriteFloat(arguments.maxEccentricity_);
+        dest.WriteFloat(arguments.maxInclination_);
+        dest.WriteUInt(arguments.seed_);
+    }
+}
+
+void StaticScene::ReadSceneContent(Deserializer& source)
+{
+    // What the render node holds from an earlier connection, or was created on it since, is replaced as a whole
+    RemoveSceneContent();
+
+    unsigned numPoints = source.ReadVLE();
+    for (unsigned i = 0; i < numPoints; ++i)
+    {
+        String name = source.ReadString();
+        CreatePoint(name.CString(), new Vector3(source.ReadVector3()));
+    }
+
+    unsigned numObjects = source.ReadVLE();
+    for (unsigned i = 0; i < numObjects; ++i)
+    {
+        String name = source.ReadString();
+        Vector3 position = source.ReadVector3();
+        Vector3 scale = source.ReadVector3();
+        Quaternion rotation = source.ReadQuaternion();
+        String model = source.ReadString();
+        String material = source.ReadString();
+        CreateObject(name.CString(), position, scale, rotation, resources_->InternModel(model.CString()),
+            resources_->InternMaterial(material.CString()));
+    }
+
+    unsigned numBelts = source.ReadVLE();
+    for (unsigned i = 0; i < numBelts; ++i)
+    {
+        BeltArguments arguments;
+        arguments.count_ = source.ReadVLE();
+        arguments.innerRadius_ = source.ReadDouble();
+        arguments.outerRadius_ = source.ReadDouble();
+        arguments.maxEccentricity_ = source.ReadFloat();
+        arguments.maxInclination_ = source.ReadFloat();
+        arguments.seed_ = source.ReadUInt();
+        CreateCommandBelt(arguments);
+    }
+
+    printf("Scene content received: %u points, %u objects, %u belts\n", numPoints, numObjects, numBelts);
+}
+
+void StaticScene::RemoveSceneContent()
+{
+    for (std::map<std::string, Node*>::iterator i = nodeMap.begin(); i != nodeMap.end(); ++i)
+    {
+        if (objects_)
+            objects_->RemoveObject(i->second);
+        i->second->Remove();
+    }
+    nodeMap.clear();
+    objectResources_.clear();
+
+    for (std::map<std::string, Vector3*>::iterator i = pointMap.begin(); i != pointMap.end(); ++i)
+        delete i->second;
+    pointMap.clear();
+
+    for (unsigned i = 0; i < commandBelts_.Size(); ++i)
+    {
+        if (commandBelts_[i].node_)
+            commandBelts_[i].node_->Remove();
+    }
+    commandBelts_.Clear();
 }
 
 void StaticScene::HandleNetworkMessage(StringHash eventType, VariantMap& eventData)
@@ -675,117 +1024,377 @@ void StaticScene::HandleNetworkMessage(StringHash eventType, VariantMap& eventDa
         int msgID = eventData[P_MESSAGEID].GetInt();
         Connection* remoteSender = static_cast<Connection*>(eventData[P_CONNECTION].GetPtr());
 
+        // States come every tick, and only from the authoritative instance
+        if (msgID == MSG_STATE || msgID == MSG_FULL_STATE)
+        {
+                if (remoteSender == network->GetServerConnection())
+                {
+                        MemoryBuffer msg(eventData[P_DATA].GetBuffer());
+                        if (msgID == MSG_STATE)
+                                ApplyState(msg);
+                        else
+                                ApplyFullState(msg);
+                }
+                return;
+        }
        
         std::cout << "HandleNetworkMessage" << std::endl;
 
-        if (msgID == MSG_GAME) 
+        if (msgID == MSG_GAME || msgID == MSG_SCENE)
+        {
+                // Commands are queued and run in the next update under the frame budget. The message data is
+                // swapped into the queue rather than copied
+                PODVector<unsigned char>* data = eventData[P_DATA].GetBufferPtr();
+                if (!data)
+                        return;
+                if (msgID == MSG_GAME)
+                {
+                        // A text message holds one command per line, tokenized in place when it runs, so the buffer
+                        // gets a terminator unless the sender wrote one
+                        if (data->Empty() || data->Back() != 0)
+                                data->Push(0);
+                }
+                else if (data->Size() < 2 || data->Front() != SCENE_PROTOCOL_VERSION)
+                {
+                        URHO3D_LOGERROR("Scene commands of an unknown protocol version dropped");
+                        return;
+                }
+
+                commandQueue_.Push(QueuedMessage());
+                QueuedMessage& message = commandQueue_.Back();
+                message.id_ = msgID;
+                message.data_.Swap(*data);
+                message.position_ = msgID == MSG_SCENE ? 1 : 0;
+                message.end_ = msgID == MSG_SCENE ? message.data_.Size() : message.data_.Size() - 1;
+                queuedBytes_ += message.end_ - message.position_;
+                printf("Message received: %u bytes, %u queued\n", message.end_ - message.position_, queuedBytes_);
+        }
+}
+
+void StaticScene::ExecuteQueuedCommands()
+{
+    HiresTimer timer;
+    long long budget = (long long)(commandBudget_ * 1000.0f);
+    unsigned numExecuted = 0;
+
+    // At least one command runs per frame, so that a budget shorter than any command still makes progress. What is
+    // left over waits for the next frame
+    while (!commandQueue_.Empty() && (!numExecuted || timer.GetUSec(false) < budget))
+    {
+        QueuedMessage& message = commandQueue_.Front();
+        unsigned start = message.position_;
+        if (message.id_ == MSG_GAME)
         {
-                const PODVector<unsigned char>& data = eventData[P_DATA].GetBuffer();
-                // Use a MemoryBuffer to read the message data so that there is no unnecessary copying
-                MemoryBuffer msg(data);
-                String text = msg.ReadString();
-                char s[100],com[100];
-                int tx,tz,tnum,torient;
-                strcpy(s,text.CString());
-                printf("Message received:%s\n",s);
-        
-        // RAJOUTER DU CODE POUR DECODER ET GERER LES MESSAGES DU CLIENT
-
-            if (s[0]=='X')
+            char* s = reinterpret_cast<char*>(&message.data_.Front());
+            char* pos = s + message.position_;
+            CommandLine command;
+            if (command.TokenizeLine(pos, s + message.end_))
+                HandleTextCommand(command);
+            else
+                URHO3D_LOGERROR("Text command with too many or overlong fields dropped");
+            message.position_ = (unsigned)(pos - s);
+        }
+        else
+        {
+            // Binary commands carry no length, so the rest of a message is dropped after one that cannot be decoded
+            MemoryBuffer msg(message.data_);
+            msg.Seek(message.position_);
+            if (HandleSceneCommand(msg))
             {
+                RelaySceneCommand(&message.data_[start], msg.GetPosition() - start);
+                message.position_ = msg.GetPosition();
             }
+            else
+                message.position_ = message.end_;
         }
-}
 
+        queuedBytes_ -= message.position_ - start;
+        ++numExecuted;
+        if (message.position_ >= message.end_)
+            commandQueue_.PopFront();
+    }
+    FlushRelay();
 
-// ===================================================================
+    DebugHud* debugHud = GetSubsystem<DebugHud>();
+    if (debugHud)
+    {
+        debugHud->SetAppStats("Command queue", String(commandQueue_.Size()) + " messages, " + String(queuedBytes_) +
+            " bytes");
+        debugHud->SetAppStats("Command drain", String(numExecuted) + " commands in " +
+            String(timer.GetUSec(false) / 1000.0f) + " ms");
+    }
+}
 
-void StaticScene::CreateObject(char *uniqname,
-        Vector3& pos, Vector3& scale, Quaternion& quat,
-        char *model, char *material1, char *material2, int visible)
+/// Return a null-terminated name in place in a message and skip it, or null if the message ends first.
+static const char* ReadName(MemoryBuffer& msg)
 {
+    const char* name = reinterpret_cast<const char*>(msg.GetData()) + msg.GetPosition();
+    const char* end = static_cast<const char*>(memchr(name, 0, msg.GetSize() - msg.GetPosition()));
+    if (!end)
+    {
+        msg.Seek(msg.GetSize());
+        return 0;
+    }
+    msg.Seek(msg.GetPosition() + (unsigned)(end - name) + 1);
+    return name;
+}
 
-        Node* oNode = scene_->CreateChild(uniqname);
-        oNode->SetPosition(pos);
-        oNode->SetScale(scale);
-        oNode->SetRotation(quat);
-        StaticModel* oObject = oNode->CreateComponent<StaticModel>();
-        char oModel[100];
-        sprintf(oModel,"Models/%s",model);
-        oObject->SetModel(cache->GetResource<Model>(oModel));
-        char oMaterial1[100];
-        sprintf(oMaterial1,"Materials/%s",material1);
-        Material *mm1=cache->GetResource<Material>(oMaterial1);
-        oObject->SetMaterial(cache->GetResource<Material>(oMaterial1));
-        char oMaterial2[100];
-        sprintf(oMaterial2,"Materials/%s",material2);
-        Material *mm2=cache->GetResource<Material>(oMaterial2);
-
-        oObject->SetMaterial(mm1);
-
-        if (visible==1)
+bool StaticScene::HandleSceneCommand(MemoryBuffer& msg)
+{
+    // Every command ends with a name, or is checked for its last vector: a truncated message reads no further than
+    // its end, so a complete last field means all the others were complete too
+    unsigned char opcode = msg.ReadUByte();
+    switch (opcode)
+    {
+    case SCENE_CREATE_OBJECT:
+        {
+            const char* name = ReadName(msg);
+            Vector3 position = msg.ReadVector3();
+            Vector3 scale = msg.ReadVector3();
+            Vector3 rotation = msg.ReadVector3();
+            const char* model = ReadName(msg);
+            const char* material = ReadName(msg);
+            if (material)
+            {
+                CreateObject(name, position, scale, Quaternion(rotation.x_, rotation.y_, rotation.z_),
+                    resources_->InternModel(model), resources_->InternMaterial(material));
+                return true;
+            }
+        }
+        break;
+
+    case SCENE_CREATE_OBJECT_AT_POINT:
         {
-                oObject->SetMaterial(mm1);
-                //oNode->SetEnabled(true);
+            const char* name = ReadName(msg);
+            const char* pointName = ReadName(msg);
+            Vector3 scale = msg.ReadVector3();
+            Vector3 rotation = msg.ReadVector3();
+            const char* model = ReadName(msg);
+            const char* material = ReadName(msg);
+            if (material)
+            {
+                CreateObjectAtPoint(name, pointName, scale, Quaternion(rotation.x_, rotation.y_, rotation.z_),
+                    resources_->InternModel(model), resources_->InternMaterial(material));
+                return true;
+            }
         }
-        else
+        break;
+
+    case SCENE_CREATE_POINT:
         {
-                oObject->SetMaterial(mm2);
-                //oNode->SetEnabled(false);
+            const char* name = ReadName(msg);
+            if (name && msg.GetSize() - msg.GetPosition() >= sizeof(Vector3))
+            {
+                CreatePoint(name, new Vector3(msg.ReadVector3()));
+                return true;
+            }
         }
+        break;
 
-        nodeMap.insert(std::make_pair(uniqname,oNode));
+    case SCENE_MOVE_OBJECT_TO_POINT:
+        {
+            const char* name = ReadName(msg);
+            const char* pointName = ReadName(msg);
+            if (pointName)
+            {
+                moveObjectToPoint(name, pointName);
+                return true;
+            }
+        }
+        break;
+
+    default:
+        URHO3D_LOGERRORF("Unknown scene command opcode %u, rest of the message dropped", opcode);
+        return false;
+    }
+
+    URHO3D_LOGERRORF("Truncated scene command of opcode %u dropped", opcode);
+    return false;
 }
 
-void StaticScene::CreateObjectAtPoint(char *uniqname, char *pointname,
-        Vector3& scale, Quaternion& quat,
-        char *model, char *material1, char *material2, int visible)
+/// Text command handler, called with the tokens of a command, opcode first.
+typedef void (StaticScene::*TextCommandHandler)(const CommandLine& command);
+
+/// Text command opcode table entry.
+struct TextCommand
 {
-        Node* oNode = scene_->CreateChild(uniqname);
-	Vector3 *n=pointMap[pointname];
-        oNode->SetPosition(*n);
-        oNode->SetScale(scale);
-        oNode->SetRotation(quat);
-        StaticModel* oObject = oNode->CreateComponent<StaticModel>();
-        char oModel[100];
-        sprintf(oModel,"Models/%s",model);
-        oObject->SetModel(cache->GetResource<Model>(oModel));
-        char oMaterial1[100];
-        sprintf(oMaterial1,"Materials/%s",material1);
-        Material *mm1=cache->GetResource<Material>(oMaterial1);
-        oObject->SetMaterial(cache->GetResource<Material>(oMaterial1));
-        char oMaterial2[100];
-        sprintf(oMaterial2,"Materials/%s",material2);
-        Material *mm2=cache->GetResource<Material>(oMaterial2);
-
-        oObject->SetMaterial(mm1);
-
-        if (visible==1)
+    /// Opcode, the first token.
+    const char* opcode_;
+    /// Fewest tokens, opcode included.
+    unsigned minTokens_;
+    /// Most tokens, opcode included.
+    unsigned maxTokens_;
+    /// Whether the command is passed on to the render nodes.
+    bool relayed_;
+    /// Handler.
+    TextCommandHandler handler_;
+};
+
+void StaticScene::HandleTextCommand(const CommandLine& command)
+{
+    // Handlers may index every token up to the minimum count without checking. Only the commands building the scene
+    // are passed on: render nodes get the clock and debris field through the state, and never run the budget command,
+    // since their only source of commands is the authoritative instance. A belt is passed on by its handler, once
+    // created, with every argument and the seed written out
+    static const TextCommand commands[] =
+    {
+        { "OB", 15, 15, true, &StaticScene::CreateObjectFromString },
+        { "OP", 13, 13, true, &StaticScene::CreateObjectAtPointFromString },
+        { "PT", 5, 5, true, &StaticScene::CreatePointFromString },
+        { "MO", 3, 3, true, &StaticScene::moveObjectToPointFromString },
+        { "TR", 2, 2, false, &StaticScene::SetTimeRateFromString },
+        { "TS", 4, 7, false, &StaticScene::SeekDateFromString },
+        { "NB", 4, 5, false, &StaticScene::CreateDebrisFieldFromString },
+        { "AB", 4, 7, false, &StaticScene::CreateBeltFromString },
+        { "QB", 2, 2, false, &StaticScene::SetCommandBudgetFromString }
+    };
+
+    // An empty command, or X which ends the client session, does nothing
+    if (!command.GetNumTokens() || !strcmp(command.GetToken(0), "X"))
+        return;
+
+    for (unsigned i = 0; i < sizeof(commands) / sizeof(commands[0]); ++i)
+    {
+        const TextCommand& entry = commands[i];
+        if (strcmp(command.GetToken(0), entry.opcode_))
+            continue;
+        if (command.GetNumTokens() >= entry.minTokens_ && command.GetNumTokens() <= entry.maxTokens_)
         {
-                oObject->SetMaterial(mm1);
+            (this->*entry.handler_)(command);
+            if (entry.relayed_)
+                RelayTextCommand(command);
         }
         else
+            URHO3D_LOGERRORF("Text command %s with %u fields dropped", entry.opcode_, command.GetNumTokens() - 1);
+        return;
+    }
+
+    URHO3D_LOGERRORF("Unknown text command %s dropped", command.GetToken(0));
+}
+
+void StaticScene::RelayTextCommand(const CommandLine& command)
+{
+    if (renderNodes_.Empty())
+        return;
+
+    // The tokens were split in place, so the line is put back together, one space between tokens
+    if (relayMessageID_ != MSG_GAME)
+    {
+        FlushRelay();
+        relayMessageID_ = MSG_GAME;
+    }
+    for (unsigned i = 0; i < command.GetNumTokens(); ++i)
+    {
+        const char* token = command.GetToken(i);
+        relayMessage_.Write(token, strlen(token));
+        relayMessage_.WriteUByte(i + 1 < command.GetNumTokens() ? ' ' : '\n');
+    }
+    if (relayMessage_.GetSize() >= COMMAND_BATCH_SIZE)
+        FlushRelay();
+}
+
+void StaticScene::RelayTextLine(const String& line)
+{
+    if (renderNodes_.Empty())
+        return;
+
+    if (relayMessageID_ != MSG_GAME)
+    {
+        FlushRelay();
+        relayMessageID_ = MSG_GAME;
+    }
+    relayMessage_.Write(line.CString(), line.Length());
+    relayMessage_.WriteUByte('\n');
+    if (relayMessage_.GetSize() >= COMMAND_BATCH_SIZE)
+        FlushRelay();
+}
+
+void StaticScene::RelaySceneCommand(const unsigned char* data, unsigned size)
+{
+    if (renderNodes_.Empty())
+        return;
+
+    if (relayMessageID_ != MSG_SCENE)
+    {
+        FlushRelay();
+        relayMessageID_ = MSG_SCENE;
+        relayMessage_.WriteUByte(SCENE_PROTOCOL_VERSION);
+    }
+    relayMessage_.Write(data, size);
+    if (relayMessage_.GetSize() >= COMMAND_BATCH_SIZE)
+        FlushRelay();
+}
+
+void StaticScene::FlushRelay()
+{
+    // Reliable and ordered like the commands themselves, text and binary batches in the order they ran
+    if (relayMessage_.GetSize())
+    {
+        for (unsigned i = 0; i < renderNodes_.Size(); ++i)
         {
-                oObject->SetMaterial(mm2);
+            if (renderNodes_[i])
+                renderNodes_[i]->SendMessage(relayMessageID_, true, true, relayMessage_);
         }
+    }
+    relayMessage_.Clear();
+    relayMessageID_ = 0;
+}
+
+
+// ===================================================================
 
+void StaticScene::CreateObject(const char *uniqname,
+        const Vector3& pos, const Vector3& scale, const Quaternion& quat,
+        unsigned model, unsigned material)
+{
+        Node* oNode = worldNode->CreateChild(uniqname);
+        oNode->SetPosition(pos);
+        oNode->SetScale(scale);
+        oNode->SetRotation(quat);
+        // Cards go to the atlas batch; anything it does not hold is drawn on its own
+        Model* oModel = resources_->GetModel(model);
+        Material* oMaterial = resources_->GetMaterial(material);
+        if (!objects_ || !objects_->AddObject(oNode, oModel, oMaterial))
+        {
+            StaticModel* oObject = oNode->CreateComponent<StaticModel>();
+            oObject->SetModel(oModel);
+            oObject->SetMaterial(oMaterial);
+        }
+
+        ObjectResources objectResources = { model, material };
         nodeMap.insert(std::make_pair(uniqname,oNode));
+        objectResources_.insert(std::make_pair(uniqname,objectResources));
 }
 
-void StaticScene::CreateObjectFromString(char *command)
+void StaticScene::CreateObjectAtPoint(const char *uniqname, const char *pointname,
+        const Vector3& scale, const Quaternion& quat,
+        unsigned model, unsigned material)
+{
+        std::map<std::string, Vector3*>::iterator n=pointMap.find(pointname);
+        if (n==pointMap.end())
+        {
+                URHO3D_LOGERRORF("Unknown point %s", pointname);
+                return;
+        }
+        CreateObject(uniqname,*n->second,scale,quat,model,material);
+}
+
+void StaticScene::CreateObjectFromString(const CommandLine& command)
 {
         float posx, posy, posz;
         float scalex, scaley, scalez;
         float quatx, quaty, quatz;
-        char uniqname[100];
-        char model[100];
-        char material1[100];
-        char material2[100];
+        const char* uniqname = command.GetToken(1);
+        const char* model = command.GetToken(11);
+        const char* material1 = command.GetToken(12);
+        const char* material2 = command.GetToken(13);
         int vis;
 
-        sscanf(command+3,"%s %f %f %f %f %f %f %f %f %f %s %s %s %d",
-                uniqname, &posx, &posy, &posz, &scalex, &scaley, &scalez,
-                &quatx, &quaty, &quatz, model, material1, material2, &vis);
+        if (!command.GetFloat(2,posx) || !command.GetFloat(3,posy) || !command.GetFloat(4,posz) ||
+                !command.GetFloat(5,scalex) || !command.GetFloat(6,scaley) || !command.GetFloat(7,scalez) ||
+                !command.GetFloat(8,quatx) || !command.GetFloat(9,quaty) || !command.GetFloat(10,quatz) ||
+                !command.GetInt(14,vis))
+                return;
 
         printf("CreateObjectFromString %s %f %f %f %f %f %f %f %f %f %s %s %s %d\n",
                 uniqname, posx, posy, posz, scalex, scaley, scalez,
@@ -795,23 +1404,26 @@ void StaticScene::CreateObjectFromString(char *command)
         Vector3 scale(scalex,scaley,scalez);
         Quaternion quat(quatx,quaty,quatz);
 
-        CreateObject(uniqname,pos,scale,quat,model,material1,material2,vis);
+        // Only the material shown is resolved: the first one when visible, else the second
+        CreateObject(uniqname,pos,scale,quat,resources_->InternModel(model),
+                resources_->InternMaterial(vis==1 ? material1 : material2));
 }
 
-void StaticScene::CreateObjectAtPointFromString(char *command)
+void StaticScene::CreateObjectAtPointFromString(const CommandLine& command)
 {
         float scalex, scaley, scalez;
         float quatx, quaty, quatz;
-        char uniqname[100];
-        char pointname[100];
-        char model[100];
-        char material1[100];
-        char material2[100];
+        const char* uniqname = command.GetToken(1);
+        const char* pointname = command.GetToken(2);
+        const char* model = command.GetToken(9);
+        const char* material1 = command.GetToken(10);
+        const char* material2 = command.GetToken(11);
         int vis;
 
-        sscanf(command+3,"%s %s %f %f %f %f %f %f %s %s %s %d",
-                uniqname, pointname, &scalex, &scaley, &scalez,
-                &quatx, &quaty, &quatz, model, material1, material2, &vis);
+        if (!command.GetFloat(3,scalex) || !command.GetFloat(4,scaley) || !command.GetFloat(5,scalez) ||
+                !command.GetFloat(6,quatx) || !command.GetFloat(7,quaty) || !command.GetFloat(8,quatz) ||
+                !command.GetInt(12,vis))
+                return;
 
         printf("CreateObjectAtPointFromString %s %s %f %f %f %f %f %f %s %s %s %d\n",
                 uniqname, pointname, scalex, scaley, scalez,
@@ -820,44 +1432,34 @@ void StaticScene::CreateObjectAtPointFromString(char *command)
         Vector3 scale(scalex,scaley,scalez);
         Quaternion quat(quatx,quaty,quatz);
 
-        CreateObjectAtPoint(uniqname,pointname,scale,quat,model,material1,material2,vis);
+        CreateObjectAtPoint(uniqname,pointname,scale,quat,resources_->InternModel(model),
+                resources_->InternMaterial(vis==1 ? material1 : material2));
 }
 
-Vector3* StaticScene::CreatePoint(char *uniqname, Vector3 *pos)
+Vector3* StaticScene::CreatePoint(const char *uniqname, Vector3 *pos)
 {
         pointMap.insert(std::make_pair(uniqname,pos));
 	return pos;
 }
 
-Vector3* StaticScene::CreatePointFromString(char *command)
+void StaticScene::CreatePointFromString(const CommandLine& command)
 {
         float posx, posy, posz;
-        float scalex, scaley, scalez;
-        float quatx, quaty, quatz;
-        char uniqname[100];
-        char model[100];
-        char material1[100];
-        char material2[100];
-        int vis;
+        const char* uniqname = command.GetToken(1);
 
-        sscanf(command+3,"%s %f %f %f",
-                uniqname, &posx, &posy, &posz);
+        if (!command.GetFloat(2,posx) || !command.GetFloat(3,posy) || !command.GetFloat(4,posz))
+                return;
 
         printf("CreatePointFromString %s %f %f %f\n",
                 uniqname, posx, posy, posz);
 
-        Vector3 *pos=new Vector3(posx,posy,posz);
-
-        return CreatePoint(uniqname,pos);
+        CreatePoint(uniqname,new Vector3(posx,posy,posz));
 }
 
-void StaticScene::moveObjectToPointFromString(char *command)
+void StaticScene::moveObjectToPointFromString(const CommandLine& command)
 {
-        char uniqname[100];
-        char pointname[100];
-
-        sscanf(command+3,"%s %s",
-                uniqname, pointname);
+        const char* uniqname = command.GetToken(1);
+        const char* pointname = command.GetToken(2);
 
         printf("moveObjectToPointFromString %s %s\n",
                 uniqname, pointname);
@@ -865,11 +1467,221 @@ void StaticScene::moveObjectToPointFromString(char *command)
 	moveObjectToPoint(uniqname, pointname);
 }
 
-void StaticScene::moveObjectToPoint(char *uniqname, char *pointname)
+void StaticScene::moveObjectToPoint(const char *uniqname, const char *pointname)
 {
 	std::cout << "moveObjectToPoint " << uniqname << "," << pointname << std::endl;
 
-        Node* oNode = nodeMap[uniqname];
-	Vector3 *n=pointMap[pointname]; 
-        oNode->SetPosition(*n);
+        std::map<std::string, Node*>::iterator oNode = nodeMap.find(uniqname);
+        std::map<std::string, Vector3*>::iterator n = pointMap.find(pointname);
+        if (oNode==nodeMap.end() || n==pointMap.end())
+        {
+                URHO3D_LOGERRORF("Unknown object %s or point %s", uniqname, pointname);
+                return;
+        }
+        oNode->second->SetPosition(*n->second);
+}
+
+void StaticScene::SetTimeRateFromString(const CommandLine& command)
+{
+        double rate;
+
+        if (!command.GetDouble(1,rate))
+                return;
+
+        printf("SetTimeRateFromString %g\n", rate);
+
+        GetSubsystem<SimulationClock>()->SetRate(rate);
+}
+
+void StaticScene::SetCommandBudgetFromString(const CommandLine& command)
+{
+        float budget;
+
+        if (!command.GetFloat(1,budget) || budget<0.0f)
+                return;
+
+        printf("SetCommandBudgetFromString %g ms\n", budget);
+
+        commandBudget_ = budget;
+}
+
+void StaticScene::SeekDateFromString(const CommandLine& command)
+{
+        int year, month, day;
+        int hour=0, minute=0;
+        double second=0.0;
+
+        // The time of day is optional, each field defaulting to zero
+        if (!command.GetInt(1,year) || !command.GetInt(2,month) || !command.GetInt(3,day) ||
+                (command.GetNumTokens()>4 && !command.GetInt(4,hour)) ||
+                (command.GetNumTokens()>5 && !command.GetInt(5,minute)) ||
+                (command.GetNumTokens()>6 && !command.GetDouble(6,second)))
+                return;
+
+        printf("SeekDateFromString %04d-%02d-%02d %02d:%02d:%06.3f\n",
+                year, month, day, hour, minute, second);
+
+        GetSubsystem<SimulationClock>()->SeekDate(year,month,day,hour,minute,second);
+}
+
+AsteroidBelt* StaticScene::CreateBelt(const char* name, unsigned count, double innerRadius, double outerRadius,
+        float maxEccentricity, float maxInclination, unsigned seed)
+{
+        // Belts are drawn in render space directly, so they hang from the scene root rather than the world root
+        Node* beltNode = scene_->CreateChild(name);
+        AsteroidBelt* belt = beltNode->CreateComponent<AsteroidBelt>();
+        belt->SetModel(cache->GetResource<Model>("Models/Box.mdl"));
+        belt->SetMaterial(cache->GetResource<Material>("Materials/StoneSmall.xml"));
+        belt->Generate(count, innerRadius * UNITS_PER_AU, outerRadius * UNITS_PER_AU, maxEccentricity, maxInclination,
+                BELT_BODY_MIN_SIZE, BELT_BODY_MAX_SIZE, seed);
+        return belt;
+}
+
+void StaticScene::CreateCommandBelt(BeltArguments& arguments)
+{
+        AsteroidBelt* belt = CreateBelt("Belt", arguments.count_, arguments.innerRadius_, arguments.outerRadius_,
+                arguments.maxEccentricity_, arguments.maxInclination_, arguments.seed_);
+        arguments.node_ = belt->GetNode();
+        commandBelts_.Push(arguments);
+        printf("%u bodies in %u chunks\n", belt->GetNumBodies(), belt->GetNumChunks());
+}
+
+void StaticScene::CreateBeltFromString(const CommandLine& command)
+{
+        int count;
+        double innerRadius, outerRadius;
+        double eccentricity=0.1, inclination=10.0;
+        int seed=0;
+
+        // The optional seed picks the belt among those of the same arguments; every instance given it builds the same
+        if (!command.GetInt(1,count) || !command.GetDouble(2,innerRadius) || !command.GetDouble(3,outerRadius) ||
+                (command.GetNumTokens()>4 && !command.GetDouble(4,eccentricity)) ||
+                (command.GetNumTokens()>5 && !command.GetDouble(5,inclination)) ||
+                (command.GetNumTokens()>6 && !command.GetInt(6,seed)) || count<=0)
+                return;
+
+        if ((unsigned)count > MAX_BELT_SIZE)
+        {
+                URHO3D_LOGERRORF("Belt of %d bodies dropped, at most %u allowed", count, MAX_BELT_SIZE);
+                return;
+        }
+
+        printf("CreateBeltFromString %d %g-%g AU\n", count, innerRadius, outerRadius);
+
+        BeltArguments arguments;
+        arguments.count_ = (unsigned)count;
+        arguments.innerRadius_ = innerRadius;
+        arguments.outerRadius_ = outerRadius;
+        arguments.maxEccentricity_ = (float)eccentricity;
+        arguments.maxInclination_ = (float)inclination;
+        arguments.seed_ = (unsigned)seed;
+        CreateCommandBelt(arguments);
+
+        // Defaults may differ between builds, so the render nodes get every argument, exactly, and the seed
+        RelayTextLine(ToString("AB %d %.17g %.17g %.17g %.17g %d", count, innerRadius, outerRadius, eccentricity,
+                inclination, seed));
+}
+
+void StaticScene::CreateDebrisFieldFromString(const CommandLine& command)
+{
+        int count;
+        double innerRadius, outerRadius;
+        double inclination=0.0;
+
+        if (!command.GetInt(1,count) || !command.GetDouble(2,innerRadius) || !command.GetDouble(3,outerRadius) ||
+                (command.GetNumTokens()>4 && !command.GetDouble(4,inclination)) || count<=0)
+                return;
+
+        NBodySystem* nbodySystem = scene_->GetComponent<NBodySystem>();
+        if ((unsigned)count > MAX_DEBRIS_PARTICLES - Min(nbodySystem->GetNumParticles(), MAX_DEBRIS_PARTICLES))
+        {
+                URHO3D_LOGERRORF("Debris field of %d particles dropped, %u of at most %u already in the scene", count,
+                        nbodySystem->GetNumParticles(), MAX_DEBRIS_PARTICLES);
+                return;
+        }
+
+        printf("CreateDebrisFieldFromString %d %g-%g AU\n", count, innerRadius, outerRadius);
+
+        // Test particles on near-circular prograde orbits in the ecliptic, radii in AU and inclination spread in degrees.
+        // Scene Y is the ecliptic pole; prograde motion turns from +X towards +Z
+        for (int i=0; i<count; i++)
+        {
+                double radius = Lerp(innerRadius, outerRadius, (double)Random()) * UNITS_PER_AU;
+                double angle = Random(360.0f) * DOUBLE_DEGTORAD;
+                double tilt = Random((float)-inclination, (float)inclination) * DOUBLE_DEGTORAD;
+                double speed = sqrt(SUN_GRAVITATIONAL_PARAMETER / radius);
+                DoubleVector3 radial(cos(angle), 0.0, sin(angle));
+                DoubleVector3 prograde(-sin(angle) * cos(tilt), sin(tilt), cos(angle) * cos(tilt));
+                nbodySystem->AddParticle(radial * radius, prograde * speed);
+        }
+}
+
+void StaticScene::BenchmarkCatalog(unsigned count)
+{
+        // Synthetic catalog of planets around a central body, each with a satellite, cycling through a few materials
+        // the way the real catalog does. It is loaded and instantiated into a scratch scene, leaving the shown one alone.
+        // It is built in one go and rewrites the snapshot file, so only the -benchmark argument runs it, at startup
+        static const char* materials[] = { "Materials/earthmap.xml", "bin/Data/Materials/marsmap.xml",
+                "bin/Data/Materials/moonmap.xml", "bin/Data/Materials/jupitermap.xml" };
+
+        SharedPtr<XMLFile> file(new XMLFile(context_));
+        XMLElement root = file->CreateRoot("catalog");
+        XMLElement center = root.CreateChild("body");
+        center.SetAttribute("name", "Center");
+        center.SetAttribute("rotationPeriod", "600");
+        for (unsigned i=0; i<count; i++)
+        {
+                XMLElement body = center.CreateChild("body");
+                body.SetAttribute("name", "Planet" + String(i));
+                body.SetAttribute("scale", "5");
+                body.SetAttribute("tilt", String(Random(90.0f)));
+                body.SetAttribute("rotationPeriod", String(Random(10.0f, 1000.0f)));
+                XMLElement orbit = body.CreateChild("orbit");
+                orbit.SetAttribute("semiMajorAxis", String(Random(0.3f, 40.0f)));
+                orbit.SetAttribute("eccentricity", String(Random(0.25f)));
+                orbit.SetAttribute("inclination", String(Random(10.0f)));
+                orbit.SetAttribute("period", String(Random(80.0f, 90000.0f)));
+                XMLElement model = body.CreateChild("model");
+                model.SetAttribute("file", SPHERE_MODEL_NAME);
+                model.SetAttribute("material", materials[i % 4]);
+
+                XMLElement satellite = body.CreateChild("body");
+                satellite.SetAttribute("name", "Satellite" + String(i));
+                satellite.SetAttribute("scale", "2");
+                XMLElement satelliteOrbit = satellite.CreateChild("orbit");
+                satelliteOrbit.SetAttribute("semiMajorAxis", "0.002");
+                satelliteOrbit.SetAttribute("period", String(Random(1.0f, 30.0f)));
+                XMLElement satelliteModel = satellite.CreateChild("model");
+                satelliteModel.SetAttribute("file", SPHERE_MODEL_NAME);
+                satelliteModel.SetAttribute("material", materials[(i + 2) % 4]);
+        }
+
+        SharedPtr<Scene> scratch(new Scene(context_));
+        scratch->CreateComponent<Octree>();
+        scratch->CreateComponent<OrbitSystem>();
+        Node* scratchWorld = scratch->CreateChild("World");
+
+        SharedPtr<SolarCatalog> catalog(new SolarCatalog(context_));
+        if (!catalog->LoadXML(root))
+                return;
+        catalog->Instantiate(scratch, scratchWorld);
+
+        printf("BenchmarkCatalog %u bodies: load %lld us, instantiate %lld us\n",
+                catalog->GetNumBodies(), catalog->GetLoadTime(), catalog->GetInstantiateTime());
+
+        // The same content through a binary snapshot, mapped back into a second scratch scene
+        String snapshotName = GetSubsystem<FileSystem>()->GetAppPreferencesDir("urho3d", "snapshots") +
+                "Benchmark.snap";
+        SharedPtr<SceneSnapshot> snapshot(new SceneSnapshot(context_));
+        if (!snapshot->Save(scratch, snapshotName))
+                return;
+
+        SharedPtr<Scene> restored(new Scene(context_));
+        restored->CreateComponent<Octree>();
+        restored->CreateComponent<OrbitSystem>();
+        if (!snapshot->Load(snapshotName) || !snapshot->Instantiate(restored))
+                return;
+
+        printf("BenchmarkCatalog %u nodes: snapshot load %lld us, instantiate %lld us\n",
+                snapshot->GetNumNodes(), snapshot->GetLoadTime(), snapshot->GetInstantiateTime());
 }
@@ -24,6 +24,10 @@
 
 #include "Sample.h"
 
+#include <Urho3D/Container/List.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/IO/VectorBuffer.h>
+
 #include <iostream>
 #include <list>
 #include <vector>
@@ -34,11 +38,62 @@
 namespace Urho3D
 {
 
+class Connection;
+class Deserializer;
+class MemoryBuffer;
 class Node;
 class Scene;
+class Serializer;
 
 }
 
+class AsteroidBelt;
+class AtlasBatch;
+class CommandLine;
+class ResourceTable;
+class SolarCatalog;
+
+/// Received network message of commands waiting to run.
+struct QueuedMessage
+{
+    /// Message ID, MSG_GAME for text or MSG_SCENE for binary commands.
+    int id_;
+    /// Message data. Text ends with a terminator.
+    PODVector<unsigned char> data_;
+    /// Offset of the next command.
+    unsigned position_;
+    /// Offset of the end of the commands.
+    unsigned end_;
+};
+
+/// Model and material of an object created by a command, by resource table handle.
+struct ObjectResources
+{
+    /// Model handle.
+    unsigned model_;
+    /// Material handle.
+    unsigned material_;
+};
+
+/// Arguments of a belt created by a command, from which any instance generates the same belt.
+struct BeltArguments
+{
+    /// Belt node.
+    WeakPtr<Node> node_;
+    /// Number of bodies.
+    unsigned count_;
+    /// Inner radius in AU.
+    double innerRadius_;
+    /// Outer radius in AU.
+    double outerRadius_;
+    /// Largest orbit eccentricity.
+    float maxEccentricity_;
+    /// Largest orbit inclination in degrees.
+    float maxInclination_;
+    /// Random seed.
+    unsigned seed_;
+};
+
 struct _directions
 {
 	char *n; int nt;
@@ -78,25 +133,120 @@ private:
     void HandleUpdate(StringHash eventType, VariantMap& eventData);
     /// Manage joystick.
     void ManageJoystick(float timeStep);
+    /// Read simulation clock keys: warp, reverse, pause and back to now.
+    void ManageTimeKeys();
 
         void HandleNetworkMessage(StringHash eventType, VariantMap& eventData);
+    /// Run queued commands until the frame's time budget is spent, and show the queue metrics on the debug HUD.
+    void ExecuteQueuedCommands();
+    /// Decode and execute the next binary scene command of a message. Return false if it could not be decoded.
+    bool HandleSceneCommand(MemoryBuffer& msg);
+    /// Execute a tokenized text command through the opcode table.
+    void HandleTextCommand(const CommandLine& command);
+    /// Add a text command that ran to the batch passed on to the render nodes.
+    void RelayTextCommand(const CommandLine& command);
+    /// Add a text command line that ran, without its line feed, to the batch passed on to the render nodes.
+    void RelayTextLine(const String& line);
+    /// Add a binary scene command that ran to the batch passed on to the render nodes.
+    void RelaySceneCommand(const unsigned char* data, unsigned size);
+    /// Send the batch of commands passed on to the render nodes.
+    void FlushRelay();
         void HandleClientConnected(StringHash eventType, VariantMap& eventData);
         void HandleClientDisconnected(StringHash eventType, VariantMap& eventData);
+    /// Handle a client identifying itself, registering render nodes.
+    void HandleClientIdentity(StringHash eventType, VariantMap& eventData);
+    /// Handle a render node reaching the authoritative instance.
+    void HandleServerConnected(StringHash eventType, VariantMap& eventData);
+    /// Handle a render node losing or failing to reach the authoritative instance.
+    void HandleServerDisconnected(StringHash eventType, VariantMap& eventData);
+    /// Handle a simulation clock tick or seek, after which a state is due.
+    void HandleSimulationTick(StringHash eventType, VariantMap& eventData);
+    /// Handle the logic post-update event, sending the state to the render nodes if one is due.
+    void HandlePostUpdate(StringHash eventType, VariantMap& eventData);
+    /// Connect to the authoritative instance as a render node.
+    void ConnectToAuthority();
+    /// Send the simulation state of the last tick to the render nodes.
+    void SendState();
+    /// Send the particles with their velocities to a render node, or to all of them if null. A single render node,
+    /// which is connecting, also gets the points, objects and belts created by commands.
+    void SendFullState(Connection* connection);
+    /// Apply a simulation state received from the authoritative instance, replicating the simulation from then on.
+    void ApplyState(MemoryBuffer& msg);
+    /// Apply the particles with their velocities received from the authoritative instance, and the points, objects
+    /// and belts created by commands if they follow.
+    void ApplyFullState(MemoryBuffer& msg);
+    /// Write the points, objects and belts created by commands.
+    void WriteSceneContent(Serializer& dest) const;
+    /// Replace the points, objects and belts created by commands with those read.
+    void ReadSceneContent(Deserializer& source);
+    /// Remove the points, objects and belts created by commands.
+    void RemoveSceneContent();
 
 
-    void CreateObject(char* uniqname, Vector3& pos, Vector3& scale, Quaternion& quat, char *model, char *material1,char *material2, int visible);
-    void CreateObjectAtPoint(char *uniqname, char *pointname, Vector3& scale, Quaternion& quat, char *model, char *material1, char *material2, int visible);
+    /// Create an object from model and material handles of the resource table.
+    void CreateObject(const char* uniqname, const Vector3& pos, const Vector3& scale, const Quaternion& quat,
+        unsigned model, unsigned material);
+    /// Create an object at a named point from model and material handles of the resource table.
+    void CreateObjectAtPoint(const char *uniqname, const char *pointname, const Vector3& scale, const Quaternion& quat,
+        unsigned model, unsigned material);
 
-    void CreateObjectFromString(char *str);
-    Vector3 *CreatePoint(char* uniqname, Vector3 *pos);
-    Vector3 *CreatePointFromString(char *str);
-    void CreateObjectAtPointFromString(char *command);
-    void moveObjectToPointFromString(char *command);
-    void moveObjectToPoint(char *uniqname, char *pointname);
+    void CreateObjectFromString(const CommandLine& command);
+    Vector3 *CreatePoint(const char* uniqname, Vector3 *pos);
+    void CreatePointFromString(const CommandLine& command);
+    void CreateObjectAtPointFromString(const CommandLine& command);
+    void moveObjectToPointFromString(const CommandLine& command);
+    void moveObjectToPoint(const char *uniqname, const char *pointname);
+    void SetTimeRateFromString(const CommandLine& command);
+    void SeekDateFromString(const CommandLine& command);
+    void SetCommandBudgetFromString(const CommandLine& command);
+    void CreateDebrisFieldFromString(const CommandLine& command);
+    AsteroidBelt* CreateBelt(const char* name, unsigned count, double innerRadius, double outerRadius,
+        float maxEccentricity, float maxInclination, unsigned seed);
+    /// Create a belt from command arguments and keep them, setting their node.
+    void CreateCommandBelt(BeltArguments& arguments);
+    void CreateBeltFromString(const CommandLine& command);
+    void BenchmarkCatalog(unsigned count);
 
     ResourceCache *cache;
+    SharedPtr<ResourceTable> resources_;
+    /// Batch merging the objects textured from the card atlas.
+    WeakPtr<AtlasBatch> objects_;
+    /// Received command messages, oldest first.
+    List<QueuedMessage> commandQueue_;
+    /// Time budget for running queued commands per frame, in milliseconds.
+    float commandBudget_;
+    /// Bytes of queued commands not run yet.
+    unsigned queuedBytes_;
+    /// Address of the authoritative instance for a render node, empty on the authoritative instance itself.
+    String authorityAddress_;
+    /// Connections of the render nodes, on the authoritative instance.
+    Vector<WeakPtr<Connection> > renderNodes_;
+    /// Simulation state message, reused for every one sent.
+    VectorBuffer stateMessage_;
+    /// Batch of commands that ran, passed on to the render nodes after the frame's commands.
+    VectorBuffer relayMessage_;
+    /// Message ID of the batch passed on to the render nodes, MSG_GAME or MSG_SCENE, or zero if empty.
+    int relayMessageID_;
+    /// Particle chunk sent next, as the chunks take turns within the per-tick budget.
+    unsigned nextStateChunk_;
+    /// Number of particles when they were last sent with their velocities.
+    unsigned stateParticles_;
+    /// Whether the clock ticked or seeked since the last state sent.
+    bool statePending_;
+    /// Time since the last attempt to reach the authoritative instance.
+    Timer reconnectTimer_;
+    /// Number of bodies of the main asteroid belt created at startup.
+    unsigned asteroidBeltSize_;
+    /// Number of bodies of the Kuiper belt created at startup.
+    unsigned kuiperBeltSize_;
+    /// Number of planets of the synthetic catalog benchmarked at startup, or zero.
+    unsigned benchmarkPlanets_;
     std::map<std::string, Node*> nodeMap;
     std::map<std::string, Vector3*> pointMap;
+    /// Model and material of the objects of nodeMap, by the same name.
+    std::map<std::string, ObjectResources> objectResources_;
+    /// Belts created by commands, in order.
+    Vector<BeltArguments> commandBelts_;
 
     Input* input;
     int nbJoysticks;
@@ -106,6 +256,9 @@ private:
     struct _directions possibleDirections[30];
     int cursorLocation;
 
+    SharedPtr<SolarCatalog> catalog_;
+
+    Node *worldNode;
     Node *earthPosNode;
     Node *sunPosNode;
     Node *sunPosRotNode;
@@ -0,0 +1,320 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/Graphics/Material.h>
+#include <Urho3D/Graphics/Texture2D.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Resource/Image.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Resource/ResourceEvents.h>
+#include <Urho3D/Resource/XMLFile.h>
+
+#include "TextureStreamer.h"
+
+#include <Urho3D/DebugNew.h>
+
+/// Default largest thumbnail height in pixels.
+static const int DEFAULT_THUMBNAIL_SIZE = 32;
+
+/// Reduction of a full texture image to its thumbnail and average color, run on a worker thread.
+struct ThumbnailJob : public RefCounted
+{
+    /// Texture name.
+    String name_;
+    /// Thumbnail file to save, empty if there is an up to date one.
+    String thumbnailFileName_;
+    /// Largest thumbnail height.
+    int thumbnailSize_;
+    /// Decoded image, held until the job completes.
+    SharedPtr<Image> image_;
+    /// Average image color.
+    Color averageColor_;
+    /// Whether the average color was found.
+    bool success_;
+};
+
+/// Halve an image down to a single pixel, saving the first level no higher than the thumbnail size on the way, and
+/// return its average color. Compressed images come with their mips: only the first level small enough for a
+/// thumbnail is decompressed. Only creates new images, so it can run on a worker thread while the image is shared.
+static bool ReduceImage(Image* image, int thumbnailSize, const String& thumbnailFileName, Color& color)
+{
+    if (image->GetDepth() > 1)
+        return false;
+
+    SharedPtr<Image> level;
+    if (image->IsCompressed())
+    {
+        unsigned numLevels = image->GetNumCompressedLevels();
+        if (!numLevels)
+            return false;
+        unsigned index = 0;
+        while (index + 1 < numLevels && image->GetCompressedLevel(index).height_ > thumbnailSize)
+            ++index;
+        CompressedLevel compressed = image->GetCompressedLevel(index);
+        level = new Image(image->GetContext());
+        level->SetSize(compressed.width_, compressed.height_, 4);
+        if (!compressed.Decompress(level->GetData()))
+            return false;
+        image = level;
+    }
+
+    bool saveThumbnail = !thumbnailFileName.Empty();
+    while (image->GetWidth() > 1 || image->GetHeight() > 1)
+    {
+        if (saveThumbnail && image->GetHeight() <= thumbnailSize)
+        {
+            image->SavePNG(thumbnailFileName);
+            saveThumbnail = false;
+        }
+        level = image->GetNextLevel();
+        if (!level)
+            return false;
+        image = level;
+    }
+
+    color = image->GetPixel(0, 0);
+    color.a_ = 1.0f;
+    return true;
+}
+
+static void ReduceImageWork(const WorkItem* item, unsigned threadIndex)
+{
+    ThumbnailJob* job = reinterpret_cast<ThumbnailJob*>(item->aux_);
+    job->success_ = ReduceImage(job->image_, job->thumbnailSize_, job->thumbnailFileName_, job->averageColor_);
+}
+
+TextureStreamer::TextureStreamer(Context* context) :
+    Object(context),
+    defaultPlaceholder_(new Image(context)),
+    thumbnailSize_(DEFAULT_THUMBNAIL_SIZE)
+{
+    defaultPlaceholder_->SetSize(1, 1, 3);
+    defaultPlaceholder_->SetPixel(0, 0, Color(0.5f, 0.5f, 0.5f));
+    thumbnailDir_ = GetSubsystem<FileSystem>()->GetAppPreferencesDir("urho3d", "thumbnails");
+
+    SubscribeToEvent(E_RESOURCEBACKGROUNDLOADED, URHO3D_HANDLER(TextureStreamer, HandleResourceBackgroundLoaded));
+    SubscribeToEvent(E_WORKITEMCOMPLETED, URHO3D_HANDLER(TextureStreamer, HandleWorkItemCompleted));
+}
+
+TextureStreamer::~TextureStreamer()
+{
+    // The jobs are still referenced by their work items
+    WorkQueue* queue = GetSubsystem<WorkQueue>();
+    if (queue && !thumbnailJobs_.Empty())
+        queue->Complete(0);
+}
+
+Material* TextureStreamer::GetMaterial(const String& name)
+{
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    Material* material = cache->GetExistingResource<Material>(name);
+    if (material)
+        return material;
+
+    // Create the textures first, so the material finds them in the cache instead of decoding them. Cube and volume
+    // textures are described by XML files and left to the material
+    SharedPtr<XMLFile> xml = cache->GetTempResource<XMLFile>(name, false);
+    if (xml)
+    {
+        for (XMLElement textureElem = xml->GetRoot().GetChild("texture"); textureElem;
+             textureElem = textureElem.GetNext("texture"))
+        {
+            String textureName = textureElem.GetAttribute("name");
+            if (!textureName.Empty() && GetExtension(textureName) != ".xml")
+                GetTexture(textureName);
+        }
+    }
+
+    return cache->GetResource<Material>(name);
+}
+
+Texture2D* TextureStreamer::GetTexture(const String& name)
+{
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    Texture2D* texture = cache->GetExistingResource<Texture2D>(name);
+    if (texture)
+        return texture;
+
+    SharedPtr<Texture2D> placeholder(new Texture2D(context_));
+    placeholder->SetName(name);
+    // Same sampler settings as the loaded texture would have
+    String parametersName = ReplaceExtension(name, ".xml");
+    if (cache->Exists(parametersName))
+        placeholder->SetParameters(cache->GetResource<XMLFile>(parametersName));
+    SharedPtr<Image> thumbnail = LoadThumbnail(name);
+    placeholder->SetData(thumbnail ? thumbnail : defaultPlaceholder_);
+    if (thumbnail)
+        ProcessImage(name, thumbnail);
+    cache->AddManualResource(placeholder);
+
+    String imageName = GetImageName(name);
+    pending_[imageName] = placeholder;
+    if (!cache->BackgroundLoadResource<Image>(imageName))
+        pending_.Erase(imageName);
+    return placeholder;
+}
+
+void TextureStreamer::SetThumbnailSize(int size)
+{
+    thumbnailSize_ = Max(size, 0);
+}
+
+void TextureStreamer::HandleResourceBackgroundLoaded(StringHash eventType, VariantMap& eventData)
+{
+    using namespace ResourceBackgroundLoaded;
+
+    Resource* resource = static_cast<Resource*>(eventData[P_RESOURCE].GetPtr());
+    if (resource && resource->GetType() != Image::GetTypeStatic())
+        return;
+
+    String imageName = eventData[P_RESOURCENAME].GetString();
+    HashMap<String, SharedPtr<Texture2D> >::Iterator i = pending_.Find(imageName);
+    if (i == pending_.End())
+        return;
+
+    SharedPtr<Texture2D> texture = i->second_;
+    const String& name = texture->GetName();
+    pending_.Erase(i);
+
+    Image* image = static_cast<Image*>(resource);
+    if (eventData[P_SUCCESS].GetBool() && image)
+    {
+        texture->SetData(SharedPtr<Image>(image), image->GetComponents() == 4);
+        ProcessImage(name, image);
+
+        using namespace TextureStreamed;
+
+        VariantMap& streamedData = GetEventDataMap();
+        streamedData[P_NAME] = name;
+        streamedData[P_TEXTURE] = texture.Get();
+        SendEvent(E_TEXTURESTREAMED, streamedData);
+    }
+    else
+        URHO3D_LOGWARNING("Could not stream texture " + name + ", keeping its placeholder");
+
+    // The pixels now live in the texture; drop the decoded copy
+    GetSubsystem<ResourceCache>()->ReleaseResource(Image::GetTypeStatic(), imageName, true);
+}
+
+bool TextureStreamer::GetAverageColor(const String& name, Color& color) const
+{
+    HashMap<String, Color>::ConstIterator i = averageColors_.Find(name);
+    if (i == averageColors_.End())
+        return false;
+    color = i->second_;
+    return true;
+}
+
+String TextureStreamer::GetImageName(const String& name) const
+{
+    String cookedName = GetPath(name) + "Cooked/" + GetFileName(name) + ".dds";
+    return GetSubsystem<ResourceCache>()->Exists(cookedName) ? cookedName : name;
+}
+
+SharedPtr<Image> TextureStreamer::LoadThumbnail(const String& name)
+{
+    if (!thumbnailSize_ || !IsThumbnailCurrent(name))
+        return SharedPtr<Image>();
+
+    SharedPtr<Image> thumbnail(new Image(context_));
+    File file(context_, GetThumbnailFileName(name));
+    if (!file.IsOpen() || !thumbnail->Load(file))
+        return SharedPtr<Image>();
+    return thumbnail;
+}
+
+void TextureStreamer::ProcessImage(const String& name, Image* image)
+{
+    // Thumbnails are small enough to reduce at once. A full image is only reduced when its average color is not known
+    // yet, that is when there was no up to date thumbnail, and then on a worker thread as it may be large
+    if (averageColors_.Contains(name))
+        return;
+    String thumbnailFileName = thumbnailSize_ && !IsThumbnailCurrent(name) ? GetThumbnailFileName(name) : String();
+    WorkQueue* queue = GetSubsystem<WorkQueue>();
+    if (image->GetHeight() <= thumbnailSize_ || !queue)
+    {
+        Color color;
+        if (ReduceImage(image, thumbnailSize_, thumbnailFileName, color))
+            averageColors_[name] = color;
+        return;
+    }
+
+    for (unsigned i = 0; i < thumbnailJobs_.Size(); ++i)
+    {
+        if (thumbnailJobs_[i]->name_ == name)
+            return;
+    }
+
+    SharedPtr<ThumbnailJob> job(new ThumbnailJob());
+    job->name_ = name;
+    job->thumbnailFileName_ = thumbnailFileName;
+    job->thumbnailSize_ = thumbnailSize_;
+    job->image_ = image;
+    job->success_ = false;
+    thumbnailJobs_.Push(job);
+
+    // Lowest priority, so that completing the per-frame evaluations does not wait for it
+    SharedPtr<WorkItem> item = queue->GetFreeItem();
+    item->priority_ = 0;
+    item->workFunction_ = ReduceImageWork;
+    item->aux_ = job.Get();
+    item->sendEvent_ = true;
+    queue->AddWorkItem(item);
+}
+
+void TextureStreamer::HandleWorkItemCompleted(StringHash eventType, VariantMap& eventData)
+{
+    using namespace WorkItemCompleted;
+
+    WorkItem* item = static_cast<WorkItem*>(eventData[P_ITEM].GetPtr());
+    for (Vector<SharedPtr<ThumbnailJob> >::Iterator i = thumbnailJobs_.Begin(); i != thumbnailJobs_.End(); ++i)
+    {
+        if (i->Get() == item->aux_)
+        {
+            if ((*i)->success_)
+                averageColors_[(*i)->name_] = (*i)->averageColor_;
+            thumbnailJobs_.Erase(i);
+            return;
+        }
+    }
+}
+
+bool TextureStreamer::IsThumbnailCurrent(const String& name) const
+{
+    FileSystem* fileSystem = GetSubsystem<FileSystem>();
+    String fileName = GetThumbnailFileName(name);
+    String sourceName = GetSubsystem<ResourceCache>()->GetResourceFileName(name);
+    return !sourceName.Empty() && fileSystem->FileExists(fileName) &&
+        fileSystem->GetLastModifiedTime(fileName) >= fileSystem->GetLastModifiedTime(sourceName);
+}
+
+String TextureStreamer::GetThumbnailFileName(const String& name) const
+{
+    String fileName = name;
+    fileName.Replace('/', '_');
+    return thumbnailDir_ + ReplaceExtension(fileName, ".png");
+}
@@ -0,0 +1,115 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Math/Color.h>
+
+namespace Urho3D
+{
+
+class Image;
+class Material;
+class Texture2D;
+
+}
+
+// All Urho3D classes reside in namespace Urho3D
+using namespace Urho3D;
+
+struct ThumbnailJob;
+
+/// A streamed texture received its full image.
+URHO3D_EVENT(E_TEXTURESTREAMED, TextureStreamed)
+{
+    URHO3D_PARAM(P_NAME, Name);                 // String, texture resource name
+    URHO3D_PARAM(P_TEXTURE, Texture);           // Texture2D pointer
+}
+
+/// Subsystem loading materials without waiting for their 2D textures.
+/// Before a material is loaded, each 2D texture it names is created in the resource cache as a placeholder, so the
+/// material resolves it immediately, and its image is queued for background loading: the file is read and decoded on
+/// a worker thread and only the upload happens on the main thread, within the cache's per-frame budget for finishing
+/// background loads. The placeholder is a thumbnail saved when the full image was last decoded, or a single grey
+/// pixel on the first run, so the time to the first frame does not depend on the number or size of the textures.
+/// The average color of each image, found on the way down to the thumbnail, is kept for impostors.
+/// When the texture has been cooked (tools/CookTextures, a block-compressed DDS with its mip chain in a Cooked
+/// subdirectory next to the source) the cooked file is loaded instead, which needs no decoding and no mip generation.
+class TextureStreamer : public Object
+{
+    URHO3D_OBJECT(TextureStreamer, Object);
+
+public:
+    /// Construct.
+    TextureStreamer(Context* context);
+    /// Destruct.
+    virtual ~TextureStreamer();
+
+    /// Return a material, loading it at once with placeholders for the 2D textures it names.
+    Material* GetMaterial(const String& name);
+    /// Return a 2D texture. Unless it is already in the resource cache this is a placeholder until its image is loaded.
+    Texture2D* GetTexture(const String& name);
+    /// Set largest thumbnail height in pixels. Zero disables thumbnails.
+    void SetThumbnailSize(int size);
+
+    /// Return number of textures still waiting for their image.
+    unsigned GetNumPending() const { return pending_.Size(); }
+    /// Return whether a texture is waiting for its image.
+    bool IsPending(const String& name) const { return pending_.Contains(GetImageName(name)); }
+    /// Return average color of a texture image if it is known, from the full image or its thumbnail.
+    bool GetAverageColor(const String& name, Color& color) const;
+    /// Return name of the image loaded for a texture: the cooked DDS if there is one, else the texture itself.
+    String GetImageName(const String& name) const;
+    /// Return largest thumbnail height in pixels.
+    int GetThumbnailSize() const { return thumbnailSize_; }
+
+private:
+    /// Handle background loaded resource event.
+    void HandleResourceBackgroundLoaded(StringHash eventType, VariantMap& eventData);
+    /// Return thumbnail of a texture if it is newer than the texture file.
+    SharedPtr<Image> LoadThumbnail(const String& name);
+    /// Handle work item completed event.
+    void HandleWorkItemCompleted(StringHash eventType, VariantMap& eventData);
+    /// Save thumbnail of a decoded texture image unless an up to date one exists, and store its average color. Does
+    /// nothing if the average color is known; a full image is reduced on a worker thread.
+    void ProcessImage(const String& name, Image* image);
+    /// Return whether the thumbnail of a texture is newer than the texture file.
+    bool IsThumbnailCurrent(const String& name) const;
+    /// Return thumbnail file name of a texture.
+    String GetThumbnailFileName(const String& name) const;
+
+    /// Placeholder textures waiting for their image, by image name.
+    HashMap<String, SharedPtr<Texture2D> > pending_;
+    /// Average image colors by texture name.
+    HashMap<String, Color> averageColors_;
+    /// Full images being reduced on worker threads.
+    Vector<SharedPtr<ThumbnailJob> > thumbnailJobs_;
+    /// Placeholder image used when there is no thumbnail.
+    SharedPtr<Image> defaultPlaceholder_;
+    /// Thumbnail directory.
+    String thumbnailDir_;
+    /// Largest thumbnail height.
+    int thumbnailSize_;
+};
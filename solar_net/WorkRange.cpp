@@ -0,0 +1,55 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include <Urho3D/Core/WorkQueue.h>
+
+#include "WorkRange.h"
+
+#include <Urho3D/DebugNew.h>
+
+/// Number of work items queued per thread, so that threads finishing early can pick up more work.
+static const unsigned WORKITEMS_PER_THREAD = 4;
+
+bool QueueRangeWork(WorkQueue* queue, void (*workFunction)(const WorkItem*, unsigned), void* aux, unsigned count,
+    unsigned minPerItem)
+{
+    unsigned numThreads = queue ? queue->GetNumThreads() : 0;
+    if (!numThreads || count < minPerItem * 2)
+        return false;
+
+    // The main thread joins in when the items are completed, hence one more share than worker threads
+    unsigned numItems = Min(count / minPerItem, (numThreads + 1) * WORKITEMS_PER_THREAD);
+    unsigned indicesPerItem = (count + numItems - 1) / numItems;
+
+    for (unsigned start = 0; start < count; start += indicesPerItem)
+    {
+        SharedPtr<WorkItem> item = queue->GetFreeItem();
+        item->priority_ = M_MAX_UNSIGNED;
+        item->workFunction_ = workFunction;
+        item->aux_ = aux;
+        item->start_ = (void*)(size_t)start;
+        item->end_ = (void*)(size_t)Min(start + indicesPerItem, count);
+        queue->AddWorkItem(item);
+    }
+    return true;
+}
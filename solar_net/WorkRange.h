@@ -20,31 +20,22 @@
 // THE SOFTWARE.
 //
 
+
 #pragma once
 
-#include <Urho3D/Scene/LogicComponent.h>
+namespace Urho3D
+{
+
+class WorkQueue;
+struct WorkItem;
+
+}
 
 // All Urho3D classes reside in namespace Urho3D
 using namespace Urho3D;
 
-/// Custom logic component for rotating a scene node.
-class Rotator : public LogicComponent
-{
-    URHO3D_OBJECT(Rotator, LogicComponent);
-    
-public:
-    /// Construct.
-    Rotator(Context* context);
-    
-    /// Set rotation speed about the Euler axes. Will be scaled with scene update time step.
-    void SetRotationSpeed(const Vector3& speed);
-    /// Handle scene update. Called by LogicComponent base class.
-    virtual void Update(float timeStep);
-    
-    /// Return rotation speed.
-    const Vector3& GetRotationSpeed() const { return rotationSpeed_; }
-    
-private:
-    /// Rotation speed.
-    Vector3 rotationSpeed_;
-};
+/// Split the index range [0, count) into work items of at least minPerItem indices and add them to the work queue. The
+/// items hold their index range in start_ and end_, and aux in aux_. Return false, queueing nothing, when there are no
+/// worker threads or fewer than two items' worth of indices: the caller then processes the range on the main thread.
+bool QueueRangeWork(WorkQueue* queue, void (*workFunction)(const WorkItem*, unsigned), void* aux, unsigned count,
+    unsigned minPerItem);
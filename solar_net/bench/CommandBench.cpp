@@ -0,0 +1,222 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+// Text command benchmark: parses the same batch of scene commands with the previous copy-and-sscanf path, one line at a
+// time, and with the in-place tokenizer and opcode table of CommandParser over the whole batch in one pass, converting
+// every field, and prints commands per second.
+// Usage: command_bench [commands] [repeats]
+
+#include "../CommandParser.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+/// Fields converted from one command; summed so that no conversion is optimized away.
+struct Fields
+{
+    float floats_[9];
+    int ints_[1];
+    const char* names_[4];
+};
+
+typedef bool (*Converter)(const CommandLine& command, Fields& fields);
+
+static bool ConvertObject(const CommandLine& command, Fields& fields)
+{
+    fields.names_[0] = command.GetToken(1);
+    for (unsigned i = 0; i < 9; ++i)
+    {
+        if (!command.GetFloat(2 + i, fields.floats_[i]))
+            return false;
+    }
+    fields.names_[1] = command.GetToken(11);
+    fields.names_[2] = command.GetToken(12);
+    fields.names_[3] = command.GetToken(13);
+    return command.GetInt(14, fields.ints_[0]);
+}
+
+static bool ConvertPoint(const CommandLine& command, Fields& fields)
+{
+    fields.names_[0] = command.GetToken(1);
+    return command.GetFloat(2, fields.floats_[0]) && command.GetFloat(3, fields.floats_[1]) &&
+        command.GetFloat(4, fields.floats_[2]);
+}
+
+static bool ConvertMove(const CommandLine& command, Fields& fields)
+{
+    fields.names_[0] = command.GetToken(1);
+    fields.names_[1] = command.GetToken(2);
+    return true;
+}
+
+static bool ConvertRate(const CommandLine& command, Fields& fields)
+{
+    return command.GetFloat(1, fields.floats_[0]);
+}
+
+/// Opcode table, as in the scene server.
+struct Opcode
+{
+    const char* name_;
+    unsigned numTokens_;
+    Converter converter_;
+};
+
+static const Opcode OPCODES[] =
+{
+    { "TR", 2, ConvertRate },
+    { "OB", 15, ConvertObject },
+    { "PT", 5, ConvertPoint },
+    { "MO", 3, ConvertMove }
+};
+
+/// Previous path: copy to a fixed buffer, then sscanf after the 3-character prefix.
+static bool ParseWithScanf(const char* text, Fields& fields)
+{
+    char s[100];
+    char names[4][100];
+    strcpy(s, text);
+    if (strncmp(s, "OB ", 3) == 0)
+    {
+        return sscanf(s + 3, "%s %f %f %f %f %f %f %f %f %f %s %s %s %d", names[0], &fields.floats_[0],
+            &fields.floats_[1], &fields.floats_[2], &fields.floats_[3], &fields.floats_[4], &fields.floats_[5],
+            &fields.floats_[6], &fields.floats_[7], &fields.floats_[8], names[1], names[2], names[3],
+            &fields.ints_[0]) == 14;
+    }
+    else if (strncmp(s, "PT ", 3) == 0)
+        return sscanf(s + 3, "%s %f %f %f", names[0], &fields.floats_[0], &fields.floats_[1], &fields.floats_[2]) == 4;
+    else if (strncmp(s, "MO ", 3) == 0)
+        return sscanf(s + 3, "%s %s", names[0], names[1]) == 2;
+    else if (strncmp(s, "TR ", 3) == 0)
+        return sscanf(s + 3, "%f", &fields.floats_[0]) == 1;
+    return false;
+}
+
+/// New path: tokenize in place and dispatch through the opcode table, all commands of the buffer in one pass.
+static unsigned ParseInPlace(char* begin, char* end, Fields& fields, float& checksum)
+{
+    unsigned numFailed = 0;
+    CommandLine command;
+    for (char* pos = begin; pos < end;)
+    {
+        bool ok = false;
+        if (command.TokenizeLine(pos, end) && command.GetNumTokens())
+        {
+            for (unsigned i = 0; i < sizeof OPCODES / sizeof OPCODES[0]; ++i)
+            {
+                if (!strcmp(command.GetToken(0), OPCODES[i].name_))
+                {
+                    ok = command.GetNumTokens() == OPCODES[i].numTokens_ && OPCODES[i].converter_(command, fields);
+                    break;
+                }
+            }
+        }
+        if (ok)
+            checksum += fields.floats_[0];
+        else
+            ++numFailed;
+    }
+    return numFailed;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned count = argc > 1 ? (unsigned)atoi(argv[1]) : 1000000;
+    unsigned repeats = argc > 2 ? (unsigned)atoi(argv[2]) : 5;
+    if (!count || !repeats)
+    {
+        printf("Usage: %s [commands] [repeats]\n", argv[0]);
+        return 1;
+    }
+
+    // A scripted board setup: mostly object creations, with points, moves and the odd time rate change
+    std::string text;
+    std::vector<unsigned> starts;
+    srand(1);
+    char line[256];
+    for (unsigned i = 0; i < count; ++i)
+    {
+        switch (i % 8)
+        {
+        case 0:
+            sprintf(line, "PT point%u %.3f %.3f %.3f", i, rand() % 2000 / 100.0, 0.5, rand() % 2000 / 100.0);
+            break;
+        case 1:
+            sprintf(line, "MO card%u point%u", i - 1, i - 1);
+            break;
+        case 2:
+            sprintf(line, "TR %g", (double)(rand() % 1000));
+            break;
+        default:
+            sprintf(line, "OB card%u %.3f %.3f %.3f 1 1 1.5 0 %d 0 Models/Plane.mdl inventionrevealed_%02u.xml "
+                "beast.xml %d", i, rand() % 2000 / 100.0, 0.1, rand() % 2000 / 100.0, rand() % 360, i % 30, i & 1);
+            break;
+        }
+        starts.push_back((unsigned)text.size());
+        text += line;
+        text += '\n';
+    }
+    starts.push_back((unsigned)text.size());
+    printf("%u commands, %u bytes, %u repeats\n", count, (unsigned)text.size(), repeats);
+
+    double best[2] = { 1.0e30, 1.0e30 };
+    float checksum[2] = { 0.0f, 0.0f };
+    for (unsigned r = 0; r < repeats; ++r)
+    {
+        for (unsigned p = 0; p < 2; ++p)
+        {
+            // Each pass gets a pristine copy, as both write terminators into the text
+            std::vector<char> buffer(text.begin(), text.end());
+            Fields fields;
+            unsigned failed = 0;
+            std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+            if (p == 0)
+            {
+                for (unsigned i = 0; i < count; ++i)
+                {
+                    buffer[starts[i + 1] - 1] = 0;
+                    if (ParseWithScanf(&buffer[starts[i]], fields))
+                        checksum[p] += fields.floats_[0];
+                    else
+                        ++failed;
+                }
+            }
+            else
+                failed = ParseInPlace(&buffer[0], &buffer[0] + buffer.size() - 1, fields, checksum[p]);
+            double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+            if (seconds < best[p])
+                best[p] = seconds;
+            if (failed)
+                printf("%u commands failed to parse\n", failed);
+        }
+    }
+
+    printf("sscanf:   %8.2f M commands/s (checksum %g)\n", count / best[0] * 1.0e-6, checksum[0] / repeats);
+    printf("in place: %8.2f M commands/s (checksum %g)\n", count / best[1] * 1.0e-6, checksum[1] / repeats);
+    return 0;
+}
@@ -0,0 +1,101 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+// Kepler solver benchmark: solves the same synthetic catalog with every solver path supported by this CPU and prints
+// bodies per second, plus the worst residual of Kepler's equation against a double precision evaluation and the number
+// of bodies whose results differ from the scalar path's, which must be zero.
+// Usage: kepler_bench [bodies] [repeats]
+
+#include "../KeplerSolver.h"
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+int main(int argc, char** argv)
+{
+    unsigned count = argc > 1 ? (unsigned)atoi(argv[1]) : 1000000;
+    unsigned repeats = argc > 2 ? (unsigned)atoi(argv[2]) : 20;
+    if (!count || !repeats)
+    {
+        printf("Usage: %s [bodies] [repeats]\n", argv[0]);
+        return 1;
+    }
+
+    // Asteroid-like population: mostly low eccentricities with a tail of comets up to 0.97
+    std::vector<float> meanAnomaly(count), eccentricity(count), eccentricAnomaly(count), cosE(count), sinE(count);
+    std::vector<float> scalarAnomaly(count), scalarCosE(count), scalarSinE(count);
+    srand(1);
+    for (unsigned i = 0; i < count; ++i)
+    {
+        meanAnomaly[i] = (float)((rand() / (double)RAND_MAX) * 2.0 - 1.0) * 3.14159265f;
+        float r = (float)(rand() / (double)RAND_MAX);
+        eccentricity[i] = i % 50 ? r * 0.3f : r * 0.97f;
+    }
+
+    SolveKeplerBatch(&meanAnomaly[0], &eccentricity[0], &scalarAnomaly[0], &scalarCosE[0], &scalarSinE[0], count,
+        KSP_SCALAR);
+
+    printf("%u bodies, %u repeats\n", count, repeats);
+    for (unsigned p = 0; p < MAX_KEPLERSOLVER_PATHS; ++p)
+    {
+        KeplerSolverPath path = (KeplerSolverPath)p;
+        if (!IsKeplerSolverPathSupported(path))
+        {
+            printf("%-8s not supported\n", GetKeplerSolverPathName(path));
+            continue;
+        }
+
+        // Warm up caches and page in the output arrays
+        SolveKeplerBatch(&meanAnomaly[0], &eccentricity[0], &eccentricAnomaly[0], &cosE[0], &sinE[0], count, path);
+
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+        for (unsigned r = 0; r < repeats; ++r)
+            SolveKeplerBatch(&meanAnomaly[0], &eccentricity[0], &eccentricAnomaly[0], &cosE[0], &sinE[0], count, path);
+        double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+        double worst = 0.0;
+        unsigned mismatches = 0;
+        for (unsigned i = 0; i < count; ++i)
+        {
+            if (eccentricAnomaly[i] != scalarAnomaly[i] || cosE[i] != scalarCosE[i] || sinE[i] != scalarSinE[i])
+                ++mismatches;
+            double ea = eccentricAnomaly[i];
+            double residual = fabs(ea - eccentricity[i] * sin(ea) - meanAnomaly[i]);
+            if (residual > worst)
+                worst = residual;
+            if (fabs(cosE[i] - cos(ea)) > worst)
+                worst = fabs(cosE[i] - cos(ea));
+            if (fabs(sinE[i] - sin(ea)) > worst)
+                worst = fabs(sinE[i] - sin(ea));
+        }
+
+        printf("%-8s %10.2f Mbodies/s  %8.3f ms/frame  max error %.3g  %u differ from scalar\n",
+            GetKeplerSolverPathName(path), count * (double)repeats / seconds * 1e-6, seconds * 1000.0 / repeats, worst,
+            mismatches);
+    }
+
+    return 0;
+}
@@ -0,0 +1,3 @@
+#! /bin/bash
+g++ -O2 -std=c++11 -ffp-contract=off -o kepler_bench KeplerBench.cpp ../KeplerSolver.cpp
+g++ -O2 -std=c++11 -o command_bench CommandBench.cpp ../CommandParser.cpp
@@ -0,0 +1,465 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+// Texture cooker: converts the planet maps and card faces to block-compressed DDS with a full mip chain, so the
+// runtime neither decodes JPEG / PNG nor generates mips, and keeps the textures compressed in video memory. Opaque
+// images become DXT1, images with alpha DXT5. Outputs go to a Cooked subdirectory next to the sources, where the
+// TextureStreamer looks first. A manifest records a hash of each source file's content; sources whose hash did not
+// change are skipped. An atlas from tools/PackAtlas keeps only the mip levels its sprite sheet names, as smaller ones
+// would blend its cells together. Built and run by the cook_textures CMake target.
+// Usage: CookTextures <texture directory> <file pattern> [file pattern...]   (patterns support * and ?)
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/ProcessUtils.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/Resource/Image.h>
+#include <Urho3D/Resource/XMLFile.h>
+
+#include <stdio.h>
+
+using namespace Urho3D;
+
+/// Bumped whenever the output changes for the same input, forcing a full recook.
+static const unsigned COOKER_VERSION = 1;
+/// Manifest file name inside the output directory.
+static const char* MANIFEST_NAME = "CookManifest.txt";
+
+/// 64-bit FNV-1a hash of a buffer, chained from a previous hash.
+static unsigned long long HashData(const unsigned char* data, unsigned size, unsigned long long hash)
+{
+    for (unsigned i = 0; i < size; ++i)
+    {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/// Match a file name against a pattern with * and ? wildcards.
+static bool MatchPattern(const char* name, const char* pattern)
+{
+    if (!*pattern)
+        return !*name;
+    if (*pattern == '*')
+        return MatchPattern(name, pattern + 1) || (*name && MatchPattern(name + 1, pattern));
+    return *name && (*pattern == '?' || *pattern == *name) && MatchPattern(name + 1, pattern + 1);
+}
+
+/// Read pixel (x, y) as RGBA, whatever the number of components of the image.
+static void GetRGBA(const Image& image, int x, int y, unsigned char* rgba)
+{
+    unsigned components = image.GetComponents();
+    const unsigned char* src = image.GetData() + (y * image.GetWidth() + x) * components;
+    switch (components)
+    {
+    case 1:
+        rgba[0] = rgba[1] = rgba[2] = src[0];
+        rgba[3] = 255;
+        break;
+    case 2:
+        rgba[0] = rgba[1] = rgba[2] = src[0];
+        rgba[3] = src[1];
+        break;
+    case 3:
+        rgba[0] = src[0];
+        rgba[1] = src[1];
+        rgba[2] = src[2];
+        rgba[3] = 255;
+        break;
+    default:
+        rgba[0] = src[0];
+        rgba[1] = src[1];
+        rgba[2] = src[2];
+        rgba[3] = src[3];
+        break;
+    }
+}
+
+static unsigned short PackRGB565(const int* color)
+{
+    return (unsigned short)(((color[0] * 31 + 127) / 255) << 11 | ((color[1] * 63 + 127) / 255) << 5 |
+        ((color[2] * 31 + 127) / 255));
+}
+
+static void UnpackRGB565(unsigned short packed, int* color)
+{
+    int r = (packed >> 11) & 31;
+    int g = (packed >> 5) & 63;
+    int b = packed & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+/// Encode the color part of a 4x4 block: endpoints from the color bounding box inset by 1/16, always in four-color
+/// mode, then the nearest of the four palette entries for each pixel.
+static void EncodeColorBlock(const unsigned char* block, unsigned char* dest)
+{
+    int minColor[3] = { 255, 255, 255 };
+    int maxColor[3] = { 0, 0, 0 };
+    for (unsigned i = 0; i < 16; ++i)
+    {
+        for (unsigned c = 0; c < 3; ++c)
+        {
+            minColor[c] = Min(minColor[c], (int)block[i * 4 + c]);
+            maxColor[c] = Max(maxColor[c], (int)block[i * 4 + c]);
+        }
+    }
+    for (unsigned c = 0; c < 3; ++c)
+    {
+        int inset = (maxColor[c] - minColor[c]) >> 4;
+        minColor[c] += inset;
+        maxColor[c] -= inset;
+    }
+
+    // The box diagonal only follows the colors if every channel grows with the widest one; flip those that do not
+    unsigned widest = 0;
+    for (unsigned c = 1; c < 3; ++c)
+    {
+        if (maxColor[c] - minColor[c] > maxColor[widest] - minColor[widest])
+            widest = c;
+    }
+    int mean[3] = { 0, 0, 0 };
+    for (unsigned i = 0; i < 16; ++i)
+    {
+        for (unsigned c = 0; c < 3; ++c)
+            mean[c] += block[i * 4 + c];
+    }
+    for (unsigned c = 0; c < 3; ++c)
+    {
+        if (c == widest)
+            continue;
+        int covariance = 0;
+        for (unsigned i = 0; i < 16; ++i)
+            covariance += (block[i * 4 + c] * 16 - mean[c]) * (block[i * 4 + widest] * 16 - mean[widest]);
+        if (covariance < 0)
+            Swap(minColor[c], maxColor[c]);
+    }
+
+    unsigned short color0 = PackRGB565(maxColor);
+    unsigned short color1 = PackRGB565(minColor);
+    if (color0 < color1)
+        Swap(color0, color1);
+
+    unsigned indices = 0;
+    if (color0 != color1)
+    {
+        int palette[4][3];
+        UnpackRGB565(color0, palette[0]);
+        UnpackRGB565(color1, palette[1]);
+        for (unsigned c = 0; c < 3; ++c)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        for (unsigned i = 0; i < 16; ++i)
+        {
+            unsigned best = 0;
+            int bestDistance = M_MAX_INT;
+            for (unsigned j = 0; j < 4; ++j)
+            {
+                int distance = 0;
+                for (unsigned c = 0; c < 3; ++c)
+                {
+                    int delta = (int)block[i * 4 + c] - palette[j][c];
+                    distance += delta * delta;
+                }
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    best = j;
+                }
+            }
+            indices |= best << (i * 2);
+        }
+    }
+
+    dest[0] = (unsigned char)(color0 & 0xff);
+    dest[1] = (unsigned char)(color0 >> 8);
+    dest[2] = (unsigned char)(color1 & 0xff);
+    dest[3] = (unsigned char)(color1 >> 8);
+    for (unsigned i = 0; i < 4; ++i)
+        dest[4 + i] = (unsigned char)(indices >> (i * 8));
+}
+
+/// Encode the alpha part of a DXT5 block in eight-alpha mode between the block's alpha extremes.
+static void EncodeAlphaBlock(const unsigned char* block, unsigned char* dest)
+{
+    int alpha0 = 0;
+    int alpha1 = 255;
+    for (unsigned i = 0; i < 16; ++i)
+    {
+        alpha0 = Max(alpha0, (int)block[i * 4 + 3]);
+        alpha1 = Min(alpha1, (int)block[i * 4 + 3]);
+    }
+
+    int palette[8];
+    palette[0] = alpha0;
+    palette[1] = alpha1;
+    for (int j = 1; j < 7; ++j)
+        palette[j + 1] = ((7 - j) * alpha0 + j * alpha1) / 7;
+
+    unsigned long long indices = 0;
+    if (alpha0 != alpha1)
+    {
+        for (unsigned i = 0; i < 16; ++i)
+        {
+            unsigned best = 0;
+            int bestDistance = M_MAX_INT;
+            for (unsigned j = 0; j < 8; ++j)
+            {
+                int distance = Abs((int)block[i * 4 + 3] - palette[j]);
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    best = j;
+                }
+            }
+            indices |= (unsigned long long)best << (i * 3);
+        }
+    }
+
+    dest[0] = (unsigned char)alpha0;
+    dest[1] = (unsigned char)alpha1;
+    for (unsigned i = 0; i < 6; ++i)
+        dest[2 + i] = (unsigned char)(indices >> (i * 8));
+}
+
+/// Compress one mip level and append it to the output buffer.
+static void CompressLevel(const Image& image, bool alpha, PODVector<unsigned char>& output)
+{
+    int width = image.GetWidth();
+    int height = image.GetHeight();
+    unsigned char block[64];
+    unsigned char encoded[16];
+    for (int by = 0; by < height; by += 4)
+    {
+        for (int bx = 0; bx < width; bx += 4)
+        {
+            // Blocks past the image edge repeat the last row and column
+            for (int y = 0; y < 4; ++y)
+            {
+                for (int x = 0; x < 4; ++x)
+                    GetRGBA(image, Min(bx + x, width - 1), Min(by + y, height - 1), &block[(y * 4 + x) * 4]);
+            }
+
+            unsigned size = 8;
+            if (alpha)
+            {
+                EncodeAlphaBlock(block, encoded);
+                EncodeColorBlock(block, encoded + 8);
+                size = 16;
+            }
+            else
+                EncodeColorBlock(block, encoded);
+            for (unsigned i = 0; i < size; ++i)
+                output.Push(encoded[i]);
+        }
+    }
+}
+
+static bool HasAlpha(const Image& image)
+{
+    if (image.GetComponents() != 2 && image.GetComponents() != 4)
+        return false;
+    unsigned char rgba[4];
+    for (int y = 0; y < image.GetHeight(); ++y)
+    {
+        for (int x = 0; x < image.GetWidth(); ++x)
+        {
+            GetRGBA(image, x, y, rgba);
+            if (rgba[3] != 255)
+                return true;
+        }
+    }
+    return false;
+}
+
+/// Return the number of mip levels of an atlas, from the sprite sheet next to it (<name>Sheet.xml), or zero for a full
+/// mip chain when the image has no sheet.
+static unsigned GetAtlasLevels(Context* context, const String& sourceName)
+{
+    String sheetName = GetPath(sourceName) + GetFileName(sourceName) + "Sheet.xml";
+    if (!context->GetSubsystem<FileSystem>()->FileExists(sheetName))
+        return 0;
+
+    SharedPtr<XMLFile> sheet(new XMLFile(context));
+    File sheetFile(context, sheetName);
+    if (!sheetFile.IsOpen() || !sheet->Load(sheetFile))
+        return 0;
+    XMLElement root = sheet->GetRoot("TextureAtlas");
+    return root ? root.GetUInt("levels") : 0;
+}
+
+/// Cook one image to DDS with at most the given number of mip levels, zero for a full chain. Return false on failure.
+static bool CookImage(Context* context, const String& sourceName, const String& destName, unsigned maxLevels)
+{
+    SharedPtr<Image> image(new Image(context));
+    File source(context, sourceName);
+    if (!source.IsOpen() || !image->Load(source) || image->IsCompressed() || image->GetDepth() > 1)
+    {
+        printf("Could not load %s\n", sourceName.CString());
+        return false;
+    }
+
+    bool alpha = HasAlpha(*image);
+    PODVector<unsigned char> data;
+    unsigned numLevels = 0;
+    unsigned topLevelSize = 0;
+    // Each level halves the previous one with a box filter, down to 1x1 or the level limit
+    for (SharedPtr<Image> level = image; level && (!maxLevels || numLevels < maxLevels); level =
+        level->GetWidth() > 1 || level->GetHeight() > 1 ? level->GetNextLevel() : SharedPtr<Image>())
+    {
+        CompressLevel(*level, alpha, data);
+        if (!numLevels)
+            topLevelSize = data.Size();
+        ++numLevels;
+    }
+
+    // DDS header: magic, then the 124 byte surface description
+    unsigned header[32];
+    for (unsigned i = 0; i < 32; ++i)
+        header[i] = 0;
+    header[0] = 0x20534444;                     // "DDS "
+    header[1] = 124;                            // Header size
+    header[2] = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000;   // Caps, height, width, pixel format, mips, linear size
+    header[3] = (unsigned)image->GetHeight();
+    header[4] = (unsigned)image->GetWidth();
+    header[5] = topLevelSize;
+    header[7] = numLevels;
+    header[19] = 32;                            // Pixel format size
+    header[20] = 0x4;                           // Pixel format has a FourCC
+    header[21] = alpha ? 0x35545844 : 0x31545844;    // "DXT5" / "DXT1"
+    header[27] = 0x1000 | 0x400000 | 0x8;       // Texture, mipmap, complex
+
+    File dest(context, destName, FILE_WRITE);
+    if (!dest.IsOpen() || dest.Write(header, sizeof header) != sizeof header ||
+        dest.Write(&data[0], data.Size()) != data.Size())
+    {
+        printf("Could not write %s\n", destName.CString());
+        return false;
+    }
+
+    printf("Cooked %s: %dx%d %s, %u levels\n", GetFileNameAndExtension(sourceName).CString(), image->GetWidth(),
+        image->GetHeight(), alpha ? "DXT5" : "DXT1", numLevels);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        printf("Usage: CookTextures <texture directory> <file pattern> [file pattern...]\n");
+        return 1;
+    }
+
+    SharedPtr<Context> context(new Context());
+    context->RegisterSubsystem(new FileSystem(context));
+    FileSystem* fileSystem = context->GetSubsystem<FileSystem>();
+
+    String sourceDir = AddTrailingSlash(GetInternalPath(String(argv[1])));
+    String destDir = sourceDir + "Cooked/";
+    if (!fileSystem->CreateDir(destDir))
+    {
+        printf("Could not create %s\n", destDir.CString());
+        return 1;
+    }
+
+    // Manifest lines: file name, then the hash of its content when it was last cooked
+    HashMap<String, String> manifest;
+    if (fileSystem->FileExists(destDir + MANIFEST_NAME))
+    {
+        File manifestFile(context, destDir + MANIFEST_NAME);
+        while (!manifestFile.IsEof())
+        {
+            Vector<String> fields = manifestFile.ReadLine().Split(' ');
+            if (fields.Size() == 2)
+                manifest[fields[0]] = fields[1];
+        }
+    }
+
+    Vector<String> files;
+    fileSystem->ScanDir(files, sourceDir, "*", SCAN_FILES, false);
+    Sort(files.Begin(), files.End());
+
+    unsigned numCooked = 0;
+    unsigned numSkipped = 0;
+    unsigned numFailed = 0;
+    for (unsigned i = 0; i < files.Size(); ++i)
+    {
+        bool matched = false;
+        for (int j = 2; j < argc && !matched; ++j)
+            matched = MatchPattern(files[i].CString(), argv[j]);
+        if (!matched)
+            continue;
+
+        File source(context, sourceDir + files[i]);
+        PODVector<unsigned char> content(source.GetSize());
+        if (!source.IsOpen() || (content.Size() && source.Read(&content[0], content.Size()) != content.Size()))
+        {
+            printf("Could not read %s\n", files[i].CString());
+            ++numFailed;
+            continue;
+        }
+        source.Close();
+
+        // A new level limit from a repacked sheet changes the output too
+        unsigned maxLevels = GetAtlasLevels(context, sourceDir + files[i]);
+        unsigned long long hash = HashData((const unsigned char*)&COOKER_VERSION, sizeof COOKER_VERSION,
+            14695981039346656037ULL);
+        if (maxLevels)
+            hash = HashData((const unsigned char*)&maxLevels, sizeof maxLevels, hash);
+        hash = HashData(content.Size() ? &content[0] : 0, content.Size(), hash);
+        char hashText[17];
+        sprintf(hashText, "%08x%08x", (unsigned)(hash >> 32), (unsigned)hash);
+
+        String destName = destDir + GetFileName(files[i]) + ".dds";
+        HashMap<String, String>::ConstIterator entry = manifest.Find(files[i]);
+        if (entry != manifest.End() && entry->second_ == hashText && fileSystem->FileExists(destName))
+        {
+            ++numSkipped;
+            continue;
+        }
+
+        if (CookImage(context, sourceDir + files[i], destName, maxLevels))
+        {
+            manifest[files[i]] = hashText;
+            ++numCooked;
+        }
+        else
+        {
+            manifest.Erase(files[i]);
+            ++numFailed;
+        }
+    }
+
+    File output(context, destDir + MANIFEST_NAME, FILE_WRITE);
+    for (HashMap<String, String>::ConstIterator i = manifest.Begin(); i != manifest.End(); ++i)
+        output.WriteLine(i->first_ + " " + i->second_);
+
+    printf("%u cooked, %u unchanged, %u failed\n", numCooked, numSkipped, numFailed);
+    return numFailed ? 1 : 0;
+}
@@ -0,0 +1,178 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+// Star catalog converter: turns an HYG database CSV export (hygdata_v3.csv) into the binary catalog read by StarField.
+// Stars are converted from equatorial J2000 coordinates to unit directions in scene axes (ecliptic X and Y become
+// scene X and Z, the ecliptic pole scene Y) and sorted from brightest to faintest. The Sun is skipped.
+// Usage: make_star_catalog hygdata_v3.csv ../bin/Data/Catalogs/Stars.bin [faintest magnitude]
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+/// Same layout as StarCatalogRecord.
+struct Record
+{
+    float direction_[3];
+    float magnitude_;
+    float colorIndex_;
+};
+
+static bool BrighterThan(const Record& lhs, const Record& rhs)
+{
+    return lhs.magnitude_ < rhs.magnitude_;
+}
+
+static void SplitCSV(const std::string& line, std::vector<std::string>& fields)
+{
+    fields.clear();
+    std::string field;
+    bool quoted = false;
+    for (size_t i = 0; i < line.size(); ++i)
+    {
+        char c = line[i];
+        if (c == '"')
+            quoted = !quoted;
+        else if (c == ',' && !quoted)
+        {
+            fields.push_back(field);
+            field.clear();
+        }
+        else if (c != '\r' && c != '\n')
+            field += c;
+    }
+    fields.push_back(field);
+}
+
+static int FindColumn(const std::vector<std::string>& header, const char* name)
+{
+    for (size_t i = 0; i < header.size(); ++i)
+    {
+        if (header[i] == name)
+            return (int)i;
+    }
+    return -1;
+}
+
+static bool ReadLine(FILE* file, std::string& line)
+{
+    line.clear();
+    int c;
+    while ((c = fgetc(file)) != EOF && c != '\n')
+        line += (char)c;
+    return c != EOF || !line.empty();
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        printf("Usage: make_star_catalog <hyg csv> <output> [faintest magnitude]\n");
+        return 1;
+    }
+    float faintest = argc > 3 ? (float)atof(argv[3]) : 99.0f;
+
+    FILE* input = fopen(argv[1], "rb");
+    if (!input)
+    {
+        printf("Could not open %s\n", argv[1]);
+        return 1;
+    }
+
+    std::string line;
+    std::vector<std::string> fields;
+    ReadLine(input, line);
+    SplitCSV(line, fields);
+    int idColumn = FindColumn(fields, "id");
+    int raColumn = FindColumn(fields, "ra");
+    int decColumn = FindColumn(fields, "dec");
+    int magColumn = FindColumn(fields, "mag");
+    int ciColumn = FindColumn(fields, "ci");
+    if (raColumn < 0 || decColumn < 0 || magColumn < 0)
+    {
+        printf("%s lacks the ra, dec or mag columns\n", argv[1]);
+        fclose(input);
+        return 1;
+    }
+
+    // Obliquity of the ecliptic at J2000
+    const double obliquity = 23.4392911 * M_PI / 180.0;
+    const double cosObliquity = cos(obliquity);
+    const double sinObliquity = sin(obliquity);
+
+    std::vector<Record> records;
+    while (ReadLine(input, line))
+    {
+        SplitCSV(line, fields);
+        if ((int)fields.size() <= std::max(std::max(raColumn, decColumn), std::max(magColumn, ciColumn)))
+            continue;
+        if (idColumn >= 0 && atoi(fields[idColumn].c_str()) == 0)
+            continue;
+
+        double ra = atof(fields[raColumn].c_str()) * M_PI / 12.0;
+        double dec = atof(fields[decColumn].c_str()) * M_PI / 180.0;
+        float magnitude = (float)atof(fields[magColumn].c_str());
+        if (magnitude > faintest)
+            continue;
+
+        // Equatorial to ecliptic is a rotation about the vernal equinox direction, shared by both frames
+        double x = cos(dec) * cos(ra);
+        double y = cos(dec) * sin(ra);
+        double z = sin(dec);
+        double eclipticY = y * cosObliquity + z * sinObliquity;
+        double eclipticZ = -y * sinObliquity + z * cosObliquity;
+
+        Record record;
+        record.direction_[0] = (float)x;
+        record.direction_[1] = (float)eclipticZ;
+        record.direction_[2] = (float)eclipticY;
+        record.magnitude_ = magnitude;
+        record.colorIndex_ = ciColumn >= 0 && !fields[ciColumn].empty() ? (float)atof(fields[ciColumn].c_str()) : 0.6f;
+        records.push_back(record);
+    }
+    fclose(input);
+
+    std::stable_sort(records.begin(), records.end(), BrighterThan);
+
+    FILE* output = fopen(argv[2], "wb");
+    if (!output)
+    {
+        printf("Could not create %s\n", argv[2]);
+        return 1;
+    }
+
+    unsigned numStars = (unsigned)records.size();
+    fwrite("STAR", 1, 4, output);
+    fwrite(&numStars, sizeof numStars, 1, output);
+    if (numStars)
+        fwrite(&records[0], sizeof(Record), numStars, output);
+    fclose(output);
+
+    printf("Wrote %u stars to %s\n", numStars, argv[2]);
+    return 0;
+}
@@ -0,0 +1,220 @@
+//
+// Copyright (c) 2008-2015 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+
+
+// Atlas packer: copies same-sized images into one atlas image laid out as a grid, and writes a sprite sheet naming
+// the rectangle of each source, in the TextureAtlas / SubTexture format that Urho2D sprite sheets also read. Objects
+// whose materials use the packed textures can then share one material and be merged into a single batch (AtlasBatch).
+// Each cell is surrounded by CELL_PADDING texels repeating its edge, and cells with their padding start on multiples
+// of 2^(ATLAS_LEVELS - 1) texels. Down to the last of ATLAS_LEVELS mip levels a texel then averages one cell and its
+// padding only, and bilinear filtering at a cell's edge stays within the padding. Smaller levels would blend the
+// cards together, so the sheet names the number of levels for the texture cooker, which stops the mip chain there.
+// Images whose size or component count differs from the first one are skipped. Nothing is written when both outputs
+// are newer than every source and were packed with the same layout. Built and run by the pack_atlases CMake target,
+// before the texture cooker.
+// Usage: PackAtlas <texture directory> <atlas name> <file pattern> [file pattern...]   (patterns support * and ?)
+// Outputs: <atlas name>.png and <atlas name>Sheet.xml in the texture directory.
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/ProcessUtils.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/Resource/Image.h>
+#include <Urho3D/Resource/XMLFile.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+using namespace Urho3D;
+
+/// Largest atlas width or height in pixels, the texture size every target supports.
+static const int MAX_ATLAS_SIZE = 4096;
+/// Texels repeating the edge of a cell around it.
+static const int CELL_PADDING = 16;
+/// Mip levels the padding keeps apart. Bilinear filtering on the last level reaches half of one of its texels, that is
+/// 2^(ATLAS_LEVELS - 2) level 0 texels, past a cell's edge, which must not exceed CELL_PADDING.
+static const unsigned ATLAS_LEVELS = 6;
+/// Alignment of the padded cells, so that no texel of the last level straddles two of them.
+static const int CELL_ALIGNMENT = 1 << (ATLAS_LEVELS - 1);
+
+/// Match a file name against a pattern with * and ? wildcards.
+static bool MatchPattern(const char* name, const char* pattern)
+{
+    if (!*pattern)
+        return !*name;
+    if (*pattern == '*')
+        return MatchPattern(name, pattern + 1) || (*name && MatchPattern(name + 1, pattern));
+    return *name && (*pattern == '?' || *pattern == *name) && MatchPattern(name + 1, pattern + 1);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 4)
+    {
+        printf("Usage: PackAtlas <texture directory> <atlas name> <file pattern> [file pattern...]\n");
+        return 1;
+    }
+
+    SharedPtr<Context> context(new Context());
+    context->RegisterSubsystem(new FileSystem(context));
+    FileSystem* fileSystem = context->GetSubsystem<FileSystem>();
+
+    String sourceDir = AddTrailingSlash(GetInternalPath(String(argv[1])));
+    String atlasName = String(argv[2]) + ".png";
+    String sheetName = String(argv[2]) + "Sheet.xml";
+
+    Vector<String> files;
+    fileSystem->ScanDir(files, sourceDir, "*", SCAN_FILES, false);
+    Sort(files.Begin(), files.End());
+
+    Vector<String> sources;
+    unsigned newestSource = 0;
+    for (unsigned i = 0; i < files.Size(); ++i)
+    {
+        bool matched = false;
+        for (int j = 3; j < argc && !matched; ++j)
+            matched = MatchPattern(files[i].CString(), argv[j]);
+        // The atlas itself may match the patterns of its sources
+        if (matched && files[i] != atlasName)
+        {
+            sources.Push(files[i]);
+            newestSource = Max(newestSource, fileSystem->GetLastModifiedTime(sourceDir + files[i]));
+        }
+    }
+    if (sources.Empty())
+    {
+        printf("No images match\n");
+        return 1;
+    }
+
+    if (fileSystem->FileExists(sourceDir + atlasName) && fileSystem->FileExists(sourceDir + sheetName) &&
+        fileSystem->GetLastModifiedTime(sourceDir + atlasName) >= newestSource &&
+        fileSystem->GetLastModifiedTime(sourceDir + sheetName) >= newestSource)
+    {
+        // An atlas packed with another padding is repacked even though its sources did not change
+        SharedPtr<XMLFile> oldSheet(new XMLFile(context));
+        File oldSheetFile(context, sourceDir + sheetName);
+        XMLElement oldRoot = oldSheetFile.IsOpen() && oldSheet->Load(oldSheetFile) ? oldSheet->GetRoot("TextureAtlas") :
+            XMLElement();
+        if (oldRoot && oldRoot.GetInt("padding") == CELL_PADDING && oldRoot.GetUInt("levels") == ATLAS_LEVELS)
+        {
+            printf("%s is up to date\n", atlasName.CString());
+            return 0;
+        }
+    }
+
+    Vector<SharedPtr<Image> > images;
+    Vector<String> names;
+    for (unsigned i = 0; i < sources.Size(); ++i)
+    {
+        SharedPtr<Image> image(new Image(context));
+        File source(context, sourceDir + sources[i]);
+        if (!source.IsOpen() || !image->Load(source) || image->IsCompressed() || image->GetDepth() > 1)
+        {
+            printf("Could not load %s\n", sources[i].CString());
+            return 1;
+        }
+        if (!images.Empty() && (image->GetWidth() != images[0]->GetWidth() ||
+            image->GetHeight() != images[0]->GetHeight() || image->GetComponents() != images[0]->GetComponents()))
+        {
+            printf("Skipped %s: %dx%d, not %dx%d with %u components\n", sources[i].CString(), image->GetWidth(),
+                image->GetHeight(), images[0]->GetWidth(), images[0]->GetHeight(), images[0]->GetComponents());
+            continue;
+        }
+        images.Push(image);
+        names.Push(sources[i]);
+    }
+
+    // The grid is about as tall as it is wide, within the largest texture size. Padded cells are rounded up to the
+    // alignment, the extra texels on their right and bottom repeating the edge too
+    int cellWidth = images[0]->GetWidth();
+    int cellHeight = images[0]->GetHeight();
+    unsigned components = images[0]->GetComponents();
+    int slotWidth = (cellWidth + 2 * CELL_PADDING + CELL_ALIGNMENT - 1) / CELL_ALIGNMENT * CELL_ALIGNMENT;
+    int slotHeight = (cellHeight + 2 * CELL_PADDING + CELL_ALIGNMENT - 1) / CELL_ALIGNMENT * CELL_ALIGNMENT;
+    int numCells = (int)images.Size();
+    int columns = (int)ceil(sqrt((double)numCells * slotHeight / slotWidth));
+    columns = Clamp(columns, 1, Min(numCells, MAX_ATLAS_SIZE / slotWidth));
+    int rows = (numCells + columns - 1) / columns;
+    if (columns * slotWidth > MAX_ATLAS_SIZE || rows * slotHeight > MAX_ATLAS_SIZE)
+    {
+        printf("%d images of %dx%d do not fit in %dx%d\n", numCells, cellWidth, cellHeight, MAX_ATLAS_SIZE,
+            MAX_ATLAS_SIZE);
+        return 1;
+    }
+
+    SharedPtr<Image> atlas(new Image(context));
+    atlas->SetSize(columns * slotWidth, rows * slotHeight, components);
+    unsigned char* atlasData = atlas->GetData();
+    memset(atlasData, 0, (size_t)atlas->GetWidth() * atlas->GetHeight() * components);
+
+    Vector<String> regions;
+    for (int i = 0; i < numCells; ++i)
+    {
+        int slotX = (i % columns) * slotWidth;
+        int slotY = (i / columns) * slotHeight;
+        const unsigned char* src = images[i]->GetData();
+        for (int row = 0; row < slotHeight; ++row)
+        {
+            int srcRow = Clamp(row - CELL_PADDING, 0, cellHeight - 1);
+            unsigned char* dest = atlasData + ((slotY + row) * atlas->GetWidth() + slotX) * components;
+            for (int column = 0; column < slotWidth; ++column)
+            {
+                int srcColumn = Clamp(column - CELL_PADDING, 0, cellWidth - 1);
+                memcpy(dest + column * components, src + (srcRow * cellWidth + srcColumn) * components, components);
+            }
+        }
+
+        regions.Push("    <SubTexture name=\"" + names[i] + "\" x=\"" + String(slotX + CELL_PADDING) + "\" y=\"" +
+            String(slotY + CELL_PADDING) + "\" width=\"" + String(cellWidth) + "\" height=\"" + String(cellHeight) +
+            "\" />");
+    }
+
+    if (!atlas->SavePNG(sourceDir + atlasName))
+    {
+        printf("Could not write %s\n", atlasName.CString());
+        return 1;
+    }
+
+    // The sheet is written last, so an interrupted run is never taken for an up to date one
+    File sheet(context, sourceDir + sheetName, FILE_WRITE);
+    if (!sheet.IsOpen())
+    {
+        printf("Could not write %s\n", sheetName.CString());
+        return 1;
+    }
+    // Besides the image, the root names the atlas size, which the rectangles no longer reach, and the padding and mip
+    // levels it was packed for
+    sheet.WriteLine("<TextureAtlas imagePath=\"" + atlasName + "\" width=\"" + String(atlas->GetWidth()) +
+        "\" height=\"" + String(atlas->GetHeight()) + "\" padding=\"" + String(CELL_PADDING) + "\" levels=\"" +
+        String(ATLAS_LEVELS) + "\">");
+    for (unsigned i = 0; i < regions.Size(); ++i)
+        sheet.WriteLine(regions[i]);
+    sheet.WriteLine("</TextureAtlas>");
+
+    printf("Packed %d images of %dx%d into %s: %dx%d\n", numCells, cellWidth, cellHeight, atlasName.CString(),
+        atlas->GetWidth(), atlas->GetHeight());
+    return 0;
+}
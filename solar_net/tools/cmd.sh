@@ -0,0 +1,2 @@
+#! /bin/bash
+g++ -O2 -std=c++11 -o make_star_catalog MakeStarCatalog.cpp